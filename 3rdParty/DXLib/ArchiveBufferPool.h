@@ -0,0 +1,95 @@
+/*
+ *  File: ArchiveBufferPool.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdlib.h>
+
+// Scratch buffer of one DecodeArchive call, reused for all files of the archive instead of
+// allocating it per file. The buffer only grows, so the number of allocations depends on the
+// largest files of the archive and not on the number of files.
+class DXArchiveBufferPool
+{
+public:
+	static constexpr uint64_t MAX_GROWTH = 0x1000000;
+
+public:
+	DXArchiveBufferPool() = default;
+
+	~DXArchiveBufferPool()
+	{
+		free(m_pData);
+	}
+
+	DXArchiveBufferPool(const DXArchiveBufferPool &)            = delete;
+	DXArchiveBufferPool &operator=(const DXArchiveBufferPool &) = delete;
+
+	// At least size bytes, the previous contents are not kept when the buffer grows ( NULL if the allocation failed )
+	void *Get(const uint64_t &size)
+	{
+		if (size <= m_capacity && m_pData != NULL)
+			return m_pData;
+
+		// malloc takes a size_t, a 32 bit build would silently allocate the truncated size
+		if (size > static_cast<uint64_t>(SIZE_MAX)) return NULL;
+
+		// Grow by half of the current capacity (at most MAX_GROWTH) so a sequence of slightly larger files does not allocate each time
+		uint64_t capacity = m_capacity + (m_capacity / 2 < MAX_GROWTH ? m_capacity / 2 : MAX_GROWTH);
+		if (capacity < size || capacity > static_cast<uint64_t>(SIZE_MAX)) capacity = size;
+
+		free(m_pData);
+		m_pData    = malloc(static_cast<size_t>(capacity));
+		m_capacity = (m_pData != NULL ? capacity : 0);
+
+		if (m_pData == NULL) return NULL;
+
+		m_allocations++;
+		s_totalAllocations++;
+
+		return m_pData;
+	}
+
+	// Allocations done by this pool
+	uint32_t GetAllocations() const
+	{
+		return m_allocations;
+	}
+
+	// Allocations done by all pools of the process
+	static uint64_t GetTotalAllocations()
+	{
+		return s_totalAllocations;
+	}
+
+private:
+	void *m_pData          = NULL;
+	uint64_t m_capacity    = 0;
+	uint32_t m_allocations = 0;
+
+	inline static std::atomic<uint64_t> s_totalAllocations = 0;
+};
@@ -0,0 +1,54 @@
+/*
+ *  File: ArchiveListing.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Contents of an archive as stored in its header tables, filled by ListArchive of the archive versions
+struct DXArchiveEntry
+{
+	static constexpr uint64_t NOT_PRESSED = 0xffffffffffffffff;
+
+	std::wstring path          = L""; // Relative to the archive root, separated by '/'
+	bool directory             = false;
+	uint64_t attributes        = 0;
+	uint64_t create            = 0; // FILETIME values
+	uint64_t lastAccess        = 0;
+	uint64_t lastWrite         = 0;
+	uint64_t dataSize          = 0;
+	uint64_t pressDataSize     = NOT_PRESSED;
+	uint64_t huffPressDataSize = NOT_PRESSED; // Huffman compression only exists since archive version 8
+};
+
+struct DXArchiveListing
+{
+	uint16_t version                    = 0; // DARC_HEAD::Version
+	uint16_t cryptVersion               = 0; // DARC_HEAD::Flags >> 16, always 0 before archive version 8
+	std::vector<DXArchiveEntry> entries = {};
+};
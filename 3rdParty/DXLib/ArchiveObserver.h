@@ -0,0 +1,49 @@
+/*
+ *  File: ArchiveObserver.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Hooks into DecodeArchive of all archive versions, filePath is the full output path of the entry,
+// size and lastWrite are the DataSize and Time.LastWrite values of its file head
+class DXArchiveObserver
+{
+public:
+	virtual ~DXArchiveObserver() = default;
+
+	// Called before an entry is written, returning false skips the entry
+	virtual bool ShouldExtract(const std::wstring &filePath, const uint64_t &size, const uint64_t &lastWrite)
+	{
+		return true;
+	}
+
+	// Called once an entry is fully written and its timestamps are set
+	virtual void OnExtracted(const std::wstring &filePath, const uint64_t &size, const uint64_t &lastWrite)
+	{
+	}
+};
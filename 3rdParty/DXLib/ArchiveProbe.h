@@ -0,0 +1,113 @@
+/*
+ *  File: ArchiveProbe.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Structural check of a decrypted (and decompressed) archive header table, used to test a key without extracting anything.
+// The table consists of the name table, followed by the file head table and the directory table, DirT / FileT are the
+// DARC_DIRECTORY* / DARC_FILEHEAD* types of the archive version, fileHeadSize the size of a single file head entry.
+template<typename DirT, typename FileT>
+bool CheckArchiveHeadTable(const uint8_t *pTable, const uint64_t &tableSize, const uint64_t &fileTableStart, const uint64_t &dirTableStart, const uint64_t &dataSize, const uint64_t &fileHeadSize)
+{
+	constexpr uint64_t DIRECTORY_ATTRIBUTE = 0x10; // FILE_ATTRIBUTE_DIRECTORY
+	constexpr uint64_t DIR_SIZE            = sizeof(DirT);
+
+	if (fileHeadSize == 0 || fileTableStart > dirTableStart || dirTableStart > tableSize || tableSize - dirTableStart < DIR_SIZE)
+		return false;
+
+	const uint8_t *pNames   = pTable;
+	const uint8_t *pFiles   = pTable + fileTableStart;
+	const uint8_t *pDirs    = pTable + dirTableStart;
+	const uint64_t nameSize = fileTableStart;
+	const uint64_t fileSize = dirTableStart - fileTableStart;
+	const uint64_t dirSize  = tableSize - dirTableStart;
+	const uint64_t dirCnt   = dirSize / DIR_SIZE;
+
+	// The root directory is located at address 0 and has no parent
+	if (reinterpret_cast<const DirT *>(pDirs)->ParentDirectoryAddress != static_cast<decltype(DirT::ParentDirectoryAddress)>(-1))
+		return false;
+
+	std::vector<uint64_t> pending = { 0 };
+	uint64_t visited              = 0;
+
+	while (!pending.empty())
+	{
+		const uint64_t dirAddr = pending.back();
+		pending.pop_back();
+
+		// Every directory can only be reached once, more visits mean the links form a loop
+		if (++visited > dirCnt)
+			return false;
+
+		const DirT *pDir = reinterpret_cast<const DirT *>(pDirs + dirAddr);
+
+		if (pDir->FileHeadNum > fileSize / fileHeadSize || pDir->FileHeadAddress > fileSize - pDir->FileHeadNum * fileHeadSize)
+			return false;
+
+		for (uint64_t i = 0; i < pDir->FileHeadNum; i++)
+		{
+			const uint64_t fileAddr = pDir->FileHeadAddress + i * fileHeadSize;
+			const FileT *pFile      = reinterpret_cast<const FileT *>(pFiles + fileAddr);
+
+			// Name entry: pack count, parity, upper case name and original name, each name part is pack count * 4 bytes
+			if (pFile->NameAddress > nameSize || nameSize - pFile->NameAddress < 4)
+				return false;
+
+			const uint8_t *pName   = pNames + pFile->NameAddress;
+			const uint64_t packNum = *reinterpret_cast<const uint16_t *>(pName);
+
+			if (nameSize - pFile->NameAddress - 4 < packNum * 4 * 2)
+				return false;
+
+			uint16_t parity = 0;
+			for (uint64_t j = 0; j < packNum * 4; j++)
+				parity += pName[4 + j];
+
+			if (parity != *reinterpret_cast<const uint16_t *>(pName + 2))
+				return false;
+
+			if (pFile->Attributes & DIRECTORY_ATTRIBUTE)
+			{
+				if (pFile->DataAddress % DIR_SIZE != 0 || pFile->DataAddress > dirSize - DIR_SIZE)
+					return false;
+
+				// The sub directory has to link back to this directory and its own file head
+				const DirT *pSubDir = reinterpret_cast<const DirT *>(pDirs + pFile->DataAddress);
+				if (pSubDir->ParentDirectoryAddress != dirAddr || pSubDir->DirectoryAddress != fileAddr)
+					return false;
+
+				pending.push_back(pFile->DataAddress);
+			}
+			else if (pFile->DataAddress > dataSize)
+				return false;
+		}
+	}
+
+	return true;
+}
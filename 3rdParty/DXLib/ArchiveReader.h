@@ -0,0 +1,217 @@
+/*
+ *  File: ArchiveReader.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <tchar.h>
+#include <windows.h>
+
+// Positional reads from an archive file, nothing depends on a file position so the workers of
+// DecodeArchive read at any offset without seeking. Every worker uses its own reader, reads of
+// different threads through one synchronous handle would be serialized by the system.
+//
+// By default the archive is mapped into memory, reads are then copies from the mapped pages and
+// data which needs no decryption can be used directly through GetView. If the view can not be
+// created (e.g. no address space left in 32 bit builds) the reader falls back to ReadFile.
+class DXArchiveReader
+{
+public:
+	enum class Access
+	{
+		READ,	 // ReadFile only
+		MAP,	 // Read-only view, falls back to READ
+		MAP_COPY // Copy-on-write view which can be modified through GetImage, fails if the view can not be created
+	};
+
+	// ReadFile takes a DWORD size, larger reads are split
+	static constexpr uint64_t MAX_READ = 0x40000000;
+
+	// Ranges of at least this size are prefetched before they are read from the view
+	static constexpr uint64_t PREFETCH_MIN = 0x100000;
+
+public:
+	DXArchiveReader() = default;
+
+	~DXArchiveReader()
+	{
+		Close();
+	}
+
+	DXArchiveReader(const DXArchiveReader &)            = delete;
+	DXArchiveReader &operator=(const DXArchiveReader &) = delete;
+
+	bool Open(const TCHAR *pPath, const Access &access = Access::MAP)
+	{
+		Close();
+
+		m_hFile = CreateFile(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_hFile, &size))
+		{
+			Close();
+			return false;
+		}
+
+		m_size = static_cast<uint64_t>(size.QuadPart);
+
+		if (access == Access::READ || m_size == 0)
+			return access != Access::MAP_COPY;
+
+		// Mapping an empty file fails and views are limited by the address space, both are left to ReadFile
+		if (m_size <= static_cast<uint64_t>(SIZE_MAX))
+		{
+			const bool copy = (access == Access::MAP_COPY);
+
+			m_hMapping = CreateFileMapping(m_hFile, NULL, copy ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+
+			if (m_hMapping != NULL)
+				m_pView = static_cast<uint8_t *>(MapViewOfFile(m_hMapping, copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+		}
+
+		if (m_pView == NULL)
+		{
+			closeMapping();
+
+			if (access == Access::MAP_COPY)
+			{
+				Close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void Close()
+	{
+		closeMapping();
+
+		if (m_hFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_hFile);
+			m_hFile = INVALID_HANDLE_VALUE;
+		}
+
+		m_size = 0;
+	}
+
+	bool IsMapped() const
+	{
+		return m_pView != NULL;
+	}
+
+	uint64_t GetSize() const
+	{
+		return m_size;
+	}
+
+	// The mapped archive, NULL if it is not mapped
+	uint8_t *GetImage() const
+	{
+		return m_pView;
+	}
+
+	// The mapped bytes [offset, offset + size), NULL if the archive is not mapped or the range is outside of it
+	const uint8_t *GetView(const uint64_t &offset, const uint64_t &size) const
+	{
+		if (m_pView == NULL || offset > m_size || size > m_size - offset)
+			return NULL;
+
+		return m_pView + offset;
+	}
+
+	// Hint that the range is read next, like madvise WILLNEED the pages are read ahead in large requests
+	void Prefetch(const uint64_t &offset, const uint64_t &size) const
+	{
+		const uint8_t *pView = GetView(offset, size);
+		if (pView == NULL || size < PREFETCH_MIN) return;
+
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = const_cast<uint8_t *>(pView);
+		range.NumberOfBytes  = static_cast<SIZE_T>(size);
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	// Read size bytes at offset of the archive, false if the archive ends before
+	bool Read(void *pData, const uint64_t &size, const uint64_t &offset) const
+	{
+		if (m_pView != NULL)
+		{
+			const uint8_t *pView = GetView(offset, size);
+			if (pView == NULL) return false;
+
+			Prefetch(offset, size);
+			std::memcpy(pData, pView, static_cast<size_t>(size));
+			return true;
+		}
+
+		uint64_t done = 0;
+
+		while (done < size)
+		{
+			const uint64_t pos = offset + done;
+			const DWORD chunk  = static_cast<DWORD>(size - done > MAX_READ ? MAX_READ : size - done);
+			OVERLAPPED ov      = {};
+			DWORD read         = 0;
+
+			ov.Offset     = static_cast<DWORD>(pos & 0xffffffff);
+			ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+
+			if (!ReadFile(m_hFile, static_cast<uint8_t *>(pData) + done, chunk, &read, &ov) || read == 0)
+				return false;
+
+			done += read;
+		}
+
+		return true;
+	}
+
+private:
+	void closeMapping()
+	{
+		if (m_pView != NULL)
+		{
+			UnmapViewOfFile(m_pView);
+			m_pView = NULL;
+		}
+
+		if (m_hMapping != NULL)
+		{
+			CloseHandle(m_hMapping);
+			m_hMapping = NULL;
+		}
+	}
+
+private:
+	HANDLE m_hFile    = INVALID_HANDLE_VALUE;
+	HANDLE m_hMapping = NULL;
+	uint8_t *m_pView  = NULL;
+	uint64_t m_size   = 0;
+};
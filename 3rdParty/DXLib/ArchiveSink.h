@@ -0,0 +1,151 @@
+/*
+ *  File: ArchiveSink.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+#include <tchar.h>
+#include <windows.h>
+
+// Output of DecodeArchive of all archive versions, paths are the output paths built from the OutputPath and the entry names.
+// A file is written as OpenFile, any number of WriteFile calls with its handle and CloseFile.
+// Different files are written by the decode workers at the same time, only the calls for one handle are sequential.
+// A NULL handle or a failed WriteFile or CloseFile makes DecodeArchive fail, the file is then not passed to the observer.
+// A file whose data is corrupt is ended with FailFile instead of CloseFile, DecodeArchive only continues if the sink recorded it.
+// MakeDirectory is called for all directories before the first file is opened.
+class DXArchiveSink
+{
+public:
+	// Handle of an open file, NULL if the file could not be opened
+	using FileHandle = void *;
+
+public:
+	virtual ~DXArchiveSink() = default;
+
+	virtual void MakeDirectory(const std::wstring &dirPath) = 0;
+
+	// Start a new file, size is the DataSize of its file head
+	virtual FileHandle OpenFile(const std::wstring &filePath, const uint64_t &size) = 0;
+	virtual bool WriteFile(FileHandle hFile, const void *pData, const uint64_t &size) = 0;
+
+	// Finish the file and release its handle, the times are the FILETIME values of its file head.
+	// Always releases the handle, false if the file could not be completed
+	virtual bool CloseFile(FileHandle hFile, const uint64_t &create, const uint64_t &lastAccess, const uint64_t &lastWrite, const uint64_t &attributes) = 0;
+
+	// The file could not be decoded, hFile is NULL if it was not opened yet and is always released.
+	// True if the failure was recorded and the other files are still decoded
+	virtual bool FailFile(FileHandle hFile, const std::wstring &filePath, const uint64_t &size, const char *error) = 0;
+
+	// Drop the warning v3.5 prepends to some files, which breaks the unpacked game
+	virtual bool RemoveUnpackProtection() const
+	{
+		return true;
+	}
+};
+
+// Writes the extracted files to disk, used by DecodeArchive if no sink is given
+class DXArchiveDiskSink : public DXArchiveSink
+{
+public:
+	void MakeDirectory(const std::wstring &dirPath) override
+	{
+		CreateDirectory(dirPath.c_str(), NULL);
+	}
+
+	FileHandle OpenFile(const std::wstring &filePath, const uint64_t &size) override
+	{
+		FILE *pFile = _tfopen(filePath.c_str(), TEXT("wb"));
+		if (pFile == NULL) return NULL;
+
+		return new File{ filePath, pFile };
+	}
+
+	bool WriteFile(FileHandle hFile, const void *pData, const uint64_t &size) override
+	{
+		if (hFile == NULL) return false;
+
+		// A short write means the disk is full or the file is gone
+		return fwrite(pData, 1, static_cast<size_t>(size), static_cast<File *>(hFile)->pFile) == static_cast<size_t>(size);
+	}
+
+	bool CloseFile(FileHandle hFile, const uint64_t &create, const uint64_t &lastAccess, const uint64_t &lastWrite, const uint64_t &attributes) override
+	{
+		if (hFile == NULL) return false;
+
+		File *pFile = static_cast<File *>(hFile);
+
+		// fclose writes the remaining buffered data
+		if (fclose(pFile->pFile) != 0)
+		{
+			delete pFile;
+			return false;
+		}
+
+		HANDLE hTimeFile = CreateFile(pFile->path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (hTimeFile != INVALID_HANDLE_VALUE)
+		{
+			const FILETIME createTime     = toFileTime(create);
+			const FILETIME lastAccessTime = toFileTime(lastAccess);
+			const FILETIME lastWriteTime  = toFileTime(lastWrite);
+			SetFileTime(hTimeFile, &createTime, &lastAccessTime, &lastWriteTime);
+			CloseHandle(hTimeFile);
+		}
+
+		SetFileAttributes(pFile->path.c_str(), static_cast<DWORD>(attributes) & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
+
+		delete pFile;
+		return true;
+	}
+
+	// The partially written file is left behind, the failed DecodeArchive makes the caller retry or report it
+	bool FailFile(FileHandle hFile, const std::wstring &filePath, const uint64_t &size, const char *error) override
+	{
+		if (hFile == NULL) return false;
+
+		File *pFile = static_cast<File *>(hFile);
+		fclose(pFile->pFile);
+		delete pFile;
+		return false;
+	}
+
+private:
+	struct File
+	{
+		std::wstring path = L"";
+		FILE *pFile       = NULL;
+	};
+
+	static FILETIME toFileTime(const uint64_t &time)
+	{
+		FILETIME fileTime;
+		fileTime.dwHighDateTime = static_cast<DWORD>(time >> 32);
+		fileTime.dwLowDateTime  = static_cast<DWORD>(time & 0xffffffff);
+		return fileTime;
+	}
+};
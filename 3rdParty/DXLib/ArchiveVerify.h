@@ -0,0 +1,183 @@
+/*
+ *  File: ArchiveVerify.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ArchiveSink.h"
+#include "Crc32.h"
+
+// Result of decoding one file of an archive without writing it
+struct DXArchiveVerifyEntry
+{
+	std::wstring path    = L""; // Relative to the archive root, separated by '/'
+	uint64_t dataSize    = 0;   // DARC_FILEHEAD::DataSize
+	uint64_t decodedSize = 0;   // Bytes the decoder produced
+	uint32_t crc         = 0;   // CRC32 of the decoded data
+	std::string error    = "";  // Why the file could not be decoded, empty if it was
+
+	bool IsValid() const
+	{
+		return error.empty() && decodedSize == dataSize;
+	}
+};
+
+struct DXArchiveVerifyReport
+{
+	std::vector<DXArchiveVerifyEntry> entries = {}; // Sorted by path
+	bool decoded                              = false; // DecodeArchive finished without an error
+	double seconds                            = 0.0;   // Time spent in DecodeArchive
+
+	uint64_t GetTotalSize() const
+	{
+		uint64_t size = 0;
+
+		for (const DXArchiveVerifyEntry &entry : entries)
+			size += entry.decodedSize;
+
+		return size;
+	}
+
+	// Decoded bytes per second
+	double GetThroughput() const
+	{
+		return (seconds > 0.0 ? static_cast<double>(GetTotalSize()) / seconds : 0.0);
+	}
+
+	std::size_t GetInvalidCount() const
+	{
+		return static_cast<std::size_t>(std::count_if(entries.begin(), entries.end(), [](const DXArchiveVerifyEntry &entry) { return !entry.IsValid(); }));
+	}
+
+	bool IsValid() const
+	{
+		return decoded && GetInvalidCount() == 0;
+	}
+
+	// CRC32 over the CRCs of all entries in path order, identical for identical contents regardless of the decode order
+	uint32_t GetHash() const
+	{
+		uint32_t crc = 0;
+
+		for (const DXArchiveVerifyEntry &entry : entries)
+			crc = crc32::update(crc, &entry.crc, sizeof(entry.crc));
+
+		return crc;
+	}
+};
+
+// Discards the decoded files and only records their size and CRC32, used to check that a key decodes a whole archive.
+// Every open file has its own entry, only adding the finished entry to the report is locked.
+// Files which fail to decode are recorded with the size decoded until the error, the other files are still decoded.
+class DXArchiveVerifySink : public DXArchiveSink
+{
+public:
+	explicit DXArchiveVerifySink(DXArchiveVerifyReport &report) :
+		m_report(report)
+	{
+	}
+
+	void MakeDirectory(const std::wstring &dirPath) override
+	{
+	}
+
+	FileHandle OpenFile(const std::wstring &filePath, const uint64_t &size) override
+	{
+		DXArchiveVerifyEntry *pEntry = new DXArchiveVerifyEntry();
+		pEntry->path     = filePath;
+		pEntry->dataSize = size;
+
+		std::replace(pEntry->path.begin(), pEntry->path.end(), L'\\', L'/');
+
+		// Decoded without an output directory, the paths are already archive relative except for a leading separator
+		const std::size_t start = pEntry->path.find_first_not_of(L'/');
+		pEntry->path.erase(0, (start == std::wstring::npos ? pEntry->path.size() : start));
+
+		return pEntry;
+	}
+
+	bool WriteFile(FileHandle hFile, const void *pData, const uint64_t &size) override
+	{
+		if (hFile == NULL) return false;
+
+		DXArchiveVerifyEntry *pEntry = static_cast<DXArchiveVerifyEntry *>(hFile);
+		pEntry->crc = crc32::update(pEntry->crc, pData, static_cast<std::size_t>(size));
+		pEntry->decodedSize += size;
+		return true;
+	}
+
+	bool CloseFile(FileHandle hFile, const uint64_t &create, const uint64_t &lastAccess, const uint64_t &lastWrite, const uint64_t &attributes) override
+	{
+		if (hFile == NULL) return false;
+
+		add(static_cast<DXArchiveVerifyEntry *>(hFile));
+		return true;
+	}
+
+	bool FailFile(FileHandle hFile, const std::wstring &filePath, const uint64_t &size, const char *error) override
+	{
+		DXArchiveVerifyEntry *pEntry = static_cast<DXArchiveVerifyEntry *>(hFile == NULL ? OpenFile(filePath, size) : hFile);
+		pEntry->error = error;
+
+		add(pEntry);
+		return true;
+	}
+
+	// The report has to show the data as stored, including the warning v3.5 prepends to some files
+	bool RemoveUnpackProtection() const override
+	{
+		return false;
+	}
+
+	// Sort the entries once the archive is decoded, the workers finish the files in any order
+	void Finish(const bool &decoded, const double &seconds)
+	{
+		std::sort(m_report.entries.begin(), m_report.entries.end(), [](const DXArchiveVerifyEntry &a, const DXArchiveVerifyEntry &b) { return a.path < b.path; });
+
+		m_report.decoded = decoded;
+		m_report.seconds = seconds;
+	}
+
+private:
+	void add(DXArchiveVerifyEntry *pEntry)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_report.entries.push_back(std::move(*pEntry));
+		}
+
+		delete pEntry;
+	}
+
+private:
+	DXArchiveVerifyReport &m_report;
+	std::mutex m_mtx;
+};
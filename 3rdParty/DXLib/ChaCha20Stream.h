@@ -0,0 +1,328 @@
+/*
+ *  File: ChaCha20Stream.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "KeyConvSimd.h"
+
+// ChaCha20 keystream of the ChaCha2 / CC2 Pro archives, same output as chacha20_init_block + chacha20_xor (WolfNew.h).
+// Any position is reached by setting the block counter, several blocks are generated at once with one block per vector lane.
+namespace chacha20Simd
+{
+struct Scalar
+{
+	using Vec                          = uint32_t;
+	static constexpr std::size_t LANES = 1;
+
+	static Vec Set(const uint32_t &value)
+	{
+		return value;
+	}
+
+	static Vec Lanes()
+	{
+		return 0;
+	}
+
+	static Vec Add(const Vec &a, const Vec &b)
+	{
+		return a + b;
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return a ^ b;
+	}
+
+	template<int N>
+	static Vec Rotl(const Vec &x)
+	{
+		return (x << N) | (x >> (32 - N));
+	}
+
+	static void Store(uint32_t *p, const Vec &v)
+	{
+		*p = v;
+	}
+};
+
+struct SSE2
+{
+	using Vec                          = __m128i;
+	static constexpr std::size_t LANES = 4;
+
+	static Vec Set(const uint32_t &value)
+	{
+		return _mm_set1_epi32(static_cast<int>(value));
+	}
+
+	static Vec Lanes()
+	{
+		return _mm_setr_epi32(0, 1, 2, 3);
+	}
+
+	static Vec Add(const Vec &a, const Vec &b)
+	{
+		return _mm_add_epi32(a, b);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm_xor_si128(a, b);
+	}
+
+	template<int N>
+	static Vec Rotl(const Vec &x)
+	{
+		return _mm_or_si128(_mm_slli_epi32(x, N), _mm_srli_epi32(x, 32 - N));
+	}
+
+	static void Store(uint32_t *p, const Vec &v)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+	}
+};
+
+struct AVX2
+{
+	using Vec                          = __m256i;
+	static constexpr std::size_t LANES = 8;
+
+	static Vec Set(const uint32_t &value)
+	{
+		return _mm256_set1_epi32(static_cast<int>(value));
+	}
+
+	static Vec Lanes()
+	{
+		return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	}
+
+	static Vec Add(const Vec &a, const Vec &b)
+	{
+		return _mm256_add_epi32(a, b);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm256_xor_si256(a, b);
+	}
+
+	template<int N>
+	static Vec Rotl(const Vec &x)
+	{
+		return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N));
+	}
+
+	static void Store(uint32_t *p, const Vec &v)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+	}
+};
+
+struct AVX512
+{
+	using Vec                          = __m512i;
+	static constexpr std::size_t LANES = 16;
+
+	static Vec Set(const uint32_t &value)
+	{
+		return _mm512_set1_epi32(static_cast<int>(value));
+	}
+
+	static Vec Lanes()
+	{
+		return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	}
+
+	static Vec Add(const Vec &a, const Vec &b)
+	{
+		return _mm512_add_epi32(a, b);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm512_xor_si512(a, b);
+	}
+
+	template<int N>
+	static Vec Rotl(const Vec &x)
+	{
+		return _mm512_rol_epi32(x, N);
+	}
+
+	static void Store(uint32_t *p, const Vec &v)
+	{
+		_mm512_storeu_si512(p, v);
+	}
+};
+
+// Keystream of Ops::LANES consecutive blocks, the first one uses the counter of pState, the low counter word must not overflow within them
+template<typename Ops>
+inline void generateBlocks(const uint32_t *pState, uint8_t *pKeyStream)
+{
+	typename Ops::Vec s[16];
+	typename Ops::Vec x[16];
+
+	for (std::size_t i = 0; i < 16; i++)
+		s[i] = Ops::Set(pState[i]);
+
+	s[12] = Ops::Add(s[12], Ops::Lanes());
+
+	for (std::size_t i = 0; i < 16; i++)
+		x[i] = s[i];
+
+	const auto quarterRound = [&x](const std::size_t &a, const std::size_t &b, const std::size_t &c, const std::size_t &d) {
+		x[a] = Ops::Add(x[a], x[b]);
+		x[d] = Ops::template Rotl<16>(Ops::Xor(x[d], x[a]));
+		x[c] = Ops::Add(x[c], x[d]);
+		x[b] = Ops::template Rotl<12>(Ops::Xor(x[b], x[c]));
+		x[a] = Ops::Add(x[a], x[b]);
+		x[d] = Ops::template Rotl<8>(Ops::Xor(x[d], x[a]));
+		x[c] = Ops::Add(x[c], x[d]);
+		x[b] = Ops::template Rotl<7>(Ops::Xor(x[b], x[c]));
+	};
+
+	for (uint32_t i = 0; i < 10; i++)
+	{
+		quarterRound(0, 4, 8, 12);
+		quarterRound(1, 5, 9, 13);
+		quarterRound(2, 6, 10, 14);
+		quarterRound(3, 7, 11, 15);
+		quarterRound(0, 5, 10, 15);
+		quarterRound(1, 6, 11, 12);
+		quarterRound(2, 7, 8, 13);
+		quarterRound(3, 4, 9, 14);
+	}
+
+	// The vectors hold word i of every block, the keystream is block after block
+	uint32_t words[16][Ops::LANES];
+
+	for (std::size_t i = 0; i < 16; i++)
+		Ops::Store(words[i], Ops::Add(x[i], s[i]));
+
+	uint32_t *pOut = reinterpret_cast<uint32_t *>(pKeyStream);
+
+	for (std::size_t lane = 0; lane < Ops::LANES; lane++)
+	{
+		for (std::size_t i = 0; i < 16; i++)
+			pOut[lane * 16 + i] = words[i][lane];
+	}
+}
+} // namespace chacha20Simd
+
+class ChaCha20Stream
+{
+public:
+	static constexpr uint32_t BLOCK_SIZE = 64;
+
+public:
+	void Init(const uint8_t *pKey, const uint8_t *pNonce)
+	{
+		static constexpr char MAGIC_CONSTANT[] = "expand 32-byte k";
+
+		std::memcpy(m_state, MAGIC_CONSTANT, 16);
+		std::memcpy(m_state + 4, pKey, 32);
+		m_state[12] = 1; // Initialize the counter to 1
+		std::memcpy(m_state + 13, pNonce, 12);
+	}
+
+	// Same as chacha20_xor on a freshly initialized state, startPos is the position of the first byte
+	void Apply(uint8_t *pData, const uint64_t &startPos, const uint64_t &length) const
+	{
+		static const ApplyFunction applyFunc = selectApply(simd::detectCpuFeatures());
+		applyFunc(m_state, pData, startPos, length);
+	}
+
+private:
+	using ApplyFunction = void (*)(const uint32_t *, uint8_t *, const uint64_t &, const uint64_t &);
+
+	static ApplyFunction selectApply(const simd::CpuFeatures &features)
+	{
+		if (features.avx512f)
+			return apply<chacha20Simd::AVX512>;
+		else if (features.avx2)
+			return apply<chacha20Simd::AVX2>;
+		else if (features.sse2)
+			return apply<chacha20Simd::SSE2>;
+		else
+			return apply<chacha20Simd::Scalar>;
+	}
+
+	template<typename Ops>
+	static void apply(const uint32_t *pInitState, uint8_t *pData, const uint64_t &startPos, const uint64_t &length)
+	{
+		constexpr uint64_t BATCH_SIZE = BLOCK_SIZE * Ops::LANES;
+
+		uint32_t state[16];
+		std::memcpy(state, pInitState, sizeof(state));
+
+		// The counter words 12 and 13 form a 64 bit counter, word 13 is the first nonce word which only changes on an overflow of word 12
+		uint64_t counter = ((static_cast<uint64_t>(state[13]) << 32) | state[12]) + startPos / BLOCK_SIZE;
+
+		uint8_t keyStream[BATCH_SIZE];
+		uint32_t offset   = static_cast<uint32_t>(startPos % BLOCK_SIZE);
+		uint64_t position = 0;
+
+		const auto setCounter = [&state](const uint64_t &value) {
+			state[12] = static_cast<uint32_t>(value);
+			state[13] = static_cast<uint32_t>(value >> 32);
+		};
+
+		while (position < length)
+		{
+			setCounter(counter);
+
+			// Full batches which do not overflow the low counter word use all lanes, everything else goes block by block
+			if (offset == 0 && length - position >= BATCH_SIZE && static_cast<uint32_t>(counter) <= UINT32_MAX - (Ops::LANES - 1))
+			{
+				chacha20Simd::generateBlocks<Ops>(state, keyStream);
+				keyConv::xorStream(pData + position, keyStream, BATCH_SIZE, 0);
+
+				position += BATCH_SIZE;
+				counter += Ops::LANES;
+				continue;
+			}
+
+			const uint64_t steps = std::min<uint64_t>(BLOCK_SIZE - offset, length - position);
+
+			chacha20Simd::generateBlocks<chacha20Simd::Scalar>(state, keyStream);
+			keyConv::xorStream(pData + position, keyStream + offset, steps, 0);
+
+			position += steps;
+			counter++;
+			offset = 0;
+		}
+	}
+
+private:
+	uint32_t m_state[16] = {};
+};
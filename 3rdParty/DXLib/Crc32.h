@@ -0,0 +1,178 @@
+/*
+ *  File: Crc32.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
+// CRC32 (reflected polynomial 0xedb88320, as used by zlib) shared by DXArchive::HashCRC32 and FileLib_HashCRC32.
+// Short data is processed eight bytes at a time through slicing-by-8 tables, long data is folded 64 bytes at a time
+// with carry-less multiplications (Intel, "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ").
+namespace crc32
+{
+constexpr uint32_t POLY = 0xedb88320;
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+consteval Tables makeTables()
+{
+	Tables tables{};
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t data = i;
+		for (uint32_t j = 0; j < 8; j++)
+			data = (data >> 1) ^ ((data & 1) ? POLY : 0);
+
+		tables[0][i] = data;
+	}
+
+	// tables[k][i] is the CRC of byte i followed by k zero bytes
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		for (std::size_t k = 1; k < 8; k++)
+			tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+	}
+
+	return tables;
+}
+
+inline constexpr Tables TABLES = makeTables();
+
+// Update the CRC register (not inverted) with size bytes
+inline uint32_t updatePlain(uint32_t crc, const uint8_t *pData, std::size_t size)
+{
+	for (; size >= 8; pData += 8, size -= 8)
+	{
+		uint32_t lo;
+		uint32_t hi;
+		std::memcpy(&lo, pData, sizeof(lo));
+		std::memcpy(&hi, pData + 4, sizeof(hi));
+		lo ^= crc;
+
+		crc = TABLES[7][lo & 0xff] ^ TABLES[6][(lo >> 8) & 0xff] ^ TABLES[5][(lo >> 16) & 0xff] ^ TABLES[4][lo >> 24] //
+			  ^ TABLES[3][hi & 0xff] ^ TABLES[2][(hi >> 8) & 0xff] ^ TABLES[1][(hi >> 16) & 0xff] ^ TABLES[0][hi >> 24];
+	}
+
+	for (; size > 0; pData++, size--)
+		crc = TABLES[0][(crc ^ *pData) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+// Folding needs at least one block of 64 bytes, the register setup costs more than it saves below a few blocks
+constexpr std::size_t FOLD_MIN = 256;
+
+inline uint32_t updateClmul(uint32_t crc, const uint8_t *pData, std::size_t size)
+{
+	if (size < FOLD_MIN)
+		return updatePlain(crc, pData, size);
+
+	// Folding constants x^(4*128+32), x^(4*128-32), x^(128+32), x^(128-32), x^64 mod P(x) and the Barrett constants P(x), mu
+	alignas(16) static const uint64_t K1K2[2] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static const uint64_t K3K4[2] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static const uint64_t K5K0[2] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static const uint64_t POLY_MU[2] = { 0x01db710641, 0x01f7011641 };
+
+	const auto load = [](const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+	const auto fold = [](const __m128i &x, const __m128i &k, const __m128i &next) {
+		return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+	};
+
+	__m128i x1 = _mm_xor_si128(load(pData), _mm_cvtsi32_si128(static_cast<int>(crc)));
+	__m128i x2 = load(pData + 0x10);
+	__m128i x3 = load(pData + 0x20);
+	__m128i x4 = load(pData + 0x30);
+	__m128i k  = _mm_load_si128(reinterpret_cast<const __m128i *>(K1K2));
+
+	pData += 64;
+	size -= 64;
+
+	// Fold four independent lanes by 512 bits
+	for (; size >= 64; pData += 64, size -= 64)
+	{
+		x1 = fold(x1, k, load(pData));
+		x2 = fold(x2, k, load(pData + 0x10));
+		x3 = fold(x3, k, load(pData + 0x20));
+		x4 = fold(x4, k, load(pData + 0x30));
+	}
+
+	// Fold the lanes into one, then the remaining full 16 byte blocks
+	k  = _mm_load_si128(reinterpret_cast<const __m128i *>(K3K4));
+	x1 = fold(x1, k, x2);
+	x1 = fold(x1, k, x3);
+	x1 = fold(x1, k, x4);
+
+	for (; size >= 16; pData += 16, size -= 16)
+		x1 = fold(x1, k, load(pData));
+
+	// Reduce 128 to 64 bits
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	k  = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(K5K0));
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00), x2);
+
+	// Barrett reduction to 32 bits
+	k  = _mm_load_si128(reinterpret_cast<const __m128i *>(POLY_MU));
+	x2 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10), mask32);
+	x1 = _mm_xor_si128(x1, _mm_clmulepi64_si128(x2, k, 0x00));
+
+	crc = static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+
+	return updatePlain(crc, pData, size);
+}
+
+using UpdateFunction = uint32_t (*)(uint32_t, const uint8_t *, std::size_t);
+
+inline UpdateFunction selectUpdate(const simd::CpuFeatures &features)
+{
+	if (features.pclmul && features.sse4_1)
+		return updateClmul;
+	else
+		return updatePlain;
+}
+
+// Continue a CRC32 over the next size bytes, start with crc = 0 and pass the previous result for further chunks
+inline uint32_t update(const uint32_t &crc, const void *pData, const std::size_t &size)
+{
+	static const UpdateFunction updateFunc = selectUpdate(simd::detectCpuFeatures());
+	return ~updateFunc(~crc, static_cast<const uint8_t *>(pData), size);
+}
+
+inline uint32_t hash(const void *pData, const std::size_t &size)
+{
+	return update(0, pData, size);
+}
+} // namespace crc32
@@ -13,12 +13,19 @@
 // include ----------------------------
 #include "DXArchive.h"
 #include "CharCode.h"
+#include "Crc32.h"
 #include "FileLib.h"
 #include "Huffman.h"
+#include "LzDecode.h"
 #include <stdio.h>
 #include <string.h>
 #include <windows.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
 // define -----------------------------
 
 #define MIN_COMPRESS       (4)                     // 最低圧縮バイト数
@@ -30,15 +37,8 @@
 
 #define GLOBAL_CHAR_CODE 932
 
-uint8_t g_specialKey[768] = {};
-bool g_newCrypt           = false;
-bool g_chacha20           = false;
-uint16_t g_cryptVersion   = 0;
-
-uint8_t g_cc20Key[32]   = { 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD };
-uint8_t g_cc20Nonce[12] = { 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85 };
-
-
+// Crypt context bound to the current thread, see DXArchiveCryptScope
+static thread_local const DXArchiveCrypt *t_pCrypt = nullptr;
 
 static WCHAR *sjis2utf8(const char *sjis, const int32_t &len);
 static char *utf82sjis(const WCHAR *utf8);
@@ -63,6 +63,183 @@ size_t LogStringLength = 0;
 // Functions for new Wolf Crypt
 #include "WolfNew.h"
 
+#include "ArchiveBufferPool.h"
+#include "ArchiveListing.h"
+#include "ArchiveObserver.h"
+#include "ArchiveProbe.h"
+#include "ArchiveReader.h"
+#include "ArchiveSink.h"
+#include "KeyConvSimd.h"
+
+// Join an output directory and an archive entry name, an empty directory refers to the current directory
+static std::wstring JoinOutputPath(const std::wstring &dir, const TCHAR *pName)
+{
+	if (dir.empty()) return std::wstring(pName);
+
+	std::wstring path = dir;
+	if (path.back() != TEXT('\\') && path.back() != TEXT('/'))
+		path += TEXT('\\');
+
+	return path + pName;
+}
+
+// Add a size of a file head to Sum, false if the sum does not fit into 64 bits (only a damaged or wrongly decrypted header gets there)
+static bool AddSize(u64 &Sum, const u64 &Size)
+{
+	if (Size > UINT64_MAX - Sum) return false;
+
+	Sum += Size;
+	return true;
+}
+
+// Files of v3.5 archives which start with ANTI_UNPACK_DATA to break unpacked games
+static const std::vector<std::wstring> UNPACK_PROTECTION_FILES = { L"game.dat", L"cdatabase.dat", L"database.dat", L"commonevent.dat" };
+static const uint8_t ANTI_UNPACK_DATA[62]                      = { 0x45, 0x78, 0x74, 0x72, 0x61, 0x63, 0x74, 0x69, 0x6E, 0x67, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x72, 0x6F, 0x6D, 0x20, 0x65, 0x6E, 0x63, 0x72, 0x79, 0x70, 0x74, 0x65, 0x64, 0x20, 0x66, 0x69, 0x6C, 0x65, 0x73, 0x20, 0x76, 0x69, 0x6F, 0x6C, 0x61, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x75, 0x69, 0x64, 0x65, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x00 };
+
+static bool IsUnpackProtectionFile(const TCHAR *pName)
+{
+	std::wstring fileName = std::wstring(pName);
+	std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
+
+	// As I am not sure if the file name will contain only the actual file name or also a directory
+	// check if the file name ends with any of the unpack protection files
+	for (const std::wstring &unpackProtectionFile : UNPACK_PROTECTION_FILES)
+	{
+		if (fileName.ends_with(unpackProtectionFile))
+			return true;
+	}
+
+	return false;
+}
+
+// crypt context ----------------------
+
+void DXArchiveCrypt::Setup(const uint16_t &version, const char *pKeyString, const size_t &keyStringBytes)
+{
+	cryptVersion = version;
+	newCrypt     = (version >= 331 && version < 1000 || version >= 1010);
+	chacha20     = version == 0x64 || version == 0xC8;
+
+	if (version == 0xC8)
+	{
+		std::array<uint8_t, 4> data;
+		std::array<uint8_t, 64> key;
+
+		std::memcpy(data.data(), (uint8_t *)pKeyString + keyStringBytes + 1, 4);
+		chacha20_keySetup(data, key);
+
+		std::memcpy(cc20Key, key.data(), 32);
+		std::memcpy(cc20Nonce, key.data() + 34, 12);
+	}
+
+	if (chacha20)
+		cc20Stream.Init(cc20Key, cc20Nonce);
+
+	if (newCrypt)
+		memset(specialKey, 0, sizeof(specialKey));
+}
+
+void DXArchiveCrypt::DecryptArchiveData(void *pData, const int64_t &size, const int64_t &offset) const
+{
+	uint8_t *pBytes = reinterpret_cast<uint8_t *>(pData);
+
+	const int64_t cryptStart = std::max<int64_t>(offset, sizeof(DARC_HEAD));
+	const int64_t cryptEnd   = std::min<int64_t>(offset + size, archiveCryptEnd);
+	if (cryptStart < cryptEnd)
+		archiveStream.Apply(pBytes + (cryptStart - offset), cryptStart, cryptEnd);
+
+	// The overlays are plain keystreams, so they can be applied in any order
+	const auto applyOverlay = [&](const std::vector<uint8_t> &overlay, const int64_t &overlayStart) {
+		const int64_t start = std::max<int64_t>(offset, overlayStart);
+		const int64_t end   = std::min<int64_t>(offset + size, overlayStart + static_cast<int64_t>(overlay.size()));
+
+		if (start < end)
+			keyConv::xorStream(pBytes + (start - offset), overlay.data() + (start - overlayStart), end - start, 0);
+	};
+
+	applyOverlay(bodyOverlay, sizeof(DARC_HEAD));
+	applyOverlay(tableOverlay, static_cast<int64_t>(tableStart));
+}
+
+bool DXArchiveCrypt::SetupArchive(DARC_HEAD &head, const int64_t &archiveSize, const char *pKeyString, const size_t &keyStringBytes)
+{
+	const uint8_t *pPwd = head.Reserve;
+
+	cryptAddresses((uint8_t *)&head, pPwd, cryptVersion);
+
+	if (head.FileNameTableStartAddress > static_cast<uint64_t>(archiveSize))
+		return false;
+
+	uint8_t *pK2 = nullptr;
+
+	if (cryptVersion >= 1010)
+		pK2 = (uint8_t *)pKeyString + keyStringBytes + 1;
+
+	// The whole archive is encrypted with a key depending on the file offset, it is removed on every read from the archive
+	initWolfCrypt(cryptVersion, pPwd, archiveKey, nullptr, nullptr, 0, 0, true, pKeyString);
+	archiveStream.Init(archiveKey, isV35(cryptVersion));
+	archiveCryptEnd = archiveSize - 64;
+
+	uint8_t roundKey[AES_ROUND_KEY_SIZE] = { 0 };
+	initAES128(roundKey, pPwd, pK2, cryptVersion);
+
+	// The size is compared with 64 bits, truncating it would select a wrong size for archives above 4 GiB
+	uint64_t bodySize = 0x400;
+
+	if (isV35(cryptVersion))
+	{
+		uint32_t seed = 0;
+
+		if (cryptVersion >= 1020)
+			seed = pK2[0] * pK2[1] + pPwd[2] * pPwd[4] + pPwd[11];
+		else
+			seed = pPwd[2] * pPwd[4] + pPwd[12]; // xorShift32 seed
+
+		if (!seed) seed = 1;
+		xorshift32(seed);
+
+		if (archiveSize >= static_cast<int64_t>(xorshift32() % 500 + 800))
+			xorshift32();
+
+		bodySize = static_cast<uint64_t>(archiveSize - 64); // 64 is the header size -- maybe replace with a constant
+
+		if (bodySize >= (xorshift32() % 500 + 800))
+			bodySize = (xorshift32() % 500) + 800;
+	}
+
+	// Only the beginning of the data and the header tables are AES encrypted, keep the keystream of
+	// these parts instead of decrypting a copy of the whole archive
+	bodyOverlay.resize(static_cast<size_t>(bodySize));
+	aesCtrXCrypt(bodyOverlay.data(), roundKey, bodyOverlay.size()); // For v3.31 this has to be 0x400
+
+	tableStart = head.FileNameTableStartAddress;
+	tableOverlay.resize(static_cast<size_t>(archiveSize - head.FileNameTableStartAddress));
+	aesCtrXCrypt(tableOverlay.data(), roundKey, tableOverlay.size());
+
+	archiveCrypt = true;
+
+	initWolfCrypt(cryptVersion, pPwd, specialKey, pK2);
+	specialStream.Init(specialKey, isV35(cryptVersion));
+
+	return true;
+}
+
+DXArchiveCryptScope::DXArchiveCryptScope(const DXArchiveCrypt *pCrypt) :
+	m_pPrev(t_pCrypt)
+{
+	t_pCrypt = pCrypt;
+}
+
+DXArchiveCryptScope::~DXArchiveCryptScope()
+{
+	t_pCrypt = m_pPrev;
+}
+
+const DXArchiveCrypt *DXArchiveCryptScope::Current()
+{
+	return t_pCrypt;
+}
+
 // class code -------------------------
 
 // ファイル名も一緒になっていると分かっているパス中からファイルパスとディレクトリパスを分割する
@@ -116,8 +293,6 @@ DARC_FILEHEAD *DXArchive::GetFileInfo(const TCHAR *FilePath, DARC_DIRECTORY **Di
 {
 	DARC_DIRECTORY *OldDir;
 	DARC_FILEHEAD *FileH;
-	u8 *NameData;
-	int i, j, k, Num, FileHeadSize;
 	SEARCHDATA SearchData;
 
 	// 元のディレクトリを保存しておく
@@ -140,29 +315,10 @@ DARC_FILEHEAD *DXArchive::GetFileInfo(const TCHAR *FilePath, DARC_DIRECTORY **Di
 	}
 
 	// 同名のファイルを探す
-	FileHeadSize = sizeof(DARC_FILEHEAD);
-	FileH        = (DARC_FILEHEAD *)(this->FileP + this->CurrentDirectory->FileHeadAddress);
-	Num          = (int)this->CurrentDirectory->FileHeadNum;
-	for (i = 0; i < Num; i++, FileH = (DARC_FILEHEAD *)((u8 *)FileH + FileHeadSize))
-	{
-		// ディレクトリチェック
-		if ((FileH->Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) continue;
-
-		// 文字列数とパリティチェック
-		NameData = this->NameP + FileH->NameAddress;
-		if (SearchData.PackNum != ((u16 *)NameData)[0] || SearchData.Parity != ((u16 *)NameData)[1]) continue;
-
-		// 文字列チェック
-		NameData += 4;
-		for (j = 0, k = 0; j < SearchData.PackNum; j++, k += 4)
-			if (*((u32 *)&SearchData.FileName[k]) != *((u32 *)&NameData[k])) break;
-
-		// 適合したファイルがあったらここで終了
-		if (SearchData.PackNum == j) break;
-	}
+	FileH = SearchFileHead(&SearchData, false);
 
 	// 無かったらエラー
-	if (i == Num) goto ERR;
+	if (FileH == NULL) goto ERR;
 
 	// ディレクトリのアドレスを保存する指定があった場合は保存
 	if (DirectoryP != NULL)
@@ -368,13 +524,13 @@ void DXArchive::fwrite64(void *Data, s64 Size, FILE *fp)
 	TotalWriteSize = 0;
 	while (TotalWriteSize < Size)
 	{
-		if (Size > 0x7fffffff)
+		if (Size - TotalWriteSize > 0x7fffffff)
 		{
 			WriteSize = 0x7fffffff;
 		}
 		else
 		{
-			WriteSize = (int)Size;
+			WriteSize = (int)(Size - TotalWriteSize);
 		}
 
 		fwrite((u8 *)Data + TotalWriteSize, 1, WriteSize, fp);
@@ -392,13 +548,13 @@ void DXArchive::fread64(void *Buffer, s64 Size, FILE *fp)
 	TotalReadSize = 0;
 	while (TotalReadSize < Size)
 	{
-		if (Size > 0x7fffffff)
+		if (Size - TotalReadSize > 0x7fffffff)
 		{
 			ReadSize = 0x7fffffff;
 		}
 		else
 		{
-			ReadSize = (int)Size;
+			ReadSize = (int)(Size - TotalReadSize);
 		}
 
 		fread((u8 *)Buffer + TotalReadSize, 1, ReadSize, fp);
@@ -475,36 +631,82 @@ void DXArchive::NotConvFileRead(void *Data, s64 Size, FILE *fp)
 // カレントディレクトリにある指定のファイルの鍵用の文字列を作成する、戻り値は文字列の長さ( 単位：Byte )( FileString は DXA_KEY_STRING_MAXLENGTH の長さが必要 )
 size_t DXArchive::CreateKeyFileString(int CharCodeFormat, const char *KeyString, size_t KeyStringBytes, DARC_DIRECTORY *Directory, DARC_FILEHEAD *FileHead, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable, u8 *FileString)
 {
-	size_t StartAddr;
+	std::string DirectoryString;
+
+	CreateKeyDirectoryString(CharCodeFormat, Directory, FileTable, DirectoryTable, NameTable, &DirectoryString);
+
+	return CreateKeyFileString(CharCodeFormat, KeyString, KeyStringBytes, DirectoryString, FileHead, NameTable, FileString);
+}
+
+// The key string is the password, the file name and DirectoryString, cut like the CL_strcat_s calls of the original implementation did
+size_t DXArchive::CreateKeyFileString(int CharCodeFormat, const char *KeyString, size_t KeyStringBytes, const std::string &DirectoryString, DARC_FILEHEAD *FileHead, u8 *NameTable, u8 *FileString)
+{
+	const size_t UnitSize = GetCharCodeFormatUnitSize(CharCodeFormat);
+	const char *FileName  = (char *)(NameTable + FileHead->NameAddress + 4);
+	size_t StartAddr, BufferBytes, MaxLength, Length, CopyLength;
 
 	// 最初にパスワードの文字列をセット
 	if (KeyString != NULL && KeyStringBytes != 0)
 	{
 		memcpy(FileString, KeyString, KeyStringBytes);
-		FileString[KeyStringBytes] = '\0';
-		StartAddr                  = KeyStringBytes;
+		StartAddr = KeyStringBytes;
 	}
 	else
 	{
-		FileString[0] = '\0';
-		StartAddr     = 0;
+		StartAddr = 0;
 	}
 	memset(&FileString[DXA_KEY_STRING_MAXLENGTH - 8], 0, 8);
 
+	// Characters which fit behind the password, one is left for the terminator
+	BufferBytes = (DXA_KEY_STRING_MAXLENGTH - 8) - StartAddr;
+	MaxLength   = BufferBytes > UnitSize ? (BufferBytes - 1) / UnitSize : 0;
+
 	// 次にファイル名の文字列をセット
-	CL_strcat_s(CharCodeFormat, (char *)&FileString[StartAddr], (DXA_KEY_STRING_MAXLENGTH - 8) - StartAddr, (char *)(NameTable + FileHead->NameAddress + 4));
+	Length = std::min<size_t>((size_t)CL_strlen(CharCodeFormat, FileName), MaxLength);
+	memcpy(&FileString[StartAddr], FileName, Length * UnitSize);
 
 	// その後にディレクトリの文字列をセット
+	CopyLength = std::min<size_t>(DirectoryString.size() / UnitSize, MaxLength - Length);
+	memcpy(&FileString[StartAddr + Length * UnitSize], DirectoryString.data(), CopyLength * UnitSize);
+	Length += CopyLength;
+
+	memset(&FileString[StartAddr + Length * UnitSize], 0, UnitSize);
+
+	return StartAddr + Length * UnitSize;
+}
+
+// Directory part of the key strings, the names of the directory and its parents up to the root directory
+void DXArchive::CreateKeyDirectoryString(int CharCodeFormat, DARC_DIRECTORY *Directory, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable, std::string *DirectoryString)
+{
+	const size_t UnitSize = GetCharCodeFormatUnitSize(CharCodeFormat);
+
+	DirectoryString->clear();
+
+	while (Directory->ParentDirectoryAddress != 0xffffffffffffffff)
+	{
+		const char *Name = (char *)(NameTable + ((DARC_FILEHEAD *)(FileTable + Directory->DirectoryAddress))->NameAddress + 4);
+		DirectoryString->append(Name, CL_strlen(CharCodeFormat, Name) * UnitSize);
+
+		Directory = (DARC_DIRECTORY *)(DirectoryTable + Directory->ParentDirectoryAddress);
+	}
+}
+
+// CreateKeyDirectoryString which reuses the strings of the parent directories in Cache
+const std::string &DXArchive::KeyDirectoryString(KEYDIRECTORYCACHE *Cache, int CharCodeFormat, DARC_DIRECTORY *Directory, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable)
+{
+	KEYDIRECTORYCACHE::const_iterator Found = Cache->find(Directory);
+	if (Found != Cache->end()) return Found->second;
+
+	std::string DirectoryString;
+
 	if (Directory->ParentDirectoryAddress != 0xffffffffffffffff)
 	{
-		do
-		{
-			CL_strcat_s(CharCodeFormat, (char *)&FileString[StartAddr], (DXA_KEY_STRING_MAXLENGTH - 8) - StartAddr, (char *)(NameTable + ((DARC_FILEHEAD *)(FileTable + Directory->DirectoryAddress))->NameAddress + 4));
-			Directory = (DARC_DIRECTORY *)(DirectoryTable + Directory->ParentDirectoryAddress);
-		} while (Directory->ParentDirectoryAddress != 0xffffffffffffffff);
+		const char *Name = (char *)(NameTable + ((DARC_FILEHEAD *)(FileTable + Directory->DirectoryAddress))->NameAddress + 4);
+		DirectoryString.assign(Name, CL_strlen(CharCodeFormat, Name) * GetCharCodeFormatUnitSize(CharCodeFormat));
+		DirectoryString += KeyDirectoryString(Cache, CharCodeFormat, (DARC_DIRECTORY *)(DirectoryTable + Directory->ParentDirectoryAddress), FileTable, DirectoryTable, NameTable);
 	}
 
-	return StartAddr + CL_strlen(CharCodeFormat, (char *)&FileString[StartAddr]) * GetCharCodeFormatUnitSize(CharCodeFormat);
+	return Cache->emplace(Directory, std::move(DirectoryString)).first->second;
 }
 
 // 鍵文字列を作成
@@ -570,58 +772,31 @@ void DXArchive::KeyCreate(const char *Source, size_t SourceBytes, u8 *Key)
 // 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 void DXArchive::KeyConv(void *Data, s64 Size, s64 Position, unsigned char *Key)
 {
-	if (g_newCrypt)
+	const DXArchiveCrypt *pCrypt = DXArchiveCryptScope::Current();
+
+	if (pCrypt && pCrypt->newCrypt)
 	{
-		wolfCrypt(g_specialKey, reinterpret_cast<uint8_t *>(Data), Position, Position + Size, false, g_cryptVersion);
+		if (pCrypt->specialStream.IsValid())
+			pCrypt->specialStream.Apply(reinterpret_cast<uint8_t *>(Data), Position, Position + Size);
+		else
+			wolfCrypt(pCrypt->specialKey, reinterpret_cast<uint8_t *>(Data), Position, Position + Size, false, pCrypt->cryptVersion);
 		return;
 	}
 
-	if (g_chacha20)
+	if (pCrypt && pCrypt->chacha20)
 	{
-		uint32_t state[16];
-		uint32_t keystream32[16];
-
-		std::memset(state, 0, sizeof(state));
-		std::memset(keystream32, 0, sizeof(keystream32));
-
-		chacha20_init_block(state, g_cc20Key, g_cc20Nonce);
-		chacha20_xor(state, keystream32, static_cast<uint32_t>(Position), reinterpret_cast<uint8_t *>(Data), Size);
+		pCrypt->cc20Stream.Apply(reinterpret_cast<uint8_t *>(Data), Position, Size);
 		return;
 	}
 
-	if (Key == NULL)
+	if (Key == NULL || Size <= 0)
 	{
 		return;
 	}
 
 	Position %= DXA_KEY_BYTES;
 
-	if (Size < 0x100000000)
-	{
-		u32 i, j;
-
-		j = (u32)Position;
-		for (i = 0; i < Size; i++)
-		{
-			((u8 *)Data)[i] ^= Key[j];
-
-			j++;
-			if (j == DXA_KEY_BYTES) j = 0;
-		}
-	}
-	else
-	{
-		s64 i, j;
-
-		j = Position;
-		for (i = 0; i < Size; i++)
-		{
-			((u8 *)Data)[i] ^= Key[j];
-
-			j++;
-			if (j == DXA_KEY_BYTES) j = 0;
-		}
-	}
+	keyConv::xorKey<DXA_KEY_BYTES>(Data, Size, Position, Key);
 }
 
 // データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
@@ -651,7 +826,9 @@ void DXArchive::KeyConvFileWrite(void *Data, s64 Size, FILE *fp, unsigned char *
 // ファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 void DXArchive::KeyConvFileRead(void *Data, s64 Size, FILE *fp, unsigned char *Key, s64 Position)
 {
-	s64 pos = 0;
+	const DXArchiveCrypt *pCrypt = DXArchiveCryptScope::Current();
+	const s64 offset             = pCrypt && pCrypt->archiveCrypt ? _ftelli64(fp) : 0;
+	s64 pos                      = 0;
 
 	if (Key != NULL)
 	{
@@ -662,6 +839,9 @@ void DXArchive::KeyConvFileRead(void *Data, s64 Size, FILE *fp, unsigned char *K
 	// 読み込む
 	fread64(Data, Size, fp);
 
+	if (pCrypt && pCrypt->archiveCrypt)
+		pCrypt->DecryptArchiveData(Data, Size, offset);
+
 	if (Key != NULL)
 	{
 		// データを鍵文字列を使って Xor 演算
@@ -669,6 +849,62 @@ void DXArchive::KeyConvFileRead(void *Data, s64 Size, FILE *fp, unsigned char *K
 	}
 }
 
+// Positional version of KeyConvFileRead, the archive crypt uses Offset instead of the file position
+bool DXArchive::KeyConvFileReadAt(void *Data, s64 Size, const DXArchiveReader &Reader, s64 Offset, unsigned char *Key, s64 Position)
+{
+	const DXArchiveCrypt *pCrypt = DXArchiveCryptScope::Current();
+	const u8 *View               = Reader.GetView(Offset, Size);
+
+	// A mapped archive is copied and decrypted in blocks which are still in the cache when they are decrypted,
+	// instead of passing over the whole data once for the copy and once for each crypt
+	if (View != NULL)
+	{
+		Reader.Prefetch(Offset, Size);
+
+		for (s64 Done = 0; Done < Size; Done += DXA_MAP_BLOCKSIZE)
+		{
+			u8 *Block       = (u8 *)Data + Done;
+			const s64 Bytes = Size - Done > DXA_MAP_BLOCKSIZE ? DXA_MAP_BLOCKSIZE : Size - Done;
+
+			memcpy(Block, View + Done, (size_t)Bytes);
+
+			if (pCrypt && pCrypt->archiveCrypt)
+				pCrypt->DecryptArchiveData(Block, Bytes, Offset + Done);
+
+			if (Key != NULL)
+				KeyConv(Block, Bytes, Position + Done, Key);
+		}
+
+		return true;
+	}
+
+	// 読み込む
+	if (!Reader.Read(Data, Size, Offset)) return false;
+
+	if (pCrypt && pCrypt->archiveCrypt)
+		pCrypt->DecryptArchiveData(Data, Size, Offset);
+
+	if (Key != NULL)
+	{
+		// データを鍵文字列を使って Xor 演算
+		KeyConv(Data, Size, Position, Key);
+	}
+
+	return true;
+}
+
+// The data at Offset of a mapped archive if it is stored without any crypt, else NULL and it has to be read with KeyConvFileReadAt
+const void *DXArchive::KeyConvFileView(const DXArchiveReader &Reader, s64 Offset, s64 Size, unsigned char *Key)
+{
+	const DXArchiveCrypt *pCrypt = DXArchiveCryptScope::Current();
+
+	// KeyConv applies the crypt of newer archives even without a key
+	if (Key != NULL || (pCrypt && (pCrypt->newCrypt || pCrypt->chacha20 || pCrypt->archiveCrypt)))
+		return NULL;
+
+	return Reader.GetView(Offset, Size);
+}
+
 // 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
 int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, FILE *DestFp, void *TempBuffer, bool Press, bool MaxPress, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, DARC_ENCODEINFO *EncodeInfo)
 {
@@ -680,6 +916,7 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 	DARC_FILEHEAD File;
 	u8 lKey[DXA_KEY_BYTES];
 	size_t KeyStringBufferBytes;
+	std::string KeyDirString;
 
 	// ディレクトリの情報を得る
 	FindHandle = FindFirstFile(DirectoryName, &FindData);
@@ -747,6 +984,12 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 		return 0;
 	}
 
+	// The key strings of the files end with the names of this directory and its parents
+	if (NoKey == false)
+	{
+		CreateKeyDirectoryString(CharCodeFormat, DirectoryP, FileP, DirP, NameP, &KeyDirString);
+	}
+
 	// ファイル情報を出力する
 	{
 		int i;
@@ -800,7 +1043,7 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 				// ファイル個別の鍵を作成
 				if (NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString(CharCodeFormat, KeyString, KeyStringBytes, DirectoryP, &File, FileP, DirP, NameP, (BYTE *)KeyStringBuffer);
+					KeyStringBufferBytes = CreateKeyFileString(CharCodeFormat, KeyString, KeyStringBytes, KeyDirString, &File, NameP, (BYTE *)KeyStringBuffer);
 					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 				}
 
@@ -1071,320 +1314,341 @@ int DXArchive::DirectoryEncode(int CharCodeFormat, TCHAR *DirectoryName, u8 *Nam
 	return 0;
 }
 
-// 指定のディレクトリデータにあるファイルを展開する
-int DXArchive::DirectoryDecode(u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD *Head, DARC_DIRECTORY *Dir, FILE *ArcP, unsigned char *Key, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer)
+// 指定のディレクトリデータにあるファイルを展開リストに追加する
+void DXArchive::DirectoryDecode(DECODEINFO *Info, DARC_DIRECTORY *Dir, const TCHAR *OutputDir, std::vector<DECODEJOB> *Jobs)
 {
-	TCHAR DirPath[MAX_PATH];
-
-	// 現在のカレントディレクトリを保存
-	GetCurrentDirectory(MAX_PATH, DirPath);
+	std::wstring DirPath = OutputDir;
+	const DXArchiveCrypt *pCrypt = DXArchiveCryptScope::Current();
 
 	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
+	// Directories are created here, before any file is written, so the workers only ever write files
 	if (Dir->DirectoryAddress != 0xffffffffffffffff && Dir->ParentDirectoryAddress != 0xffffffffffffffff)
 	{
 		DARC_FILEHEAD *DirFile;
 
 		// DARC_FILEHEAD のアドレスを取得
-		DirFile = (DARC_FILEHEAD *)(FileP + Dir->DirectoryAddress);
+		DirFile = (DARC_FILEHEAD *)(Info->FileP + Dir->DirectoryAddress);
 
 		// ディレクトリの作成
-		TCHAR *pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		CreateDirectory(pName, NULL);
+		TCHAR *pName = GetOriginalFileName(Info->NameP + DirFile->NameAddress);
+		DirPath      = JoinOutputPath(OutputDir, pName);
+		Info->pSink->MakeDirectory(DirPath);
 		delete[] pName;
+	}
 
-		// そのディレクトリにカレントディレクトリを移す
-		pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		SetCurrentDirectory(pName);
-		delete[] pName;
+	// The key strings of the files end with the same directory names, the workers only look them up
+	if (Info->NoKey == false)
+	{
+		KeyDirectoryString(&Info->KeyDirectoryCache, (int)Info->Head->CharCodeFormat, Dir, Info->FileP, Info->DirP, Info->NameP);
 	}
 
-	// 展開処理開始
+	// 展開リストの作成開始
 	{
 		u32 i, FileHeadSize;
 		DARC_FILEHEAD *File;
-		size_t KeyStringBufferBytes;
-		unsigned char lKey[DXA_KEY_BYTES];
 
 		// 格納されているファイルの数だけ繰り返す
 		FileHeadSize = sizeof(DARC_FILEHEAD);
-		File         = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
+		File         = (DARC_FILEHEAD *)(Info->FileP + Dir->FileHeadAddress);
 		for (i = 0; i < Dir->FileHeadNum; i++, File = (DARC_FILEHEAD *)((u8 *)File + FileHeadSize))
 		{
 			// ディレクトリかどうかで処理を分岐
 			if (File->Attributes & FILE_ATTRIBUTE_DIRECTORY)
 			{
 				// ディレクトリの場合は再帰をかける
-				DirectoryDecode(NameP, DirP, FileP, Head, (DARC_DIRECTORY *)(DirP + File->DataAddress), ArcP, Key, KeyString, KeyStringBytes, NoKey, KeyStringBuffer);
+				DirectoryDecode(Info, (DARC_DIRECTORY *)(Info->DirP + File->DataAddress), DirPath.c_str(), Jobs);
 			}
 			else
 			{
-				FILE *DestP;
-				void *Buffer;
+				TCHAR *pName                = GetOriginalFileName(Info->NameP + File->NameAddress);
+				const std::wstring FilePath = JoinOutputPath(DirPath, pName);
 
-				// ファイルの場合は展開する
-
-				// バッファを確保する
-				Buffer = malloc(DXA_BUFFERSIZE);
-				if (Buffer == NULL) return -1;
-
-				// ファイルを開く
-				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-
-				DestP = _tfopen(pName, TEXT("wb"));
-				// ファイル個別の鍵を作成
-				if (NoKey == false)
+				// Entries the observer already has are left untouched
+				if (Info->pObserver == NULL || Info->pObserver->ShouldExtract(FilePath, File->DataSize, File->Time.LastWrite))
 				{
-					KeyStringBufferBytes = CreateKeyFileString((int)Head->CharCodeFormat, KeyString, KeyStringBytes, Dir, File, FileP, DirP, NameP, (BYTE *)KeyStringBuffer);
-					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
+					// v3.5 prepends a warning to some files which breaks the unpacked game, see FileDecode
+					const bool CheckProtection = (pCrypt && isV35(pCrypt->cryptVersion) && Info->pSink->RemoveUnpackProtection() && IsUnpackProtectionFile(pName));
+
+					Jobs->push_back({ Dir, File, FilePath, CheckProtection });
 				}
 
 				delete[] pName;
+			}
+		}
+	}
+}
 
-				// データがある場合のみ転送
-				if (File->DataSize != 0)
-				{
-					void *temp;
-
-					// 初期位置をセットする
-					if (_ftelli64(ArcP) != (s32)(Head->DataStartAddress + File->DataAddress))
-						_fseeki64(ArcP, Head->DataStartAddress + File->DataAddress, SEEK_SET);
-
-					// データが圧縮されているかどうかで処理を分岐
-					if (File->PressDataSize != 0xffffffffffffffff)
-					{
-						// 圧縮されている場合
-
-						// ハフマン圧縮もされているかどうかで処理を分岐
-						if (File->HuffPressDataSize != 0xffffffffffffffff)
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->PressDataSize + File->HuffPressDataSize + File->DataSize));
-
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->HuffPressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
-
-							// ハフマン圧縮を解凍
-							Huffman_Decode(temp, (u8 *)temp + File->HuffPressDataSize);
-
-							// ファイルの前後をハフマン圧縮している場合は処理を分岐
-							if (Head->HuffmanEncodeKB != 0xff && File->PressDataSize > Head->HuffmanEncodeKB * 1024 * 2)
-							{
-								// 解凍したデータの内、後ろ半分を移動する
-								memmove(
-									(u8 *)temp + File->HuffPressDataSize + File->PressDataSize - Head->HuffmanEncodeKB * 1024,
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									Head->HuffmanEncodeKB * 1024);
-
-								// 残りのLZ圧縮データを読み込む
-								KeyConvFileRead(
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									File->PressDataSize - Head->HuffmanEncodeKB * 1024 * 2,
-									ArcP, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize);
-							}
+// Extract a file of the list created by DirectoryDecode
+int DXArchive::FileDecode(DECODEINFO *Info, const DECODEJOB &Job, const DXArchiveReader &Reader, char *KeyStringBuffer, DXArchiveBufferPool *pPool)
+{
+	DARC_HEAD *Head     = Info->Head;
+	DARC_FILEHEAD *File = Job.File;
+	const s64 DataPos   = Head->DataStartAddress + File->DataAddress;
+	const bool NoKey    = Info->NoKey;
+	void *Buffer        = NULL;
+	size_t KeyStringBufferBytes;
+	unsigned char lKey[DXA_KEY_BYTES];
 
-							// 解凍
-							Decode((u8 *)temp + File->HuffPressDataSize, (u8 *)temp + File->HuffPressDataSize + File->PressDataSize);
+	// The file can not be decoded, the sink decides if the other files are still decoded
+	const auto Fail = [&](const char *Error, DXArchiveSink::FileHandle hFile = NULL) -> int {
+		return Info->pSink->FailFile(hFile, Job.FilePath, File->DataSize, Error) ? 0 : -1;
+	};
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->HuffPressDataSize + File->PressDataSize, File->DataSize, DestP);
+	// バッファを確保する
+	// The buffer of the pool is shared by all files of a worker, compressed files need it for the compressed and the decompressed data
+	if (File->DataSize != 0)
+	{
+		u64 BufferSize = File->DataSize > DXA_BUFFERSIZE ? DXA_BUFFERSIZE : File->DataSize;
 
-							// メモリの解放
-							free(temp);
-						}
-						else
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->PressDataSize + File->DataSize));
+		if (File->PressDataSize != 0xffffffffffffffff)
+		{
+			BufferSize = File->DataSize;
+			if (!AddSize(BufferSize, File->PressDataSize)) return Fail("invalid compressed size");
+			if (File->HuffPressDataSize != 0xffffffffffffffff && !AddSize(BufferSize, File->HuffPressDataSize)) return Fail("invalid compressed size");
+		}
+		else if (File->HuffPressDataSize != 0xffffffffffffffff)
+		{
+			BufferSize = File->DataSize;
+			if (!AddSize(BufferSize, File->HuffPressDataSize)) return Fail("invalid compressed size");
+		}
 
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->PressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
+		Buffer = pPool->Get(BufferSize);
+		if (Buffer == NULL) return Fail("out of memory");
+	}
 
-							// 解凍
-							Decode(temp, (u8 *)temp + File->PressDataSize);
+	// ファイル個別の鍵を作成
+	if (NoKey == false)
+	{
+		KeyStringBufferBytes = CreateKeyFileString((int)Head->CharCodeFormat, Info->KeyString, Info->KeyStringBytes, Info->KeyDirectoryCache.find(Job.Dir)->second, File, Info->NameP, (BYTE *)KeyStringBuffer);
+		KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
+	}
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->PressDataSize, File->DataSize, DestP);
+	//////////////////////////////
+	///// Remove Unpack Protection
+	// v3.5 prepends a warning to some files which breaks the unpacked game, it is dropped from the first written block
+	// instead of rewriting the file afterwards, the first block is at least DXA_BUFFERSIZE bytes or the whole file
+	bool CheckProtection = Job.CheckProtection;
 
-							// メモリの解放
-							free(temp);
-						}
-					}
-					else
-					{
-						// 圧縮されていない場合
+	const auto WriteData = [&](DXArchiveSink::FileHandle hFile, const void *Data, u64 Size) -> bool {
+		if (CheckProtection)
+		{
+			CheckProtection = false;
 
-						// ハフマン圧縮はされているかどうかで処理を分岐
-						if (File->HuffPressDataSize != 0xffffffffffffffff)
-						{
-							// 圧縮データが収まるメモリ領域の確保
-							temp = malloc((size_t)(File->HuffPressDataSize + File->DataSize));
+			if (Size >= sizeof(ANTI_UNPACK_DATA) && std::memcmp(Data, ANTI_UNPACK_DATA, sizeof(ANTI_UNPACK_DATA)) == 0)
+			{
+				Data = (const u8 *)Data + sizeof(ANTI_UNPACK_DATA);
+				Size -= sizeof(ANTI_UNPACK_DATA);
+			}
+		}
 
-							// 圧縮データの読み込み
-							KeyConvFileRead(temp, File->HuffPressDataSize, ArcP, NoKey ? NULL : lKey, File->DataSize);
+		return Info->pSink->WriteFile(hFile, Data, Size);
+	};
+	///// Remove Unpack Protection
+	//////////////////////////////
 
-							// ハフマン圧縮を解凍
-							Huffman_Decode(temp, (u8 *)temp + File->HuffPressDataSize);
+	// The observers are not thread safe, their calls are serialized
+	const auto NotifyExtracted = [&]() {
+		if (Info->pObserver == NULL) return;
 
-							// ファイルの前後のみハフマン圧縮している場合は処理を分岐
-							if (Head->HuffmanEncodeKB != 0xff && File->DataSize > Head->HuffmanEncodeKB * 1024 * 2)
-							{
-								// 解凍したデータの内、後ろ半分を移動する
-								memmove(
-									(u8 *)temp + File->HuffPressDataSize + File->DataSize - Head->HuffmanEncodeKB * 1024,
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									Head->HuffmanEncodeKB * 1024);
-
-								// 残りのデータを読み込む
-								KeyConvFileRead(
-									(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
-									File->DataSize - Head->HuffmanEncodeKB * 1024 * 2,
-									ArcP, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize);
-							}
+		std::lock_guard<std::mutex> Lock(Info->ObserverMutex);
+		Info->pObserver->OnExtracted(Job.FilePath, File->DataSize, File->Time.LastWrite);
+	};
 
-							// 書き出し
-							fwrite64((u8 *)temp + File->HuffPressDataSize, File->DataSize, DestP);
+	// Write a file which is completely in memory, a file the sink failed to write is not reported to the observer
+	const auto WriteCompleteFile = [&](void *Data, u64 Size) -> int {
+		DXArchiveSink::FileHandle hFile = Info->pSink->OpenFile(Job.FilePath, File->DataSize);
+		if (hFile == NULL) return -1;
 
-							// メモリの解放
-							free(temp);
-						}
-						else
-						{
-							u64 MoveSize, WriteSize;
+		const bool Written = (Size == 0 || WriteData(hFile, Data, Size));
 
-							// 転送処理開始
-							WriteSize = 0;
-							while (WriteSize < File->DataSize)
-							{
-								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE ? DXA_BUFFERSIZE : File->DataSize - WriteSize;
+		// ファイルを閉じる、タイムスタンプと属性を設定する
+		if (!Info->pSink->CloseFile(hFile, File->Time.Create, File->Time.LastAccess, File->Time.LastWrite, File->Attributes) || !Written) return -1;
 
-								// ファイルの反転読み込み
-								KeyConvFileRead(Buffer, MoveSize, ArcP, NoKey ? NULL : lKey, File->DataSize + WriteSize);
+		NotifyExtracted();
+		return 0;
+	};
 
-								// 書き出し
-								fwrite64(Buffer, MoveSize, DestP);
+	// データが無い場合は空のファイルを作成する
+	if (File->DataSize == 0)
+		return WriteCompleteFile(NULL, 0);
 
-								WriteSize += MoveSize;
-							}
-						}
-					}
-				}
+	void *temp = Buffer;
 
-				// ファイルを閉じる
-				fclose(DestP);
+	// データが圧縮されているかどうかで処理を分岐
+	if (File->PressDataSize != 0xffffffffffffffff)
+	{
+		// 圧縮されている場合
 
-				// バッファを開放する
-				free(Buffer);
+		// ハフマン圧縮もされているかどうかで処理を分岐
+		if (File->HuffPressDataSize != 0xffffffffffffffff)
+		{
+			// Only the head and the foot are Huffman coded for large files
+			const bool HuffPartial = Head->HuffmanEncodeKB != 0xff && File->PressDataSize > Head->HuffmanEncodeKB * 1024 * 2;
 
-				//////////////////////////////
-				///// Remove Unpack Protection
-				if (isV35(g_cryptVersion))
-				{
-					const std::vector<std::wstring> UNPACK_PROTECTION_FILES = { L"game.dat", L"cdatabase.dat", L"database.dat", L"commonevent.dat" };
-					const uint8_t ANTI_UNPACK_DATA[62]                      = { 0x45, 0x78, 0x74, 0x72, 0x61, 0x63, 0x74, 0x69, 0x6E, 0x67, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x72, 0x6F, 0x6D, 0x20, 0x65, 0x6E, 0x63, 0x72, 0x79, 0x70, 0x74, 0x65, 0x64, 0x20, 0x66, 0x69, 0x6C, 0x65, 0x73, 0x20, 0x76, 0x69, 0x6F, 0x6C, 0x61, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x75, 0x69, 0x64, 0x65, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x00 };
-					const uint32_t ANTI_UNPACK_DATA_SIZE                    = 62;
+			// 圧縮データの読み込み
+			if (!KeyConvFileReadAt(temp, File->HuffPressDataSize, Reader, DataPos, NoKey ? NULL : lKey, File->DataSize)) return Fail("data beyond the end of the archive");
 
-					pName = GetOriginalFileName(NameP + File->NameAddress);
+			// ハフマン圧縮を解凍
+			// The Huffman stream has to decode to exactly the size which was reserved for it
+			const u64 HuffSize = HuffPartial ? Head->HuffmanEncodeKB * 1024 * 2 : File->PressDataSize;
+			if (Huffman_Decode(temp, File->HuffPressDataSize, (u8 *)temp + File->HuffPressDataSize, HuffSize) != HuffSize) return Fail("corrupt Huffman data");
 
-					std::wstring fileName = std::wstring(pName);
-					std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
+			// ファイルの前後をハフマン圧縮している場合は処理を分岐
+			if (HuffPartial)
+			{
+				// 解凍したデータの内、後ろ半分を移動する
+				memmove(
+					(u8 *)temp + File->HuffPressDataSize + File->PressDataSize - Head->HuffmanEncodeKB * 1024,
+					(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
+					Head->HuffmanEncodeKB * 1024);
+
+				// 残りのLZ圧縮データを読み込む
+				if (!KeyConvFileReadAt(
+						(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
+						File->PressDataSize - Head->HuffmanEncodeKB * 1024 * 2,
+						Reader, DataPos + File->HuffPressDataSize, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize))
+					return Fail("data beyond the end of the archive");
+			}
 
-					// As I am not sure if the file name will contain only the actual file name or also a directory
-					// check if the file name ends with any of the unpack protection files
-					bool isUnpackProtectionFile = false;
+			// 解凍
+			if (DecodeChecked((u8 *)temp + File->HuffPressDataSize, File->PressDataSize, (u8 *)temp + File->HuffPressDataSize + File->PressDataSize, File->DataSize) < 0)
+				return Fail("corrupt LZ data");
 
-					for (const std::wstring &unpackProtectionFile : UNPACK_PROTECTION_FILES)
-					{
-						if (fileName.ends_with(unpackProtectionFile))
-						{
-							isUnpackProtectionFile = true;
-							break;
-						}
-					}
+			// 書き出し
+			if (WriteCompleteFile((u8 *)temp + File->HuffPressDataSize + File->PressDataSize, File->DataSize) < 0) return -1;
+		}
+		else
+		{
+			// Data without crypt is decompressed directly from the mapped archive
+			void *Src = (void *)KeyConvFileView(Reader, DataPos, File->PressDataSize, NoKey ? NULL : lKey);
 
-					if (isUnpackProtectionFile)
-					{
-						DestP = _tfopen(pName, TEXT("rb"));
+			// 圧縮データの読み込み
+			if (Src == NULL)
+			{
+				if (!KeyConvFileReadAt(temp, File->PressDataSize, Reader, DataPos, NoKey ? NULL : lKey, File->DataSize)) return Fail("data beyond the end of the archive");
+				Src = temp;
+			}
 
-						// Get the file size
-						_fseeki64(DestP, 0, SEEK_END);
-						int64_t fileSize = _ftelli64(DestP);
+			// 解凍
+			if (DecodeChecked(Src, File->PressDataSize, (u8 *)temp + File->PressDataSize, File->DataSize) < 0)
+				return Fail("corrupt LZ data");
 
-						if (fileSize >= ANTI_UNPACK_DATA_SIZE)
-						{
-							// Check if the file begins with the anti-unpack data
-							_fseeki64(DestP, 0, SEEK_SET);
+			// 書き出し
+			if (WriteCompleteFile((u8 *)temp + File->PressDataSize, File->DataSize) < 0) return -1;
+		}
+	}
+	else
+	{
+		// 圧縮されていない場合
 
-							void *pFileBeginning = malloc(ANTI_UNPACK_DATA_SIZE);
-							fread64(pFileBeginning, ANTI_UNPACK_DATA_SIZE, DestP);
+		// ハフマン圧縮はされているかどうかで処理を分岐
+		if (File->HuffPressDataSize != 0xffffffffffffffff)
+		{
+			// Only the head and the foot are Huffman coded for large files
+			const bool HuffPartial = Head->HuffmanEncodeKB != 0xff && File->DataSize > Head->HuffmanEncodeKB * 1024 * 2;
 
-							if (pFileBeginning && std::memcmp(pFileBeginning, ANTI_UNPACK_DATA, ANTI_UNPACK_DATA_SIZE) == 0)
-							{
-								fileSize -= ANTI_UNPACK_DATA_SIZE;
+			// 圧縮データの読み込み
+			if (!KeyConvFileReadAt(temp, File->HuffPressDataSize, Reader, DataPos, NoKey ? NULL : lKey, File->DataSize)) return Fail("data beyond the end of the archive");
 
-								// Remove the first 62 bytes from the file
-								_fseeki64(DestP, ANTI_UNPACK_DATA_SIZE, SEEK_SET);
+			// ハフマン圧縮を解凍
+			// The Huffman stream has to decode to exactly the size which was reserved for it
+			const u64 HuffSize = HuffPartial ? Head->HuffmanEncodeKB * 1024 * 2 : File->DataSize;
+			if (Huffman_Decode(temp, File->HuffPressDataSize, (u8 *)temp + File->HuffPressDataSize, HuffSize) != HuffSize) return Fail("corrupt Huffman data");
 
-								std::vector<uint8_t> buffer(fileSize);
-								fread64(buffer.data(), fileSize, DestP);
-								fclose(DestP);
+			// ファイルの前後のみハフマン圧縮している場合は処理を分岐
+			if (HuffPartial)
+			{
+				// 解凍したデータの内、後ろ半分を移動する
+				memmove(
+					(u8 *)temp + File->HuffPressDataSize + File->DataSize - Head->HuffmanEncodeKB * 1024,
+					(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
+					Head->HuffmanEncodeKB * 1024);
+
+				// 残りのデータを読み込む
+				if (!KeyConvFileReadAt(
+						(u8 *)temp + File->HuffPressDataSize + Head->HuffmanEncodeKB * 1024,
+						File->DataSize - Head->HuffmanEncodeKB * 1024 * 2,
+						Reader, DataPos + File->HuffPressDataSize, NoKey ? NULL : lKey, File->DataSize + File->HuffPressDataSize))
+					return Fail("data beyond the end of the archive");
+			}
 
-								DestP = _tfopen(pName, TEXT("wb"));
+			// 書き出し
+			if (WriteCompleteFile((u8 *)temp + File->HuffPressDataSize, File->DataSize) < 0) return -1;
+		}
+		else
+		{
+			u64 MoveSize, WriteSize;
 
-								fwrite64(buffer.data(), fileSize, DestP);
-							}
+			// Data without crypt is written directly from the mapped archive
+			const u8 *View = (const u8 *)KeyConvFileView(Reader, DataPos, File->DataSize, NoKey ? NULL : lKey);
 
-							free(pFileBeginning);
-						}
+			// Uncompressed files are streamed through the buffer of the worker, other workers write their files at the same time
+			DXArchiveSink::FileHandle hFile = Info->pSink->OpenFile(Job.FilePath, File->DataSize);
+			if (hFile == NULL) return -1;
 
-						fclose(DestP);
-					}
+			// 転送処理開始
+			WriteSize = 0;
+			while (WriteSize < File->DataSize)
+			{
+				MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE ? DXA_BUFFERSIZE : File->DataSize - WriteSize;
 
-					delete[] pName;
-				}
+				const u8 *Data = View != NULL ? View + WriteSize : (const u8 *)Buffer;
 
-				///// Remove Unpack Protection
-				//////////////////////////////
+				// ファイルの反転読み込み
+				if (View == NULL && !KeyConvFileReadAt(Buffer, MoveSize, Reader, DataPos + WriteSize, NoKey ? NULL : lKey, File->DataSize + WriteSize))
+					return Fail("data beyond the end of the archive", hFile);
 
-				// ファイルのタイムスタンプを設定する
+				// 書き出し
+				if (!WriteData(hFile, Data, MoveSize))
 				{
-					HANDLE HFile;
-					FILETIME CreateTime, LastAccessTime, LastWriteTime;
-					TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-					HFile        = CreateFile(pName,
-											  GENERIC_WRITE, 0, NULL,
-											  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-					delete[] pName;
-
-					if (HFile == INVALID_HANDLE_VALUE)
-					{
-						HFile = HFile;
-					}
-
-					CreateTime.dwHighDateTime     = (u32)(File->Time.Create >> 32);
-					CreateTime.dwLowDateTime      = (u32)(File->Time.Create & 0xffffffffffffffff);
-					LastAccessTime.dwHighDateTime = (u32)(File->Time.LastAccess >> 32);
-					LastAccessTime.dwLowDateTime  = (u32)(File->Time.LastAccess & 0xffffffffffffffff);
-					LastWriteTime.dwHighDateTime  = (u32)(File->Time.LastWrite >> 32);
-					LastWriteTime.dwLowDateTime   = (u32)(File->Time.LastWrite & 0xffffffffffffffff);
-					SetFileTime(HFile, &CreateTime, &LastAccessTime, &LastWriteTime);
-					CloseHandle(HFile);
+					Info->pSink->CloseFile(hFile, File->Time.Create, File->Time.LastAccess, File->Time.LastWrite, File->Attributes);
+					return -1;
 				}
 
-				// ファイル属性を付ける
-				pName = GetOriginalFileName(NameP + File->NameAddress);
-				SetFileAttributes(pName, (u32)File->Attributes & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
-				delete[] pName;
+				WriteSize += MoveSize;
 			}
+
+			// ファイルを閉じる、タイムスタンプと属性を設定する
+			if (!Info->pSink->CloseFile(hFile, File->Time.Create, File->Time.LastAccess, File->Time.LastWrite, File->Attributes)) return -1;
+
+			NotifyExtracted();
 		}
 	}
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(DirPath);
-
 	// 終了
 	return 0;
 }
 
+// 指定のディレクトリデータにあるファイルを一覧に追加する
+void DXArchive::DirectoryList(u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *Dir, const std::wstring &DirPath, DXArchiveListing *Listing)
+{
+	DARC_FILEHEAD *File = (DARC_FILEHEAD *)(FileP + Dir->FileHeadAddress);
+
+	for (u64 i = 0; i < Dir->FileHeadNum; i++, File++)
+	{
+		TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
+
+		DXArchiveEntry Entry;
+		Entry.path              = DirPath.empty() ? std::wstring(pName) : DirPath + L"/" + pName;
+		Entry.directory         = (File->Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		Entry.attributes        = File->Attributes;
+		Entry.create            = File->Time.Create;
+		Entry.lastAccess        = File->Time.LastAccess;
+		Entry.lastWrite         = File->Time.LastWrite;
+		Entry.dataSize          = File->DataSize;
+		Entry.pressDataSize     = File->PressDataSize;
+		Entry.huffPressDataSize = File->HuffPressDataSize;
+
+		delete[] pName;
+
+		Listing->entries.push_back(Entry);
+
+		// ディレクトリの場合は再帰をかける
+		if (Entry.directory)
+			DirectoryList(NameP, DirP, FileP, (DARC_DIRECTORY *)(DirP + File->DataAddress), Entry.path, Listing);
+	}
+}
+
 // ディレクトリ内のファイルパスを取得する
 int DXArchive::GetDirectoryFilePath(const TCHAR *DirectoryPath, std::vector<std::wstring> *FileNameBuffer)
 {
@@ -1884,166 +2148,24 @@ int DXArchive::Encode(void *Src, u32 SrcSize, void *Dest, bool OutStatus, bool M
 // デコード( 戻り値:解凍後のサイズ  -1 はエラー  Dest に NULL を入れることも可能 )
 int DXArchive::Decode(void *Src, void *Dest)
 {
-	u32 srcsize, destsize, code, indexsize, keycode, conbo, index = 0;
-	u8 *srcp, *destp, *dp, *sp;
-
-	destp = (u8 *)Dest;
-	srcp  = (u8 *)Src;
-
-	// 解凍後のデータサイズを得る
-	destsize = *((u32 *)&srcp[0]);
-
-	// 圧縮データのサイズを得る
-	srcsize = *((u32 *)&srcp[4]) - 9;
-
-	// キーコード
-	keycode = srcp[8];
-
 	// 出力先がない場合はサイズだけ返す
 	if (Dest == NULL)
-		return destsize;
-
-	// 展開開始
-	sp = srcp + 9;
-	dp = destp;
-	while (srcsize)
-	{
-		// キーコードか同かで処理を分岐
-		if (sp[0] != keycode)
-		{
-			// 非圧縮コードの場合はそのまま出力
-			*dp = *sp;
-			dp++;
-			sp++;
-			srcsize--;
-			continue;
-		}
-
-		// キーコードが連続していた場合はキーコード自体を出力
-		if (sp[1] == keycode)
-		{
-			*dp = (u8)keycode;
-			dp++;
-			sp += 2;
-			srcsize -= 2;
-
-			continue;
-		}
-
-		// 第一バイトを得る
-		code = sp[1];
-
-		// もしキーコードよりも大きな値だった場合はキーコード
-		// とのバッティング防止の為に＋１しているので－１する
-		if (code > keycode) code--;
-
-		sp += 2;
-		srcsize -= 2;
-
-		// 連続長を取得する
-		conbo = code >> 3;
-		if (code & (0x1 << 2))
-		{
-			conbo |= *sp << 5;
-			sp++;
-			srcsize--;
-		}
-		conbo += MIN_COMPRESS; // 保存時に減算した最小圧縮バイト数を足す
+		return (int)*((u32 *)Src);
 
-		// 参照相対アドレスを取得する
-		indexsize = code & 0x3;
-		switch (indexsize)
-		{
-			case 0:
-				index = *sp;
-				sp++;
-				srcsize--;
-				break;
-
-			case 1:
-				index = *((u16 *)sp);
-				sp += 2;
-				srcsize -= 2;
-				break;
-
-			case 2:
-				index = *((u16 *)sp) | (sp[2] << 16);
-				sp += 3;
-				srcsize -= 3;
-				break;
-		}
-		index++; // 保存時に－１しているので＋１する
-
-		// 展開
-		if (index < conbo)
-		{
-			u32 num;
-
-			num = index;
-			while (conbo > num)
-			{
-				memcpy(dp, dp - num, num);
-				dp += num;
-				conbo -= num;
-				num += num;
-			}
-			if (conbo != 0)
-			{
-				memcpy(dp, dp - num, conbo);
-				dp += conbo;
-			}
-		}
-		else
-		{
-			memcpy(dp, dp - index, conbo);
-			dp += conbo;
-		}
-	}
+	return lzDecode::Decode<false>(Src, 0, Dest, 0, MIN_COMPRESS);
+}
 
-	// 解凍後のサイズを返す
-	return (int)destsize;
+// 入出力のサイズを検証しながらデコード( 戻り値:解凍後のサイズ  -1 はエラー )
+// Streams decrypted with a wrong key are rejected instead of writing outside of Dest
+int DXArchive::DecodeChecked(void *Src, u64 SrcSize, void *Dest, u64 DestSize)
+{
+	return lzDecode::Decode<true>(Src, SrcSize, Dest, DestSize, MIN_COMPRESS);
 }
 
 // バイナリデータを元に CRC32 のハッシュ値を計算する
 u32 DXArchive::HashCRC32(const void *SrcData, size_t SrcDataSize)
 {
-	static DWORD CRC32Table[256];
-	static int CRC32TableInit = 0;
-	DWORD CRC                 = 0xffffffff;
-	BYTE *SrcByte             = (BYTE *)SrcData;
-	DWORD i;
-
-	// テーブルが初期化されていなかったら初期化する
-	if (CRC32TableInit == 0)
-	{
-		DWORD Magic = 0xedb88320; // 0x4c11db7 をビットレベルで順番を逆にしたものが 0xedb88320
-		DWORD j;
-
-		for (i = 0; i < 256; i++)
-		{
-			DWORD Data = i;
-			for (j = 0; j < 8; j++)
-			{
-				int b = (Data & 1);
-				Data >>= 1;
-				if (b != 0)
-				{
-					Data ^= Magic;
-				}
-			}
-			CRC32Table[i] = Data;
-		}
-
-		// テーブルを初期化したフラグを立てる
-		CRC32TableInit = 1;
-	}
-
-	for (i = 0; i < SrcDataSize; i++)
-	{
-		CRC = CRC32Table[(BYTE)(CRC ^ SrcByte[i])] ^ (CRC >> 8);
-	}
-
-	return CRC ^ 0xffffffff;
+	return crc32::hash(SrcData, SrcDataSize);
 }
 
 int DXArchive::EncodeArchiveOneDirectoryWolf(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press, const char *KeyString_, uint16_t cryptVersion)
@@ -2101,6 +2223,8 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 	size_t KeyStringBytes;
 	char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
 	DARC_ENCODEINFO EncodeInfo;
+	DXArchiveCrypt Crypt;
+	DXArchiveCryptScope CryptScope(&Crypt);
 
 	// 状況出力を行う場合はファイルの総数を数える
 	EncodeInfo.CompFileNum  = 0;
@@ -2163,34 +2287,19 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 	// 出力ファイルを開く
 	DestFp = _tfopen(OutputFileName, TEXT("wb+"));
 
-	g_cryptVersion = cryptVersion;
-	g_newCrypt     = (cryptVersion >= 331 && cryptVersion < 1000 || cryptVersion >= 1010);
-	g_chacha20     = cryptVersion == 0x64 || cryptVersion == 0xC8;
-
-	if (cryptVersion == 0xC8)
-	{
-		std::array<uint8_t, 4> data;
-		std::array<uint8_t, 64> key;
-
-		std::memcpy(data.data(), (uint8_t *)KeyString_ + KeyStringBytes + 1, 4);
-		chacha20_keySetup(data, key);
-
-		std::memcpy(g_cc20Key, key.data(), 32);
-		std::memcpy(g_cc20Nonce, key.data() + 34, 12);
-	}
+	Crypt.Setup(cryptVersion, KeyString_, KeyStringBytes);
 
 	uint8_t *pK2 = nullptr;
 
-	if (g_newCrypt)
+	if (Crypt.newCrypt)
 	{
 		memset(&Head, 0, sizeof(Head));
 
-		memset(g_specialKey, 0, 768);
-
 		if (cryptVersion >= 1010)
 			pK2 = (uint8_t *)KeyString_ + KeyStringBytes + 1;
 
-		initWolfCrypt(cryptVersion, Head.Reserve, g_specialKey, pK2);
+		initWolfCrypt(cryptVersion, Head.Reserve, Crypt.specialKey, pK2);
+		Crypt.specialStream.Init(Crypt.specialKey, isV35(cryptVersion));
 	}
 
 	// アーカイブのヘッダを出力する
@@ -2641,59 +2750,41 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 		fwrite64(&Head, sizeof(DARC_HEAD), DestFp);
 	}
 
-	if (g_newCrypt)
+	// The archive crypt of v3.x only XORs keystreams onto the data, applying the crypt the decoder removes encrypts the archive.
+	// The archive is encrypted in place block by block, only the AES keystreams of the data start and the tables are kept in memory
+	if (Crypt.newCrypt)
 	{
-		uint8_t roundKey[AES_ROUND_KEY_SIZE] = { 0 };
-
-		const uint8_t *pPwd = Head.Reserve;
-
-		fseek(DestFp, 0, SEEK_END);
-		int32_t size = ftell(DestFp);
-		fseek(DestFp, 0, SEEK_SET);
-
-		uint8_t *pFileData = new uint8_t[size]();
-
-		size_t ret = fread(pFileData, 1, size, DestFp);
+		_fseeki64(DestFp, 0, SEEK_END);
+		const s64 ArchiveSize = _ftelli64(DestFp);
 
-		initAES128(roundKey, pPwd, pK2, cryptVersion);
-
-		if ((size - 64) < 0x400)
-			return 0;
-
-		uint32_t bodySize = 0x400;
-
-		if (isV35(cryptVersion))
+		if ((ArchiveSize - 64) >= 0x400)
 		{
-			uint32_t seed = 0;
-
-			if (cryptVersion >= 1020)
-				seed = pK2[0] * pK2[1] + pPwd[2] * pPwd[4] + pPwd[11];
-			else
-				seed = pPwd[2] * pPwd[4] + pPwd[12]; // xorShift32 seed
-
-			if (!seed) seed = 1;
-			xorshift32(seed);
+			DXArchiveCrypt ArchiveCrypt;
+			DARC_HEAD CryptHead = Head;
 
-			if (size >= static_cast<int32_t>(xorshift32() % 500 + 800))
-				xorshift32();
+			// SetupArchive decrypts the addresses of the header it is given, so it gets the encrypted header which is written
+			cryptAddresses((uint8_t *)&CryptHead, CryptHead.Reserve, cryptVersion);
+			DARC_HEAD OutHead = CryptHead;
 
-			bodySize = size - 64; // 64 is the header size -- maybe replace with a constant
+			ArchiveCrypt.Setup(cryptVersion, KeyString_, KeyStringBytes);
+			ArchiveCrypt.SetupArchive(CryptHead, ArchiveSize, KeyString_, KeyStringBytes);
 
-			if (bodySize >= (xorshift32() % 500 + 800))
-				bodySize = (xorshift32() % 500) + 800;
-		}
-
-		aesCtrXCrypt(pFileData + 64, roundKey, bodySize);
-		aesCtrXCrypt(pFileData + Head.FileNameTableStartAddress, roundKey, size - static_cast<int32_t>(Head.FileNameTableStartAddress));
+			for (s64 Pos = sizeof(DARC_HEAD); Pos < ArchiveSize; Pos += DXA_BUFFERSIZE)
+			{
+				const s64 Bytes = ArchiveSize - Pos > DXA_BUFFERSIZE ? DXA_BUFFERSIZE : ArchiveSize - Pos;
 
-		initWolfCrypt(cryptVersion, pPwd, g_specialKey, nullptr, pFileData, 64, size - 64, true, KeyString_);
+				_fseeki64(DestFp, Pos, SEEK_SET);
+				fread64(TempBuffer, Bytes, DestFp);
 
-		cryptAddresses(pFileData, pPwd, cryptVersion);
+				ArchiveCrypt.DecryptArchiveData(TempBuffer, Bytes, Pos);
 
-		fseek(DestFp, 0, SEEK_SET);
-		fwrite64(pFileData, size, DestFp);
+				_fseeki64(DestFp, Pos, SEEK_SET);
+				fwrite64(TempBuffer, Bytes, DestFp);
+			}
 
-		delete[] pFileData;
+			_fseeki64(DestFp, 0, SEEK_SET);
+			fwrite64(&OutHead, sizeof(DARC_HEAD), DestFp);
+		}
 	}
 
 	// 書き出したファイルを閉じる
@@ -2713,20 +2804,23 @@ int DXArchive::EncodeArchive(const TCHAR *OutputFileName, const std::vector<std:
 }
 
 // アーカイブファイルを展開する
-int DXArchive::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_)
+int DXArchive::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_, DXArchiveObserver *pObserver, DXArchiveSink *pSink, u32 ThreadNum)
 {
 	u8 *HeadBuffer = NULL;
 	DARC_HEAD Head;
 	u8 *FileP, *NameP, *DirP;
 	FILE *ArcP = NULL;
-	TCHAR OldDir[MAX_PATH];
-	u8 Key[DXA_KEY_BYTES];
 	char KeyString[DXA_KEY_STRING_LENGTH + 1];
 	size_t KeyStringBytes;
-	char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
 	bool NoKey;
+	DXArchiveCrypt Crypt;
+	DXArchiveCryptScope CryptScope(&Crypt);
+	const std::wstring OutDir = OutputPath != NULL ? OutputPath : TEXT("");
+	DXArchiveDiskSink DiskSink;
 
-	// 鍵文字列の保存と鍵の作成
+	if (pSink == NULL) pSink = &DiskSink;
+
+	// 鍵文字列の保存
 	{
 		// 指定が無い場合はデフォルトの鍵文字列を使用する
 		if (KeyString_ == NULL)
@@ -2741,217 +2835,280 @@ int DXArchive::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const
 		}
 		memcpy(KeyString, KeyString_, KeyStringBytes);
 		KeyString[KeyStringBytes] = '\0';
-
-		// 鍵の作成
-		KeyCreate(KeyString, KeyStringBytes, Key);
 	}
 
 	// アーカイブファイルを開く
 	ArcP = _tfopen(ArchiveName, TEXT("rb"));
 	if (ArcP == NULL) return -1;
 
-	// 出力先のディレクトリにカレントディレクトリを変更する
-	GetCurrentDirectory(MAX_PATH, OldDir);
-	SetCurrentDirectory(OutputPath);
-
 	// ヘッダを解析する
+	if (ReadHeadTable(ArcP, KeyString_, &Head, &Crypt, &HeadBuffer) < 0) goto ERR;
+
+	// Archives of the new crypt without any data have no tables
+	if (HeadBuffer == NULL)
 	{
-		s64 FileSize;
+		fclose(ArcP);
+		return 0;
+	}
 
-		// ヘッダの読み込み
-		fread64(&Head, sizeof(DARC_HEAD), ArcP);
+	// 鍵処理が行われていないかを取得する
+	NoKey = (Head.Flags & DXA_FLAG_NO_KEY) != 0;
 
-		// ＩＤの検査
-		if (Head.Head != DXA_HEAD)
-		{
-			goto ERR;
-		}
+	// 各アドレスをセットする
+	NameP = HeadBuffer;
+	FileP = NameP + Head.FileTableStartAddress;
+	DirP  = NameP + Head.DirectoryTableStartAddress;
 
-		// バージョン検査
-		if (Head.Version > DXA_VER || Head.Version < DXA_VER_MIN) goto ERR;
+	// アーカイブの展開を開始する
+	{
+		DECODEINFO Info;
+		std::vector<DECODEJOB> Jobs;
+		std::atomic<size_t> NextJob = 0;
+		std::atomic<bool> Failed    = false;
+		std::exception_ptr Error    = nullptr;
+		std::mutex ErrorMutex;
+		std::vector<std::thread> Workers;
+
+		Info.NameP          = NameP;
+		Info.DirP           = DirP;
+		Info.FileP          = FileP;
+		Info.Head           = &Head;
+		Info.KeyString      = KeyString;
+		Info.KeyStringBytes = KeyStringBytes;
+		Info.NoKey          = NoKey;
+		Info.pObserver      = pObserver;
+		Info.pSink          = pSink;
+
+		// The directory tree is walked on this thread, this creates all directories before any file is written
+		DirectoryDecode(&Info, (DARC_DIRECTORY *)DirP, OutDir.c_str(), &Jobs);
+
+		if (ThreadNum > Jobs.size()) ThreadNum = (u32)Jobs.size();
+
+		// Start with the largest files so a large file at the end of the list does not leave the other workers idle
+		if (ThreadNum > 1)
+			std::stable_sort(Jobs.begin(), Jobs.end(), [](const DECODEJOB &a, const DECODEJOB &b) { return a.File->DataSize > b.File->DataSize; });
+
+		// Every worker has its own reader, buffer and key string, the crypt is bound per thread
+		const auto Worker = [&]() {
+			DXArchiveCryptScope WorkerCryptScope(&Crypt);
+			DXArchiveReader Reader;
+			DXArchiveBufferPool Pool;
+			char KeyStringBuffer[DXA_KEY_STRING_MAXLENGTH];
+
+			try
+			{
+				if (!Reader.Open(ArchiveName))
+				{
+					Failed = true;
+					return;
+				}
+
+				for (size_t i = NextJob++; i < Jobs.size() && !Failed; i = NextJob++)
+				{
+					if (FileDecode(&Info, Jobs[i], Reader, KeyStringBuffer, &Pool) < 0)
+						Failed = true;
+				}
+			}
+			catch (...)
+			{
+				// Rethrown by the calling thread after all workers finished
+				std::lock_guard<std::mutex> Lock(ErrorMutex);
+				if (!Error) Error = std::current_exception();
+				Failed = true;
+			}
+		};
+
+		for (u32 i = 1; i < ThreadNum; i++)
+			Workers.emplace_back(Worker);
+
+		Worker();
 
-		const uint16_t cryptVersion = Head.Flags >> 16;
+		for (std::thread &Thread : Workers)
+			Thread.join();
 
-		g_cryptVersion = cryptVersion;
-		g_newCrypt     = (cryptVersion >= 331 && cryptVersion < 1000 || cryptVersion >= 1010);
-		g_chacha20     = cryptVersion == 0x64 || cryptVersion == 0xC8;
+		if (Error)
+		{
+			free(HeadBuffer);
+			fclose(ArcP);
+			std::rethrow_exception(Error);
+		}
 
-		if (cryptVersion == 0xC8)
-		{
-			std::array<uint8_t, 4> data;
-			std::array<uint8_t, 64> key;
+		if (Failed) goto ERR;
+	}
 
-			std::memcpy(data.data(), (uint8_t *)KeyString_ + KeyStringBytes + 1, 4);
-			chacha20_keySetup(data, key);
+	// ファイルを閉じる
+	fclose(ArcP);
 
-			std::memcpy(g_cc20Key, key.data(), 32);
-			std::memcpy(g_cc20Nonce, key.data() + 34, 12);
-		}
+	// ヘッダを読み込んでいたメモリを解放する
+	free(HeadBuffer);
 
-		if (g_newCrypt)
-		{
-			const uint8_t *pPwd = Head.Reserve;
+	// 終了
+	return 0;
 
-			memset(g_specialKey, 0, 768);
-			cryptAddresses((uint8_t *)&Head, pPwd, cryptVersion);
+ERR:
+	if (HeadBuffer != NULL) free(HeadBuffer);
+	if (ArcP != NULL) fclose(ArcP);
 
-			fseek(ArcP, 0, SEEK_END);
-			int32_t size = ftell(ArcP);
-			fseek(ArcP, 0, SEEK_SET);
+	// 終了
+	return -1;
+}
 
-			uint8_t *pFileData = new uint8_t[size]();
+// Decrypt only the header tables with the given key and check their structure, nothing is extracted
+int DXArchive::ProbeArchive(const TCHAR *ArchiveName, const char *KeyString_)
+{
+	u8 *HeadBuffer = NULL;
+	DARC_HEAD Head;
+	FILE *ArcP = NULL;
+	int Result;
+	DXArchiveCrypt Crypt;
+	DXArchiveCryptScope CryptScope(&Crypt);
 
-			size_t ret = fread(pFileData, 1, size, ArcP);
+	ArcP = _tfopen(ArchiveName, TEXT("rb"));
+	if (ArcP == NULL) return -1;
 
-			// Replace the beginning of the file data with the decrypted header
-			std::memcpy(pFileData, &Head, sizeof(DARC_HEAD));
+	Result = ReadHeadTable(ArcP, KeyString_, &Head, &Crypt, &HeadBuffer);
 
-			uint8_t roundKey[AES_ROUND_KEY_SIZE] = { 0 };
-			initWolfCrypt(cryptVersion, pPwd, g_specialKey, nullptr, pFileData, 64, size - 64, true, KeyString_);
+	if (HeadBuffer != NULL) free(HeadBuffer);
+	fclose(ArcP);
 
-			uint8_t *pK2 = nullptr;
+	return Result;
+}
 
-			if (cryptVersion >= 1010)
-				pK2 = (uint8_t *)KeyString_ + KeyStringBytes + 1;
+// List the contents of the archive, only the header and the tables are read
+int DXArchive::ListArchive(const TCHAR *ArchiveName, DXArchiveListing *Listing, const char *KeyString_)
+{
+	u8 *HeadBuffer = NULL;
+	DARC_HEAD Head;
+	FILE *ArcP = NULL;
+	int Result;
+	DXArchiveCrypt Crypt;
+	DXArchiveCryptScope CryptScope(&Crypt);
 
-			initAES128(roundKey, pPwd, pK2, cryptVersion);
+	ArcP = _tfopen(ArchiveName, TEXT("rb"));
+	if (ArcP == NULL) return -1;
 
-			if ((size - 64) < 0x400)
-				return 0;
+	Result = ReadHeadTable(ArcP, KeyString_, &Head, &Crypt, &HeadBuffer);
 
-			uint32_t bodySize = 0x400;
+	if (Result == 0)
+	{
+		Listing->version      = Head.Version;
+		Listing->cryptVersion = Head.Flags >> 16;
+		Listing->entries.clear();
 
-			if (isV35(cryptVersion))
-			{
-				uint32_t seed = 0;
+		if (HeadBuffer != NULL)
+			DirectoryList(HeadBuffer, HeadBuffer + Head.DirectoryTableStartAddress, HeadBuffer + Head.FileTableStartAddress, (DARC_DIRECTORY *)(HeadBuffer + Head.DirectoryTableStartAddress), L"", Listing);
+	}
 
-				if (cryptVersion >= 1020)
-					seed = pK2[0] * pK2[1] + pPwd[2] * pPwd[4] + pPwd[11];
-				else
-					seed = pPwd[2] * pPwd[4] + pPwd[12]; // xorShift32 seed
+	if (HeadBuffer != NULL) free(HeadBuffer);
+	fclose(ArcP);
 
-				if (!seed) seed = 1;
-				xorshift32(seed);
+	return Result;
+}
 
-				if (size >= static_cast<int32_t>(xorshift32() % 500 + 800))
-					xorshift32();
+// ヘッダテーブルを読み込み、暗号化を解除して構造を検査する
+int DXArchive::ReadHeadTable(FILE *ArcP, const char *KeyString_, DARC_HEAD *Head, DXArchiveCrypt *Crypt, u8 **HeadBufferP)
+{
+	u8 *HeadBuffer     = NULL;
+	u8 *HuffHeadBuffer = NULL;
+	u8 *LzHeadBuffer   = NULL;
+	u8 Key[DXA_KEY_BYTES];
+	char KeyString[DXA_KEY_STRING_LENGTH + 1];
+	size_t KeyStringBytes;
+	bool NoKey;
+	s64 FileSize;
+	int Result = -1;
 
-				bodySize = size - 64; // 64 is the header size -- maybe replace with a constant
+	*HeadBufferP = NULL;
 
-				if (bodySize >= (xorshift32() % 500 + 800))
-					bodySize = (xorshift32() % 500) + 800;
-			}
+	if (KeyString_ == NULL)
+		KeyString_ = DefaultKeyString;
 
-			aesCtrXCrypt(pFileData + 64, roundKey, bodySize); // For v3.31 this has to be 0x400
-			aesCtrXCrypt(pFileData + Head.FileNameTableStartAddress, roundKey, size - static_cast<int32_t>(Head.FileNameTableStartAddress));
+	KeyStringBytes = CL_strlen(CHARCODEFORMAT_ASCII, KeyString_);
+	if (KeyStringBytes > DXA_KEY_STRING_LENGTH)
+		KeyStringBytes = DXA_KEY_STRING_LENGTH;
 
-			// Write to file
-			FILE *fp = fopen("decrypt_temp", "wb");
-			fwrite(pFileData, size, 1, fp);
-			fclose(fp);
+	memcpy(KeyString, KeyString_, KeyStringBytes);
+	KeyString[KeyStringBytes] = '\0';
 
-			delete[] pFileData;
+	KeyCreate(KeyString, KeyStringBytes, Key);
 
-			// Close the current arc file and open the decrypted one
-			fclose(ArcP);
+	_fseeki64(ArcP, 0, SEEK_END);
+	FileSize = _ftelli64(ArcP);
+	_fseeki64(ArcP, 0, SEEK_SET);
 
-			ArcP = fopen("decrypt_temp", "rb");
-			fseek(ArcP, sizeof(DARC_HEAD), SEEK_SET);
+	if (FileSize < static_cast<s64>(sizeof(DARC_HEAD))) goto END;
 
-			initWolfCrypt(cryptVersion, pPwd, g_specialKey, pK2);
-		}
+	fread64(Head, sizeof(DARC_HEAD), ArcP);
 
-		// 鍵処理が行われていないかを取得する
-		NoKey = (Head.Flags & DXA_FLAG_NO_KEY) != 0;
+	if (Head->Head != DXA_HEAD || Head->Version > DXA_VER || Head->Version < DXA_VER_MIN) goto END;
 
-		// ヘッダのサイズ分のメモリを確保する
-		HeadBuffer = (u8 *)malloc((size_t)Head.HeadSize);
-		if (HeadBuffer == NULL) goto ERR;
+	Crypt->Setup(Head->Flags >> 16, KeyString_, KeyStringBytes);
 
-		// ヘッダが圧縮されている場合は解凍する
-		if ((Head.Flags & DXA_FLAG_NO_HEAD_PRESS) != 0)
+	if (Crypt->newCrypt)
+	{
+		// DecodeArchive treats these as archives without any files
+		if ((FileSize - 64) < 0x400)
 		{
-			// 圧縮されていない場合は普通に読み込む
-			KeyConvFileRead(HeadBuffer, Head.HeadSize, ArcP, NoKey ? NULL : Key, 0);
+			Result = 0;
+			goto END;
 		}
-		else
-		{
-			void *HuffHeadBuffer;
-			u64 HuffHeadSize;
-			void *LzHeadBuffer;
-			u64 LzHeadSize;
 
-			// ハフマン圧縮されたヘッダのサイズを取得する
-			_fseeki64(ArcP, 0, SEEK_END);
-			FileSize = _ftelli64(ArcP);
-			_fseeki64(ArcP, Head.FileNameTableStartAddress, SEEK_SET);
-			HuffHeadSize = (u32)(FileSize - _ftelli64(ArcP));
+		if (!Crypt->SetupArchive(*Head, FileSize, KeyString_, KeyStringBytes)) goto END;
+	}
 
-			// ハフマン圧縮されたヘッダを読み込むメモリを確保する
-			HuffHeadBuffer = malloc((size_t)HuffHeadSize);
-			if (HuffHeadBuffer == NULL) goto ERR;
+	NoKey = (Head->Flags & DXA_FLAG_NO_KEY) != 0;
 
-			// ハフマン圧縮されたヘッダをコピーと暗号化解除
-			KeyConvFileRead(HuffHeadBuffer, HuffHeadSize, ArcP, NoKey ? NULL : Key, 0);
+	// The tables have to be located inside of the file
+	if (Head->FileNameTableStartAddress > static_cast<u64>(FileSize) || Head->DataStartAddress > Head->FileNameTableStartAddress) goto END;
 
-			// ハフマン圧縮されたヘッダの解凍後の容量を取得する
-			LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
+	HeadBuffer = (u8 *)malloc((size_t)Head->HeadSize);
+	if (HeadBuffer == NULL) goto END;
 
-			// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
-			LzHeadBuffer = malloc((size_t)LzHeadSize);
-			if (LzHeadBuffer == NULL)
-			{
-				free(HuffHeadBuffer);
-				goto ERR;
-			}
+	_fseeki64(ArcP, Head->FileNameTableStartAddress, SEEK_SET);
 
-			// ハフマン圧縮されたヘッダを解凍する
-			Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
+	if ((Head->Flags & DXA_FLAG_NO_HEAD_PRESS) != 0)
+	{
+		if (Head->HeadSize > static_cast<u64>(FileSize) - Head->FileNameTableStartAddress) goto END;
 
-			// LZ圧縮されたヘッダを解凍する
-			Decode(LzHeadBuffer, HeadBuffer);
+		KeyConvFileRead(HeadBuffer, Head->HeadSize, ArcP, NoKey ? NULL : Key, 0);
+	}
+	else
+	{
+		const u64 HuffHeadSize = static_cast<u64>(FileSize) - Head->FileNameTableStartAddress;
 
-			// メモリの解放
-			free(HuffHeadBuffer);
-			free(LzHeadBuffer);
-		}
+		HuffHeadBuffer = (u8 *)malloc((size_t)HuffHeadSize);
+		if (HuffHeadBuffer == NULL) goto END;
 
-		// 各アドレスをセットする
-		NameP = HeadBuffer;
-		FileP = NameP + Head.FileTableStartAddress;
-		DirP  = NameP + Head.DirectoryTableStartAddress;
-	}
+		KeyConvFileRead(HuffHeadBuffer, HuffHeadSize, ArcP, NoKey ? NULL : Key, 0);
 
-	// アーカイブの展開を開始する
-	DirectoryDecode(NameP, DirP, FileP, &Head, (DARC_DIRECTORY *)DirP, ArcP, Key, KeyString, KeyStringBytes, NoKey, KeyStringBuffer);
+		// Huffman coding uses at least one bit per byte, larger sizes can only come from a wrong key
+		const u64 LzHeadSize = Huffman_Decode(HuffHeadBuffer, HuffHeadSize, NULL, 0);
+		if (LzHeadSize < 9 || LzHeadSize > HuffHeadSize * 8) goto END;
 
-	// ファイルを閉じる
-	fclose(ArcP);
+		LzHeadBuffer = (u8 *)malloc((size_t)LzHeadSize);
+		if (LzHeadBuffer == NULL) goto END;
 
-	// ヘッダを読み込んでいたメモリを解放する
-	free(HeadBuffer);
+		if (Huffman_Decode(HuffHeadBuffer, HuffHeadSize, LzHeadBuffer, LzHeadSize) != LzHeadSize) goto END;
 
-	if (g_newCrypt)
-	{
-		// Remove the decrypted file
-		remove("decrypt_temp");
-	}
+		// The LZ stream stores its own compressed and decompressed size, these have to match the Huffman and table size
+		if (*((u32 *)&LzHeadBuffer[0]) != Head->HeadSize || *((u32 *)&LzHeadBuffer[4]) != LzHeadSize) goto END;
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(OldDir);
+		if (DecodeChecked(LzHeadBuffer, LzHeadSize, HeadBuffer, Head->HeadSize) < 0) goto END;
+	}
 
-	// 終了
-	return 0;
+	if (CheckArchiveHeadTable<DARC_DIRECTORY, DARC_FILEHEAD>(HeadBuffer, Head->HeadSize, Head->FileTableStartAddress, Head->DirectoryTableStartAddress, Head->FileNameTableStartAddress - Head->DataStartAddress, sizeof(DARC_FILEHEAD)))
+	{
+		*HeadBufferP = HeadBuffer;
+		HeadBuffer   = NULL;
+		Result       = 0;
+	}
 
-ERR:
+END:
+	if (LzHeadBuffer != NULL) free(LzHeadBuffer);
+	if (HuffHeadBuffer != NULL) free(HuffHeadBuffer);
 	if (HeadBuffer != NULL) free(HeadBuffer);
-	if (ArcP != NULL) fclose(ArcP);
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory(OldDir);
-
-	// 終了
-	return -1;
+	return Result;
 }
 
 // コンストラクタ
@@ -2962,6 +3119,8 @@ DXArchive::DXArchive(TCHAR *ArchivePath)
 	this->NameP = this->DirP = this->FileP = NULL;
 	this->CurrentDirectory                 = NULL;
 	this->CacheBuffer                      = NULL;
+	this->ImageReader                      = NULL;
+	this->UsePathIndex                     = false;
 
 	if (ArchivePath != NULL)
 	{
@@ -3028,7 +3187,7 @@ int DXArchive::DirectoryKeyConv(DARC_DIRECTORY *Dir, char *KeyStringBuffer)
 					// ファイル個別の鍵を作成
 					if (NoKey == false)
 					{
-						KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, Dir, File, this->FileP, this->DirP, this->NameP, (BYTE *)KeyStringBuffer);
+						KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, GetKeyDirectoryString(Dir), File, this->NameP, (BYTE *)KeyStringBuffer);
 						KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 					}
 
@@ -3139,10 +3298,10 @@ int DXArchive::OpenArchiveFile(const TCHAR *ArchivePath, const char *KeyString_)
 			KeyConvFileRead(HuffHeadBuffer, HuffHeadSize, this->fp, NoKey ? NULL : Key, 0);
 
 			// ハフマン圧縮されたヘッダの解凍後の容量を取得する
-			LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
+			LzHeadSize = Huffman_Decode(HuffHeadBuffer, HuffHeadSize, NULL, 0);
 
 			// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
-			LzHeadBuffer = malloc((size_t)LzHeadSize);
+			LzHeadBuffer = LzHeadSize != 0 ? malloc((size_t)LzHeadSize) : NULL;
 			if (LzHeadBuffer == NULL)
 			{
 				free(HuffHeadBuffer);
@@ -3150,7 +3309,12 @@ int DXArchive::OpenArchiveFile(const TCHAR *ArchivePath, const char *KeyString_)
 			}
 
 			// ハフマン圧縮されたヘッダを解凍する
-			Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
+			if (Huffman_Decode(HuffHeadBuffer, HuffHeadSize, LzHeadBuffer, LzHeadSize) != LzHeadSize)
+			{
+				free(HuffHeadBuffer);
+				free(LzHeadBuffer);
+				goto ERR;
+			}
 
 			// LZ圧縮されたヘッダを解凍する
 			Decode(LzHeadBuffer, this->HeadBuffer);
@@ -3168,6 +3332,10 @@ int DXArchive::OpenArchiveFile(const TCHAR *ArchivePath, const char *KeyString_)
 
 	// カレントディレクトリのセット
 	this->CurrentDirectory = (DARC_DIRECTORY *)this->DirP;
+	this->KeyDirectoryCache.clear();
+
+	// パス検索用のハッシュ表を作成する
+	if (this->UsePathIndex) DirectoryIndex((DARC_DIRECTORY *)this->DirP);
 
 	// メモリイメージから開いている、フラグを倒す
 	MemoryOpenFlag = false;
@@ -3224,7 +3392,19 @@ int DXArchive::OpenArchiveFileMem(const TCHAR *ArchivePath, const char *KeyStrin
 	}
 
 	// メモリに読み込む
+	// The archive is mapped copy-on-write instead, its pages are only read once they are used and only the pages
+	// modified by the decryption get a private copy, reading it into memory is left for archives which can not be mapped
+	this->ImageReader = new DXArchiveReader;
+	if (this->ImageReader->Open(ArchivePath, DXArchiveReader::Access::MAP_COPY))
+	{
+		ArchiveImage = this->ImageReader->GetImage();
+		ArchiveSize  = (s64)this->ImageReader->GetSize();
+	}
+	else
 	{
+		delete this->ImageReader;
+		this->ImageReader = NULL;
+
 		fp = _tfopen(ArchivePath, TEXT("rb"));
 		if (fp == NULL) return -1;
 		_fseeki64(fp, 0L, SEEK_END);
@@ -3246,6 +3426,14 @@ int DXArchive::OpenArchiveFileMem(const TCHAR *ArchivePath, const char *KeyStrin
 	// ＩＤが違う場合はエラー
 	if (Head.Head != DXA_HEAD)
 	{
+		if (this->ImageReader != NULL)
+		{
+			delete this->ImageReader;
+			this->ImageReader = NULL;
+		}
+		else
+			free(ArchiveImage);
+
 		return -1;
 	}
 
@@ -3293,10 +3481,10 @@ int DXArchive::OpenArchiveFileMem(const TCHAR *ArchivePath, const char *KeyStrin
 			if (this->NoKey == false) KeyConv(HuffHeadBuffer, HuffHeadSize, 0, this->Key);
 
 			// ハフマン圧縮されたヘッダの解凍後の容量を取得する
-			LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
+			LzHeadSize = Huffman_Decode(HuffHeadBuffer, HuffHeadSize, NULL, 0);
 
 			// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
-			LzHeadBuffer = malloc((size_t)LzHeadSize);
+			LzHeadBuffer = LzHeadSize != 0 ? malloc((size_t)LzHeadSize) : NULL;
 			if (LzHeadBuffer == NULL)
 			{
 				free(HuffHeadBuffer);
@@ -3304,7 +3492,12 @@ int DXArchive::OpenArchiveFileMem(const TCHAR *ArchivePath, const char *KeyStrin
 			}
 
 			// ハフマン圧縮されたヘッダを解凍する
-			Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
+			if (Huffman_Decode(HuffHeadBuffer, HuffHeadSize, LzHeadBuffer, LzHeadSize) != LzHeadSize)
+			{
+				free(HuffHeadBuffer);
+				free(LzHeadBuffer);
+				goto ERR;
+			}
 
 			// LZ圧縮されたヘッダを解凍する
 			Decode(LzHeadBuffer, this->HeadBuffer);
@@ -3322,6 +3515,10 @@ int DXArchive::OpenArchiveFileMem(const TCHAR *ArchivePath, const char *KeyStrin
 
 	// カレントディレクトリのセット
 	this->CurrentDirectory = (DARC_DIRECTORY *)this->DirP;
+	this->KeyDirectoryCache.clear();
+
+	// パス検索用のハッシュ表を作成する
+	if (this->UsePathIndex) DirectoryIndex((DARC_DIRECTORY *)this->DirP);
 
 	// メモリイメージから開いているフラグを立てる
 	MemoryOpenFlag = true;
@@ -3429,10 +3626,10 @@ int DXArchive::OpenArchiveMem(void *ArchiveImage, s64 ArchiveSize, const char *K
 			if (this->NoKey == false) KeyConv(HuffHeadBuffer, HuffHeadSize, 0, this->Key);
 
 			// ハフマン圧縮されたヘッダの解凍後の容量を取得する
-			LzHeadSize = Huffman_Decode(HuffHeadBuffer, NULL);
+			LzHeadSize = Huffman_Decode(HuffHeadBuffer, HuffHeadSize, NULL, 0);
 
 			// ハフマン圧縮されたヘッダの解凍後のデータを格納するメモリ用域の確保
-			LzHeadBuffer = malloc((size_t)LzHeadSize);
+			LzHeadBuffer = LzHeadSize != 0 ? malloc((size_t)LzHeadSize) : NULL;
 			if (LzHeadBuffer == NULL)
 			{
 				free(HuffHeadBuffer);
@@ -3440,7 +3637,12 @@ int DXArchive::OpenArchiveMem(void *ArchiveImage, s64 ArchiveSize, const char *K
 			}
 
 			// ハフマン圧縮されたヘッダを解凍する
-			Huffman_Decode(HuffHeadBuffer, LzHeadBuffer);
+			if (Huffman_Decode(HuffHeadBuffer, HuffHeadSize, LzHeadBuffer, LzHeadSize) != LzHeadSize)
+			{
+				free(HuffHeadBuffer);
+				free(LzHeadBuffer);
+				goto ERR;
+			}
 
 			// LZ圧縮されたヘッダを解凍する
 			Decode(LzHeadBuffer, this->HeadBuffer);
@@ -3458,6 +3660,10 @@ int DXArchive::OpenArchiveMem(void *ArchiveImage, s64 ArchiveSize, const char *K
 
 	// カレントディレクトリのセット
 	this->CurrentDirectory = (DARC_DIRECTORY *)this->DirP;
+	this->KeyDirectoryCache.clear();
+
+	// パス検索用のハッシュ表を作成する
+	if (this->UsePathIndex) DirectoryIndex((DARC_DIRECTORY *)this->DirP);
 
 	// メモリイメージから開いているフラグを立てる
 	MemoryOpenFlag = true;
@@ -3503,6 +3709,12 @@ int DXArchive::CloseArchiveFile(void)
 				KeyConv(this->HeadBuffer, this->Head.HeadSize, 0, this->Key);
 			}
 		}
+		else if (this->ImageReader != NULL)
+		{
+			// Unmap the archive, the decrypted pages are discarded
+			delete this->ImageReader;
+			this->ImageReader = NULL;
+		}
 		else
 		{
 			// 確保していたメモリを開放する
@@ -3517,6 +3729,8 @@ int DXArchive::CloseArchiveFile(void)
 
 	// ヘッダバッファを解放
 	free(this->HeadBuffer);
+	this->PathIndex.clear();
+	this->KeyDirectoryCache.clear();
 
 	// ポインタ初期化
 	this->fp         = NULL;
@@ -3530,6 +3744,24 @@ int DXArchive::CloseArchiveFile(void)
 
 // アーカイブ内のディレクトリパスを変更する( 0:成功  -1:失敗 )
 int DXArchive::ChangeCurrentDirectoryFast(SEARCHDATA *SearchData)
+{
+	DARC_FILEHEAD *FileH;
+
+	// カレントディレクトリから同名のディレクトリを探す
+	FileH = SearchFileHead(SearchData, true);
+
+	// 無かったらエラー
+	if (FileH == NULL) return -1;
+
+	// 在ったらカレントディレクトリを変更
+	this->CurrentDirectory = (DARC_DIRECTORY *)(this->DirP + FileH->DataAddress);
+
+	// 正常終了
+	return 0;
+}
+
+// Search the current directory for a file or directory with the name of the search data
+DARC_FILEHEAD *DXArchive::SearchFileHead(SEARCHDATA *SearchData, bool Directory)
 {
 	DARC_FILEHEAD *FileH;
 	int i, j, k, Num;
@@ -3540,13 +3772,19 @@ int DXArchive::ChangeCurrentDirectoryFast(SEARCHDATA *SearchData)
 	Parity   = SearchData->Parity;
 	PathData = SearchData->FileName;
 
-	// カレントディレクトリから同名のディレクトリを探す
+	// With the path index this is a single lookup instead of comparing all entries of the directory
+	if (!this->PathIndex.empty())
+	{
+		const auto It = this->PathIndex.find(PathIndexKey((u64)((u8 *)this->CurrentDirectory - this->DirP), Directory, Parity, PathData, PackNum));
+		return It != this->PathIndex.end() ? It->second : NULL;
+	}
+
 	FileH = (DARC_FILEHEAD *)(this->FileP + this->CurrentDirectory->FileHeadAddress);
 	Num   = (s32)this->CurrentDirectory->FileHeadNum;
 	for (i = 0; i < Num; i++, FileH++)
 	{
 		// ディレクトリチェック
-		if ((FileH->Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) continue;
+		if (((FileH->Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) != Directory) continue;
 
 		// 文字列数とパリティチェック
 		NameData = this->NameP + FileH->NameAddress;
@@ -3557,18 +3795,61 @@ int DXArchive::ChangeCurrentDirectoryFast(SEARCHDATA *SearchData)
 		for (j = 0, k = 0; j < PackNum; j++, k += 4)
 			if (*((u32 *)&PathData[k]) != *((u32 *)&NameData[k])) break;
 
-		// 適合したディレクトリがあったらここで終了
-		if (PackNum == j) break;
+		// 適合したファイルがあったらここで終了
+		if (PackNum == j) return FileH;
 	}
 
-	// 無かったらエラー
-	if (i == Num) return -1;
+	// 無かった
+	return NULL;
+}
 
-	// 在ったらカレントディレクトリを変更
-	this->CurrentDirectory = (DARC_DIRECTORY *)(this->DirP + FileH->DataAddress);
+// Add the entries of the directory and of its sub directories to the path index
+void DXArchive::DirectoryIndex(DARC_DIRECTORY *Dir)
+{
+	DARC_FILEHEAD *FileH;
+	u8 *NameData;
+	u32 i;
 
-	// 正常終了
-	return 0;
+	FileH = (DARC_FILEHEAD *)(this->FileP + Dir->FileHeadAddress);
+	for (i = 0; i < Dir->FileHeadNum; i++, FileH++)
+	{
+		const bool Directory = (FileH->Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+		// The name table holds the pack count, the parity and the packed upper case name
+		NameData = this->NameP + FileH->NameAddress;
+
+		// Like the linear search the first of several entries with the same name is found
+		this->PathIndex.emplace(PathIndexKey((u64)((u8 *)Dir - this->DirP), Directory, ((u16 *)NameData)[1], NameData + 4, ((u16 *)NameData)[0]), FileH);
+
+		if (Directory)
+			DirectoryIndex((DARC_DIRECTORY *)(this->DirP + FileH->DataAddress));
+	}
+}
+
+// The directory address, the directory flag, the parity and the packed name, so a key only matches the entry the linear search finds
+std::string DXArchive::PathIndexKey(u64 DirAddress, bool Directory, u16 Parity, const u8 *PackedName, u16 PackNum)
+{
+	std::string IndexKey(sizeof(u64) + 1 + sizeof(u16) + PackNum * 4, '\0');
+	char *Dest = &IndexKey[0];
+
+	memcpy(Dest, &DirAddress, sizeof(u64));
+	Dest[sizeof(u64)] = Directory ? 1 : 0;
+	memcpy(Dest + sizeof(u64) + 1, &Parity, sizeof(u16));
+	memcpy(Dest + sizeof(u64) + 1 + sizeof(u16), PackedName, PackNum * 4);
+
+	return IndexKey;
+}
+
+// Index all paths of the archives opened from now on
+void DXArchive::SetUsePathIndex(bool Flag)
+{
+	this->UsePathIndex = Flag;
+}
+
+// CreateKeyDirectoryString for a directory of the opened archive
+const std::string &DXArchive::GetKeyDirectoryString(DARC_DIRECTORY *Directory)
+{
+	return KeyDirectoryString(&this->KeyDirectoryCache, (int)this->Head.CharCodeFormat, Directory, this->FileP, this->DirP, this->NameP);
 }
 
 // アーカイブ内のディレクトリパスを変更する( 0:成功  -1:失敗 )
@@ -3784,7 +4065,11 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				if (HuffDataBuffer == NULL) return -1;
 
 				// ハフマン圧縮データを解凍
-				Huffman_Decode((u8 *)this->fp + this->Head.DataStartAddress + FileH->DataAddress, HuffDataBuffer);
+				if (Huffman_Decode((u8 *)this->fp + this->Head.DataStartAddress + FileH->DataAddress, FileH->HuffPressDataSize, HuffDataBuffer, FileH->PressDataSize) != FileH->PressDataSize)
+				{
+					free(HuffDataBuffer);
+					return -1;
+				}
 
 				// メモリ上の圧縮データを解凍する
 				Decode(HuffDataBuffer, Buffer);
@@ -3807,7 +4092,7 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				// ファイル個別の鍵を作成
 				if (this->NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, Directory, FileH, this->FileP, this->DirP, this->NameP, (BYTE *)KeyStringBuffer);
+					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, GetKeyDirectoryString(Directory), FileH, this->NameP, (BYTE *)KeyStringBuffer);
 					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 				}
 
@@ -3815,7 +4100,11 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				KeyConvFileRead(temp, FileH->HuffPressDataSize, this->fp, this->NoKey ? NULL : lKey, FileH->DataSize);
 
 				// ハフマン圧縮データを解凍
-				Huffman_Decode(temp, (u8 *)temp + FileH->HuffPressDataSize);
+				if (Huffman_Decode(temp, FileH->HuffPressDataSize, (u8 *)temp + FileH->HuffPressDataSize, FileH->PressDataSize) != FileH->PressDataSize)
+				{
+					free(temp);
+					return -1;
+				}
 
 				// 解凍
 				Decode((u8 *)temp + FileH->HuffPressDataSize, Buffer);
@@ -3847,7 +4136,7 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				// ファイル個別の鍵を作成
 				if (this->NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, Directory, FileH, this->FileP, this->DirP, this->NameP, (BYTE *)KeyStringBuffer);
+					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, GetKeyDirectoryString(Directory), FileH, this->NameP, (BYTE *)KeyStringBuffer);
 					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 				}
 
@@ -3872,11 +4161,15 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 			if (MemoryOpenFlag == true)
 			{
 				// ハフマン圧縮を解凍したデータを格納するメモリ領域の確保
-				HuffDataBuffer = malloc((size_t)FileH->PressDataSize);
+				HuffDataBuffer = malloc((size_t)FileH->DataSize);
 				if (HuffDataBuffer == NULL) return -1;
 
 				// ハフマン圧縮データを解凍
-				Huffman_Decode((u8 *)this->fp + this->Head.DataStartAddress + FileH->DataAddress, HuffDataBuffer);
+				if (Huffman_Decode((u8 *)this->fp + this->Head.DataStartAddress + FileH->DataAddress, FileH->HuffPressDataSize, HuffDataBuffer, FileH->DataSize) != FileH->DataSize)
+				{
+					free(HuffDataBuffer);
+					return -1;
+				}
 
 				// コピー
 				memcpy(Buffer, HuffDataBuffer, (size_t)FileH->DataSize);
@@ -3899,7 +4192,7 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				// ファイル個別の鍵を作成
 				if (this->NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, Directory, FileH, this->FileP, this->DirP, this->NameP, (BYTE *)KeyStringBuffer);
+					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, GetKeyDirectoryString(Directory), FileH, this->NameP, (BYTE *)KeyStringBuffer);
 					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 				}
 
@@ -3907,7 +4200,11 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				KeyConvFileRead(temp, FileH->HuffPressDataSize, this->fp, this->NoKey ? NULL : lKey, FileH->DataSize);
 
 				// ハフマン圧縮データを解凍
-				Huffman_Decode(temp, Buffer);
+				if (Huffman_Decode(temp, FileH->HuffPressDataSize, Buffer, FileH->DataSize) != FileH->DataSize)
+				{
+					free(temp);
+					return -1;
+				}
 
 				// メモリの解放
 				free(temp);
@@ -3931,7 +4228,7 @@ s64 DXArchive::LoadFileToMem(const TCHAR *FilePath, void *Buffer, u64 BufferLeng
 				// ファイル個別の鍵を作成
 				if (this->NoKey == false)
 				{
-					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, Directory, FileH, this->FileP, this->DirP, this->NameP, (BYTE *)KeyStringBuffer);
+					KeyStringBufferBytes = CreateKeyFileString((int)this->Head.CharCodeFormat, this->KeyString, this->KeyStringBytes, GetKeyDirectoryString(Directory), FileH, this->NameP, (BYTE *)KeyStringBuffer);
 					KeyCreate(KeyStringBuffer, KeyStringBufferBytes, lKey);
 				}
 
@@ -4049,15 +4346,22 @@ DXArchiveFile *DXArchive::OpenFile(const TCHAR *FilePath)
 }
 
 // コンストラクタ
+// Only the Huffman compressed parts are decoded here, everything else is read from the archive when it is needed
 DXArchiveFile::DXArchiveFile(DARC_FILEHEAD *FileHead, DARC_DIRECTORY *Directory, DXArchive *Archive)
 {
-	void *temp;
-
-	this->FileData   = FileHead;
-	this->Archive    = Archive;
-	this->EOFFlag    = FALSE;
-	this->FilePoint  = 0;
-	this->DataBuffer = NULL;
+	const u64 DataPosition = Archive->GetHeader()->DataStartAddress + FileHead->DataAddress;
+	const u8 HuffmanEncodeKB = Archive->GetHeader()->HuffmanEncodeKB;
+	u32 i;
+
+	this->FileData      = FileHead;
+	this->Archive       = Archive;
+	this->EOFFlag       = FALSE;
+	this->FilePoint     = 0;
+	this->PressBuffer   = NULL;
+	this->PressStream   = NULL;
+	this->BlockCache    = NULL;
+	this->BlockNum      = 0;
+	this->BlockUseCount = 0;
 
 	// 鍵を作成する
 	if (this->Archive->GetNoKey() == false)
@@ -4069,93 +4373,167 @@ DXArchiveFile::DXArchiveFile(DARC_FILEHEAD *FileHead, DARC_DIRECTORY *Directory,
 			(int)this->Archive->GetHeader()->CharCodeFormat,
 			this->Archive->GetKeyString(),
 			this->Archive->GetKeyStringBytes(),
-			Directory,
+			this->Archive->GetKeyDirectoryString(Directory),
 			FileHead,
-			this->Archive->GetFileHeadTable(),
-			this->Archive->GetDirectoryTable(),
 			this->Archive->GetNameTable(),
 			(BYTE *)KeyStringBuffer);
 		DXArchive::KeyCreate(KeyStringBuffer, KeyStringBufferBytes, Key);
 	}
 
-	// ファイルが圧縮されている場合は解凍データが収まるメモリ領域の確保
-	if (FileHead->PressDataSize != 0xffffffffffffffff ||
-		FileHead->HuffPressDataSize != 0xffffffffffffffff)
-	{
-		// 解凍データが収まるメモリ領域の確保
-		this->DataBuffer = malloc((size_t)FileHead->DataSize);
-	}
+	// LZ 圧縮されている場合は圧縮データ、それ以外はファイルデータそのもの
+	this->PressSize        = FileHead->PressDataSize != 0xffffffffffffffff ? FileHead->PressDataSize : FileHead->DataSize;
+	this->PressHeadSize    = 0;
+	this->PressFootSize    = 0;
+	this->PressAddress     = DataPosition;
+	this->PressKeyPosition = FileHead->DataSize;
 
-	// ファイルが圧縮されている場合はここで読み込んで解凍してしまう
-	if (FileHead->PressDataSize != 0xffffffffffffffff)
+	// ハフマン圧縮されている部分を解凍する
+	if (FileHead->HuffPressDataSize != 0xffffffffffffffff)
 	{
-		// ハフマン圧縮もされているかどうかで処理を分岐
-		if (FileHead->HuffPressDataSize != 0xffffffffffffffff)
-		{
-			// 圧縮データが収まるメモリ領域の確保
-			temp = malloc((size_t)(FileHead->PressDataSize + FileHead->HuffPressDataSize));
+		void *temp;
 
-			// 圧縮データの読み込み
-			_fseeki64(this->Archive->GetFilePointer(), this->Archive->GetHeader()->DataStartAddress + FileHead->DataAddress, SEEK_SET);
+		// ファイルの前後のみハフマン圧縮している場合は、間のデータはハフマン圧縮データの後ろにある
+		if (HuffmanEncodeKB != 0xff && this->PressSize > HuffmanEncodeKB * 1024 * 2)
+		{
+			this->PressHeadSize = HuffmanEncodeKB * 1024;
+			this->PressFootSize = HuffmanEncodeKB * 1024;
+		}
+		else
+		{
+			this->PressHeadSize = this->PressSize;
+		}
 
-			// 鍵解除読み込み
+		// 圧縮データの読み込み
+		temp = malloc((size_t)FileHead->HuffPressDataSize);
+		this->PressBuffer = (u8 *)malloc((size_t)(this->PressHeadSize + this->PressFootSize));
+		if (temp != NULL && this->PressBuffer != NULL)
+		{
+			_fseeki64(this->Archive->GetFilePointer(), DataPosition, SEEK_SET);
 			DXArchive::KeyConvFileRead(temp, FileHead->HuffPressDataSize, this->Archive->GetFilePointer(), this->Archive->GetNoKey() ? NULL : Key, FileHead->DataSize);
 
 			// ハフマン圧縮データを解凍
-			Huffman_Decode(temp, (u8 *)temp + FileHead->HuffPressDataSize);
-
-			// 解凍
-			DXArchive::Decode((u8 *)temp + FileHead->HuffPressDataSize, this->DataBuffer);
-
-			// メモリの解放
-			free(temp);
+			// A stream which does not decode to exactly the head and the foot leaves PressBuffer empty, every read of it fails then
+			if (Huffman_Decode(temp, FileHead->HuffPressDataSize, this->PressBuffer, this->PressHeadSize + this->PressFootSize) != this->PressHeadSize + this->PressFootSize)
+			{
+				free(this->PressBuffer);
+				this->PressBuffer = NULL;
+			}
 		}
 		else
 		{
-			// 圧縮データが収まるメモリ領域の確保
-			temp = malloc((size_t)FileHead->PressDataSize);
-
-			// 圧縮データの読み込み
-			_fseeki64(this->Archive->GetFilePointer(), this->Archive->GetHeader()->DataStartAddress + FileHead->DataAddress, SEEK_SET);
-			DXArchive::KeyConvFileRead(temp, FileHead->PressDataSize, this->Archive->GetFilePointer(), this->Archive->GetNoKey() ? NULL : Key, FileHead->DataSize);
+			free(this->PressBuffer);
+			this->PressBuffer = NULL;
+		}
+		free(temp);
 
-			// 解凍
-			DXArchive::Decode(temp, this->DataBuffer);
+		this->PressAddress     = DataPosition + FileHead->HuffPressDataSize;
+		this->PressKeyPosition = FileHead->DataSize + FileHead->HuffPressDataSize;
+	}
 
-			// メモリの解放
-			free(temp);
+	// LZ 圧縮されている場合は読み込みながら解凍する
+	if (FileHead->PressDataSize != 0xffffffffffffffff)
+	{
+		this->PressStream = new lzDecode::Stream(
+			[this](u8 *Buffer, const u64 &Offset, const size_t &Size) { return ReadPress(Buffer, Offset, Size); },
+			this->PressSize, MIN_COMPRESS);
+		this->PressStream->Reset();
+
+		this->BlockNum   = (u32)std::min<u64>(DXA_STREAM_BLOCKNUM, (FileHead->DataSize + DXA_STREAM_BLOCKSIZE - 1) / DXA_STREAM_BLOCKSIZE);
+		this->BlockCache = (u8 *)malloc((size_t)this->BlockNum * DXA_STREAM_BLOCKSIZE);
+		for (i = 0; i < DXA_STREAM_BLOCKNUM; i++)
+		{
+			this->BlockIndex[i] = 0xffffffffffffffff;
+			this->BlockUse[i]   = 0;
 		}
 	}
-	else
-		// ハフマン圧縮だけされているかどうかで処理を分岐
-		if (FileHead->HuffPressDataSize != 0xffffffffffffffff)
-		{
-			// 圧縮データが収まるメモリ領域の確保
-			temp = malloc((size_t)FileHead->HuffPressDataSize);
+}
 
-			// 圧縮データの読み込み
-			_fseeki64(this->Archive->GetFilePointer(), this->Archive->GetHeader()->DataStartAddress + FileHead->DataAddress, SEEK_SET);
+// デストラクタ
+DXArchiveFile::~DXArchiveFile()
+{
+	// メモリの解放
+	delete this->PressStream;
+	free(this->PressBuffer);
+	free(this->BlockCache);
+}
 
-			// 暗号化解除読み込み
-			DXArchive::KeyConvFileRead(temp, FileHead->HuffPressDataSize, this->Archive->GetFilePointer(), this->Archive->GetNoKey() ? NULL : Key, FileHead->DataSize);
+// Read Size bytes of the data before LZ decompression from Offset, the part between head and foot is decrypted while it is read
+bool DXArchiveFile::ReadPress(void *Buffer, u64 Offset, u64 Size)
+{
+	FILE *fp       = this->Archive->GetFilePointer();
+	u8 *Dest       = (u8 *)Buffer;
+	const u64 End  = this->PressSize - this->PressFootSize;
+	u64 MoveSize;
 
-			// ハフマン圧縮データを解凍
-			Huffman_Decode(temp, this->DataBuffer);
+	if (Offset + Size > this->PressSize) return false;
 
-			// メモリの解放
-			free(temp);
+	// The Huffman compressed part could not be decoded
+	if (this->PressBuffer == NULL && this->PressHeadSize + this->PressFootSize != 0) return false;
+
+	// 先頭のハフマン圧縮されていた部分
+	if (Size != 0 && Offset < this->PressHeadSize)
+	{
+		MoveSize = std::min<u64>(Size, this->PressHeadSize - Offset);
+		memcpy(Dest, this->PressBuffer + Offset, (size_t)MoveSize);
+		Dest += MoveSize;
+		Offset += MoveSize;
+		Size -= MoveSize;
+	}
+
+	// アーカイブから読み込む部分、アーカイブファイルポインタがずれている場合のみ移動する
+	if (Size != 0 && Offset < End)
+	{
+		const s64 Position = (s64)(this->PressAddress + Offset - this->PressHeadSize);
+
+		MoveSize = std::min<u64>(Size, End - Offset);
+		if (_ftelli64(fp) != Position)
+		{
+			_fseeki64(fp, Position, SEEK_SET);
 		}
+		DXArchive::KeyConvFileRead(Dest, MoveSize, fp, this->Archive->GetNoKey() ? NULL : Key, this->PressKeyPosition + Offset - this->PressHeadSize);
+		Dest += MoveSize;
+		Offset += MoveSize;
+		Size -= MoveSize;
+	}
+
+	// 末尾のハフマン圧縮されていた部分
+	if (Size != 0)
+	{
+		memcpy(Dest, this->PressBuffer + this->PressHeadSize + (Offset - End), (size_t)Size);
+	}
+
+	return true;
 }
 
-// デストラクタ
-DXArchiveFile::~DXArchiveFile()
+// Decoded block of an LZ compressed entry, the least recently used cache entry is replaced on a miss
+u8 *DXArchiveFile::ReadBlock(u64 Index)
 {
-	// メモリの解放
-	if (this->DataBuffer != NULL)
+	const u64 Position = Index * DXA_STREAM_BLOCKSIZE;
+	u64 Size;
+	u32 i, Slot;
+
+	Slot = 0;
+	for (i = 0; i < this->BlockNum; i++)
 	{
-		free(this->DataBuffer);
-		this->DataBuffer = NULL;
+		if (this->BlockIndex[i] == Index)
+		{
+			this->BlockUse[i] = ++this->BlockUseCount;
+			return this->BlockCache + (size_t)i * DXA_STREAM_BLOCKSIZE;
+		}
+
+		if (this->BlockUse[i] < this->BlockUse[Slot]) Slot = i;
 	}
+
+	// 解凍する、ストリームの窓に残っていない場合は先頭から解凍しなおす
+	Size = std::min<u64>(DXA_STREAM_BLOCKSIZE, this->FileData->DataSize - Position);
+	this->BlockIndex[Slot] = 0xffffffffffffffff;
+	if (!this->PressStream->Seek(Position) || this->PressStream->Read(this->BlockCache + (size_t)Slot * DXA_STREAM_BLOCKSIZE, Size) != (s64)Size)
+		return NULL;
+
+	this->BlockIndex[Slot] = Index;
+	this->BlockUse[Slot]   = ++this->BlockUseCount;
+
+	return this->BlockCache + (size_t)Slot * DXA_STREAM_BLOCKSIZE;
 }
 
 // ファイルの内容を読み込む
@@ -4166,13 +4544,6 @@ s64 DXArchiveFile::Read(void *Buffer, s64 ReadLength)
 	// EOF フラグが立っていたら０を返す
 	if (this->EOFFlag == TRUE) return 0;
 
-	// アーカイブファイルポインタと、仮想ファイルポインタが一致しているか調べる
-	// 一致していなかったらアーカイブファイルポインタを移動する
-	if (this->DataBuffer == NULL && _ftelli64(this->Archive->GetFilePointer()) != (s32)(this->FileData->DataAddress + this->Archive->GetHeader()->DataStartAddress + this->FilePoint))
-	{
-		_fseeki64(this->Archive->GetFilePointer(), this->FileData->DataAddress + this->Archive->GetHeader()->DataStartAddress + this->FilePoint, SEEK_SET);
-	}
-
 	// EOF 検出
 	if (this->FileData->DataSize == this->FilePoint)
 	{
@@ -4184,13 +4555,27 @@ s64 DXArchiveFile::Read(void *Buffer, s64 ReadLength)
 	ReadSize = ReadLength < (s64)(this->FileData->DataSize - this->FilePoint) ? ReadLength : this->FileData->DataSize - this->FilePoint;
 
 	// データを読み込む
-	if (this->DataBuffer == NULL)
+	if (this->PressStream == NULL)
 	{
-		DXArchive::KeyConvFileRead(Buffer, ReadSize, this->Archive->GetFilePointer(), this->Archive->GetNoKey() ? NULL : Key, this->FileData->DataSize + this->FilePoint);
+		if (!ReadPress(Buffer, this->FilePoint, ReadSize)) return -1;
 	}
 	else
 	{
-		memcpy(Buffer, (u8 *)this->DataBuffer + this->FilePoint, (size_t)ReadSize);
+		u8 *Dest = (u8 *)Buffer;
+		s64 MoveSize;
+
+		// 解凍済みのブロック単位でコピーする
+		for (s64 Pos = 0; Pos < ReadSize; Pos += MoveSize)
+		{
+			const u64 Point  = this->FilePoint + Pos;
+			const u64 Offset = Point % DXA_STREAM_BLOCKSIZE;
+			const u8 *Block  = ReadBlock(Point / DXA_STREAM_BLOCKSIZE);
+
+			if (Block == NULL) return -1;
+
+			MoveSize = std::min<s64>(ReadSize - Pos, DXA_STREAM_BLOCKSIZE - Offset);
+			memcpy(Dest + Pos, Block + Offset, (size_t)MoveSize);
+		}
 	}
 
 	// EOF フラグを倒す
@@ -16,9 +16,15 @@
 #include <stdio.h>
 #include <tchar.h>
 
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "ChaCha20Stream.h"
+#include "WolfCryptStream.h"
+
 // define ---------------------------------------
 
 // データ型定義
@@ -74,6 +80,9 @@
 #define DXA_VER							(0x0008)		// バージョン
 #define DXA_VER_MIN						(0x0008)		// 対応している最低バージョン
 #define DXA_BUFFERSIZE					(0x1000000)		// アーカイブ作成時に使用するバッファのサイズ
+#define DXA_MAP_BLOCKSIZE				(0x40000)		// Block size of the copy and decryption of mapped archives, small enough to stay in the cache
+#define DXA_STREAM_BLOCKSIZE			(0x10000)		// Block size of the decoded data cache of DXArchiveFile
+#define DXA_STREAM_BLOCKNUM				(16)			// Number of blocks in the decoded data cache of DXArchiveFile
 #define DXA_KEY_BYTES					(7)				// 鍵のバイト数
 #define DXA_KEY_STRING_LENGTH			(63)			// 鍵用文字列の長さ
 #define DXA_KEY_STRING_MAXLENGTH		(2048)			// 鍵用文字列バッファのサイズ
@@ -177,6 +186,66 @@ typedef struct tagDARC_ENCODEINFO
 	bool OutputStatus ;				// 状況出力を行うかどうか
 } DARC_ENCODEINFO ;
 
+// Crypt state of a single archive (formerly process globals)
+// KeyConv uses the context bound to the calling thread via DXArchiveCryptScope, without a binding the classic key XOR is used
+struct DXArchiveCrypt
+{
+	uint16_t cryptVersion = 0;
+	bool newCrypt         = false;
+	bool chacha20         = false;
+
+	uint8_t specialKey[768] = {};
+	WolfCryptStream specialStream; // Keystream of specialKey, used by KeyConv once it is built
+	uint8_t cc20Key[32]     = { 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD };
+	uint8_t cc20Nonce[12]   = { 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85 };
+	ChaCha20Stream cc20Stream; // Keystream of cc20Key / cc20Nonce, set up once the ChaCha20 crypt is selected
+
+	// v3.x archives are additionally encrypted by the offset in the archive file, this is removed directly after reading
+	bool archiveCrypt                 = false;
+	uint8_t archiveKey[768]           = {};
+	WolfCryptStream archiveStream;
+	int64_t archiveCryptEnd           = 0;  // The archive key covers [ sizeof(DARC_HEAD), archiveCryptEnd )
+	std::vector<uint8_t> bodyOverlay  = {}; // AES-CTR keystream of the data following the header
+	uint64_t tableStart               = 0;
+	std::vector<uint8_t> tableOverlay = {}; // AES-CTR keystream from the name table to the end of the archive
+
+	// Select the crypt for the given version, for CC2 Pro the ChaCha20 key is derived from the 4 bytes following the key string
+	void Setup(const uint16_t &version, const char *pKeyString, const size_t &keyStringBytes);
+
+	// Decrypt the table addresses of the header and prepare the archive crypt of a v3.x archive, false if the header is invalid
+	bool SetupArchive(DARC_HEAD &head, const int64_t &archiveSize, const char *pKeyString, const size_t &keyStringBytes);
+
+	// Remove the archive crypt from size bytes read at offset of the archive file
+	void DecryptArchiveData(void *pData, const int64_t &size, const int64_t &offset) const;
+};
+
+// Binds a crypt context to the current thread for the lifetime of the object, restores the previous binding on destruction
+class DXArchiveCryptScope
+{
+public:
+	explicit DXArchiveCryptScope(const DXArchiveCrypt *pCrypt);
+	~DXArchiveCryptScope();
+
+	DXArchiveCryptScope(const DXArchiveCryptScope &)            = delete;
+	DXArchiveCryptScope &operator=(const DXArchiveCryptScope &) = delete;
+
+	static const DXArchiveCrypt *Current();
+
+private:
+	const DXArchiveCrypt *m_pPrev;
+};
+
+class DXArchiveObserver;
+class DXArchiveSink;
+class DXArchiveBufferPool;
+class DXArchiveReader;
+struct DXArchiveListing;
+
+namespace lzDecode
+{
+class Stream;
+}
+
 // class ----------------------------------------
 
 // アーカイブクラス
@@ -197,7 +266,9 @@ public :
 	static int			EncodeArchive(const TCHAR *OutputFileName, const std::vector<std::wstring> &FileOrDirectoryPath, int FileNum, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0); // アーカイブファイルを作成する
 	static int 			EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *FolderPath, bool Press = false, bool AlwaysHuffman = false, u8 HuffmanEncodeKB = 0, const char *KeyString_ = NULL, bool NoKey = false, bool OutputStatus = true, bool MaxPress = false, uint16_t cryptVersion = 0);                               // アーカイブファイルを作成する(ディレクトリ一個だけ)
 	static int			EncodeArchiveOneDirectoryWolf(const TCHAR *OutputFileName, const TCHAR *DirectoryPath, bool Press = false, const char *KeyString_ = NULL, uint16_t cryptVersion = 0);
-	static int			DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_ = NULL ) ;								// アーカイブファイルを展開する
+	static int			DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString_ = NULL, DXArchiveObserver *pObserver = NULL, DXArchiveSink *pSink = NULL, u32 ThreadNum = 1 ) ;				// アーカイブファイルを展開する( ThreadNum threads decode the files at the same time )
+	static int			ProbeArchive(const TCHAR *ArchiveName, const char *KeyString_ = NULL ) ;													// Decrypt only the header tables and check if they form a valid archive ( 0:valid  -1:invalid )
+	static int			ListArchive(const TCHAR *ArchiveName, DXArchiveListing *Listing, const char *KeyString_ = NULL ) ;							// List the contents of the archive from its header tables, no file data is read ( 0:success  -1:failure )
 
 	int					OpenArchiveFile( const TCHAR *ArchivePath, const char *KeyString_ = NULL ) ;				// アーカイブファイルを開く( 0:成功  -1:失敗 )
 	int					OpenArchiveFileMem( const TCHAR *ArchivePath, const char *KeyString_ = NULL ) ;			// アーカイブファイルを開き最初にすべてメモリ上に読み込んでから処理する( 0:成功  -1:失敗 )
@@ -215,6 +286,7 @@ public :
 
 	int					ChangeCurrentDir( const TCHAR *DirPath ) ;									// アーカイブ内のディレクトリパスを変更する( 0:成功  -1:失敗 )
 	int					GetCurrentDir(TCHAR *DirPathBuffer, int BufferLength ) ;					// アーカイブ内のカレントディレクトリパスを取得する
+	void				SetUsePathIndex( bool Flag ) ;												// Index all paths when an archive is opened, for archives with many lookups ( has to be set before opening )
 
 
 
@@ -225,17 +297,23 @@ public :
 	static void NotConvFileWrite( void *Data, s64 Size, FILE *fp ) ;											// データを反転させてファイルに書き出す関数
 	static void NotConvFileRead( void *Data, s64 Size, FILE *fp ) ;												// データを反転させてファイルから読み込む関数
 	static size_t CreateKeyFileString( int CharCodeFormat, const char *KeyString, size_t KeyStringBytes, DARC_DIRECTORY *Directory, DARC_FILEHEAD *FileHead, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable, u8 *FileString ) ;	// カレントディレクトリにある指定のファイルの鍵用の文字列を作成する、戻り値は文字列の長さ( 単位：Byte )( FileString は DXA_KEY_STRING_MAXLENGTH の長さが必要 )
+	static size_t CreateKeyFileString( int CharCodeFormat, const char *KeyString, size_t KeyStringBytes, const std::string &DirectoryString, DARC_FILEHEAD *FileHead, u8 *NameTable, u8 *FileString ) ;	// Same as above with the directory part from CreateKeyDirectoryString, which all files of the directory share
+	static void CreateKeyDirectoryString( int CharCodeFormat, DARC_DIRECTORY *Directory, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable, std::string *DirectoryString ) ;		// The directory names which follow the file name in the key strings of the files in Directory
 	static void KeyCreate( const char *Source, size_t SourceBytes, u8 *Key ) ;									// 鍵文字列を作成
 	static void KeyConv( void *Data, s64 Size, s64 Position, unsigned char *Key ) ;								// 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 	static void KeyConvFileWrite( void *Data, s64 Size, FILE *fp, unsigned char *Key, s64 Position = -1 ) ;		// データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
 	static void KeyConvFileRead( void *Data, s64 Size, FILE *fp, unsigned char *Key, s64 Position = -1 ) ;		// ファイルから読み込んだデータを鍵文字列を使用して Xor 演算する関数( Key は必ず DXA_KEY_BYTES の長さがなければならない )
+	static bool KeyConvFileReadAt( void *Data, s64 Size, const DXArchiveReader &Reader, s64 Offset, unsigned char *Key, s64 Position ) ;	// Positional version of KeyConvFileRead, reads Size bytes at Offset of the archive ( false if the archive ends before )
+	static const void *KeyConvFileView( const DXArchiveReader &Reader, s64 Offset, s64 Size, unsigned char *Key ) ;	// The Size bytes at Offset of a mapped archive if they are stored without crypt, else NULL
 	static DATE_RESULT DateCmp( DARC_FILETIME *date1, DARC_FILETIME *date2 ) ;									// どちらが新しいかを比較する
 	static int Encode( void *Src, u32 SrcSize, void *Dest, bool OutStatus = true, bool MaxPress = false ) ;		// データを圧縮する( 戻り値:圧縮後のデータサイズ )
 	static int Decode( void *Src, void *Dest ) ;																// データを解凍する( 戻り値:解凍後のデータサイズ )
+	static int DecodeChecked( void *Src, u64 SrcSize, void *Dest, u64 DestSize ) ;								// 入出力のサイズを検証しながらデータを解凍する( 戻り値:解凍後のデータサイズ  -1 はエラー )
 	static u32 HashCRC32( const void *SrcData, size_t SrcDataSize ) ;											// バイナリデータを元に CRC32 のハッシュ値を計算する
 
 	DARC_DIRECTORY *GetCurrentDirectoryInfo( void ) ;															// アーカイブ内のカレントディレクトリの情報を取得する
 	DARC_FILEHEAD *GetFileInfo( const TCHAR *FilePath, DARC_DIRECTORY **DirectoryP = NULL ) ;					// ファイルの情報を得る
+	const std::string &GetKeyDirectoryString( DARC_DIRECTORY *Directory ) ;									// CreateKeyDirectoryString for a directory of the opened archive, kept until the archive is closed
 	inline DARC_HEAD *GetHeader( void ){ return &Head ; }
 	inline u8 *GetKey( void ){ return Key ; }
 	inline bool GetNoKey( void ){ return NoKey ; }
@@ -258,6 +336,10 @@ protected :
 	bool MemoryOpenFlag ;				// メモリ上のファイルを開いているか、フラグ
 	bool UserMemoryImageFlag ;			// ユーザーが展開したメモリイメージを使用しているか、フラグ
 	s64 MemoryImageSize ;				// メモリ上のファイルから開いていた場合のイメージのサイズ
+	bool UsePathIndex ;					// Create PathIndex when an archive is opened
+	std::unordered_map<std::string, DARC_FILEHEAD *> PathIndex ;	// Entries by their directory and search data, empty if not used
+	std::unordered_map<const DARC_DIRECTORY *, std::string> KeyDirectoryCache ;	// Results of GetKeyDirectoryString
+	DXArchiveReader *ImageReader ;		// Mapping of the archive opened by OpenArchiveFileMem, NULL if it was read into memory
 	bool NoKey ;						// 鍵処理を行わないかどうか
 	u8 Key[ DXA_KEY_BYTES ] ;			// 鍵
 	char KeyString[ DXA_KEY_STRING_LENGTH + 1 ] ;	// 鍵文字列
@@ -282,17 +364,50 @@ protected :
 		u16 PackNum ;
 	} SEARCHDATA ;
 
+	// Directory parts of the key strings by directory
+	typedef std::unordered_map<const DARC_DIRECTORY *, std::string> KEYDIRECTORYCACHE ;
+
+	// File of the archive which is extracted by DecodeArchive
+	typedef struct tagDECODEJOB
+	{
+		DARC_DIRECTORY *Dir ;			// Directory containing the file, part of the key string
+		DARC_FILEHEAD *File ;
+		std::wstring FilePath ;			// Output path
+		bool CheckProtection ;			// The file may start with the v3.5 unpack protection
+	} DECODEJOB ;
+
+	// Data shared by all files extracted by DecodeArchive
+	typedef struct tagDECODEINFO
+	{
+		u8 *NameP, *DirP, *FileP ;
+		DARC_HEAD *Head ;
+		const char *KeyString ;
+		size_t KeyStringBytes ;
+		bool NoKey ;
+		KEYDIRECTORYCACHE KeyDirectoryCache ;	// Filled by DirectoryDecode for all directories with jobs, only read by FileDecode
+		DXArchiveObserver *pObserver ;
+		DXArchiveSink *pSink ;
+		std::mutex ObserverMutex ;		// The sinks take the files of all workers at the same time, only the observer calls are serialized
+	} DECODEINFO ;
+
 	static int DirectoryEncode( int CharCodeFormat, TCHAR *DirectoryName, u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *ParentDir, SIZESAVE *Size, int DataNumber, FILE *DestFp, void *TempBuffer, bool Press, bool MaxPress, bool AlwaysHuffman, u8 HuffmanEncodeKB, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer, DARC_ENCODEINFO *EncodeInfo ) ;	// 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
-	static int DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD *Head, DARC_DIRECTORY *Dir, FILE *ArcP, unsigned char *Key, const char *KeyString, size_t KeyStringBytes, bool NoKey, char *KeyStringBuffer ) ;											// 指定のディレクトリデータにあるファイルを展開する
+	static void DirectoryDecode( DECODEINFO *Info, DARC_DIRECTORY *Dir, const TCHAR *OutputDir, std::vector<DECODEJOB> *Jobs ) ;				// 指定のディレクトリデータにあるファイルを展開リストに追加する( OutputDir が出力先、空文字列の場合はカレントディレクトリ、ディレクトリはここで作成する )
+	static int FileDecode( DECODEINFO *Info, const DECODEJOB &Job, const DXArchiveReader &Reader, char *KeyStringBuffer, DXArchiveBufferPool *pPool ) ;					// Extract a file of the list, may run on any thread which has the crypt bound ( 0:success  -1:failure )
+	static void DirectoryList( u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY *Dir, const std::wstring &DirPath, DXArchiveListing *Listing ) ;				// Add the entries of the directory data to the listing, DirPath is the path of the directory inside of the archive
 	static int StrICmp( const TCHAR *Str1, const TCHAR *Str2 ) ;							// 比較対照の文字列中の大文字を小文字として扱い比較する( 0:等しい  1:違う )
 	static int ConvSearchData( SEARCHDATA *Dest, const TCHAR *Src, int *Length ) ;		// 文字列を検索用のデータに変換( ヌル文字か \ があったら終了 )
 	static int AddFileNameData( const TCHAR *FileName, u8 *FileNameTable ) ;				// ファイル名データを追加する( 戻り値は使用したデータバイト数 )
+	static int ReadHeadTable( FILE *ArcP, const char *KeyString_, DARC_HEAD *Head, DXArchiveCrypt *Crypt, u8 **HeadBufferP ) ;	// Read, decrypt and check the header tables, Crypt has to be bound to the thread ( 0:valid  -1:invalid, *HeadBufferP stays NULL for archives without tables )
 	static TCHAR *GetOriginalFileName( u8 *FileNameTable ) ;						// ファイル名データから元のファイル名の文字列を取得する
 	static int GetDirectoryFilePath(const TCHAR *DirectoryPath, std::vector<std::wstring> *FilePathBuffer = NULL); // ディレクトリ内のファイルのパスを取得する( FilePathBuffer は一ファイルに付き256バイトの容量が必要 )
 	static void EncodeStatusErase( void ) ;														// エンコードの進行状況を表示を消去する
 	static void EncodeStatusOutput( DARC_ENCODEINFO *EncodeInfo, bool Always = false ) ;		// エンコードの進行状況を表示する
 	static void AnalyseHuffmanEncode( u64 DataSize, u8 HuffmanEncodeKB, u64 *HeadDataSize, u64 *FootDataSize ) ;	// ハフマン圧縮をする前後のサイズを取得する
 	int	ChangeCurrentDirectoryFast( SEARCHDATA *SearchData ) ;							// アーカイブ内のディレクトリパスを変更する( 0:成功  -1:失敗 )
+	DARC_FILEHEAD *SearchFileHead( SEARCHDATA *SearchData, bool Directory ) ;			// Search the current directory for the file or directory, through the path index if there is one ( NULL:not found )
+	void DirectoryIndex( DARC_DIRECTORY *Dir ) ;										// Add the entries of the directory and its sub directories to the path index
+	static const std::string &KeyDirectoryString( KEYDIRECTORYCACHE *Cache, int CharCodeFormat, DARC_DIRECTORY *Directory, u8 *FileTable, u8 *DirectoryTable, u8 *NameTable ) ;	// CreateKeyDirectoryString, memoized in Cache with the strings of the parent directories
+	static std::string PathIndexKey( u64 DirAddress, bool Directory, u16 Parity, const u8 *PackedName, u16 PackNum ) ;		// Key of an entry of the path index, the packed name is the upper case name of the search data
 	int	ChangeCurrentDirectoryBase( const TCHAR *DirectoryPath, bool ErrorIsDirectoryReset, SEARCHDATA *LastSearchData = NULL ) ;		// アーカイブ内のディレクトリパスを変更する( 0:成功  -1:失敗 )
 	int DirectoryKeyConv( DARC_DIRECTORY *Dir, char *KeyStringBuffer ) ;										// 指定のディレクトリデータの暗号化を解除する( 丸ごとメモリに読み込んだ場合用 )
 
@@ -309,23 +424,42 @@ protected :
 
 
 // アーカイブされたファイルのアクセス用のクラス
+// Entries are decoded while they are read, LZ compressed ones through a bounded window and a small block cache
 class DXArchiveFile
 {
 protected :
 	DARC_FILEHEAD *FileData ;		// ファイルデータへのポインタ
 	DXArchive *Archive ;			// アーカイブクラスへのポインタ
-	void *DataBuffer ;				// メモリにデータを展開した際のバッファのポインタ
+
+	// The data before LZ decompression ( the file data itself for entries without LZ ) is read through ReadPress,
+	// its first PressHeadSize and last PressFootSize bytes come from PressBuffer, the rest straight from the archive
+	u64 PressSize ;					// Size of the data before LZ decompression
+	u64 PressHeadSize ;				// Huffman decoded bytes at the start, PressSize if the whole data is Huffman compressed
+	u64 PressFootSize ;				// Huffman decoded bytes at the end
+	u8 *PressBuffer ;				// Huffman decoded head and foot, NULL if the entry is not Huffman compressed
+	u64 PressAddress ;				// Archive position of the byte after the head
+	u64 PressKeyPosition ;			// Key position of the byte after the head
+
+	lzDecode::Stream *PressStream ;	// Incremental decoder of LZ compressed entries, NULL otherwise
+	u8 *BlockCache ;				// Recently read blocks of LZ compressed entries
+	u32 BlockNum ;					// Number of blocks in BlockCache
+	u64 BlockIndex[ DXA_STREAM_BLOCKNUM ] ;		// Block held by each cache entry, 0xffffffffffffffff if none
+	u64 BlockUse[ DXA_STREAM_BLOCKNUM ] ;		// BlockUseCount at the last use of each cache entry, the least recent one is replaced
+	u64 BlockUseCount ;
 
 	u8 Key[ DXA_KEY_BYTES ] ;		// 鍵
 
 	int EOFFlag ;					// EOFフラグ
 	u64 FilePoint ;					// ファイルポインタ
 
+	bool ReadPress( void *Buffer, u64 Offset, u64 Size ) ;			// Read the data before LZ decompression, decrypted, from Offset
+	u8 *ReadBlock( u64 Index ) ;									// Decoded block of an LZ compressed entry through the cache ( NULL:damaged data )
+
 public :
 	DXArchiveFile( DARC_FILEHEAD *FileHead, DARC_DIRECTORY *Directory, DXArchive *Archive ) ;
 	~DXArchiveFile() ;
 
-	s64 Read( void *Buffer, s64 ReadLength ) ;					// ファイルの内容を読み込む
+	s64 Read( void *Buffer, s64 ReadLength ) ;					// ファイルの内容を読み込む( -1 if the compressed data is damaged )
 	s64 Seek( s64 SeekPoint, s64 SeekMode ) ;					// ファイルポインタを変更する
 	s64 Tell( void ) ;											// 現在のファイルポインタを得る
 	s64 Eof( void ) ;											// ファイルの終端に来ているか、のフラグを得る
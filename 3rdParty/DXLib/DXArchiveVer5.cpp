@@ -12,10 +12,17 @@
 
 // include ----------------------------
 #include "DXArchiveVer5.h"
+#include "ArchiveListing.h"
+#include "ArchiveObserver.h"
+#include "ArchiveProbe.h"
+#include "ArchiveSink.h"
+#include "KeyConvSimd.h"
+#include "LzDecode.h"
 #include <stdio.h>
 #include <windows.h>
 #include <stdint.h>
 #include <string.h>
+#include <string>
 
 // define -----------------------------
 
@@ -29,6 +36,18 @@
 static WCHAR *sjis2utf8(const char *sjis, const int32_t &len);
 static char *utf82sjis(const WCHAR *utf8);
 
+// Join an output directory and an archive entry name, an empty directory refers to the current directory
+static std::wstring JoinOutputPath(const std::wstring &dir, const TCHAR *pName)
+{
+	if (dir.empty()) return std::wstring(pName);
+
+	std::wstring path = dir;
+	if (path.back() != TEXT('\\') && path.back() != TEXT('/'))
+		path += TEXT('\\');
+
+	return path + pName;
+}
+
 // struct -----------------------------
 
 // 圧縮時間短縮用リスト
@@ -564,16 +583,9 @@ void DXArchive_VER5::KeyConv( void *Data, int Size, int Position, unsigned char
 	Position %= DXA_KEYSTR_LENGTH_VER5 ;
 
 #ifndef INLINE_ASM
-	int i, j ;
+	if( Size <= 0 ) return ;
 
-	j = Position ;
-	for( i = 0 ; i < Size ; i ++ )
-	{
-		((u8 *)Data)[i] ^= Key[j] ;
-
-		j ++ ;
-		if( j == DXA_KEYSTR_LENGTH_VER5 ) j = 0 ;
-	}
+	keyConv::xorKey< DXA_KEYSTR_LENGTH_VER5 >( Data, Size, Position, Key ) ;
 #else
 	u32 DataT, SizeT ;
 	SizeT = (u32)Size ;
@@ -920,12 +932,9 @@ NOPRESS:
 }
 
 // 指定のディレクトリデータにあるファイルを展開する
-int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, FILE *ArcP, unsigned char *Key )
+int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, FILE *ArcP, unsigned char *Key, const TCHAR *OutputDir, DXArchiveObserver *pObserver, DXArchiveSink *pSink )
 {
-	TCHAR DirPath[MAX_PATH] ;
-	
-	// 現在のカレントディレクトリを保存
-	GetCurrentDirectory( MAX_PATH, DirPath ) ;
+	std::wstring DirPath = OutputDir ;
 
 	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
 	if( Dir->DirectoryAddress != 0xffffffff && Dir->ParentDirectoryAddress != 0xffffffff )
@@ -937,12 +946,8 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 		
 		// ディレクトリの作成
 		TCHAR *pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		CreateDirectory( pName, NULL ) ;
-		delete[] pName;
-		
-		// そのディレクトリにカレントディレクトリを移す
-		pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		SetCurrentDirectory( pName ) ;
+		DirPath = JoinOutputPath( OutputDir, pName ) ;
+		pSink->MakeDirectory( DirPath ) ;
 		delete[] pName;
 	}
 
@@ -960,11 +965,10 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 			if( File->Attributes & FILE_ATTRIBUTE_DIRECTORY )
 			{
 				// ディレクトリの場合は再帰をかける
-				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER5 * )( DirP + File->DataAddress ), ArcP, Key ) ;
+				if( DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER5 * )( DirP + File->DataAddress ), ArcP, Key, DirPath.c_str(), pObserver, pSink ) < 0 ) return -1 ;
 			}
 			else
 			{
-				FILE *DestP ;
 				void *Buffer ;
 			
 				// ファイルの場合は展開する
@@ -975,8 +979,27 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 
 				// ファイルを開く
 				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-				DestP = _tfopen( pName, TEXT("wb") ) ;
+				const std::wstring FilePath = JoinOutputPath( DirPath, pName ) ;
+
+				// Entries the observer already has are left untouched
+				if( pObserver != NULL && !pObserver->ShouldExtract( FilePath, File->DataSize, File->Time.LastWrite ) )
+				{
+					delete[] pName ;
+					free( Buffer ) ;
+					continue ;
+				}
+
+				DXArchiveSink::FileHandle hFile = pSink->OpenFile( FilePath, File->DataSize ) ;
+				if( hFile == NULL )
+				{
+					delete[] pName ;
+					free( Buffer ) ;
+					return -1 ;
+				}
 				delete[] pName;
+
+				// A file the sink failed to write is not reported to the observer
+				bool Written = true ;
 				
 				// データがある場合のみ転送
 				if( File->DataSize != 0 )
@@ -1006,10 +1029,20 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						}
 						
 						// 解凍
-						Decode( temp, (u8 *)temp + File->PressDataSize ) ;
+						if( DecodeChecked( temp, File->PressDataSize, (u8 *)temp + File->PressDataSize, File->DataSize ) < 0 )
+						{
+							free( temp ) ;
+							free( Buffer ) ;
+
+							// The sink decides if the other files are still decoded
+							if( !pSink->FailFile( hFile, FilePath, File->DataSize, "corrupt LZ data" ) )
+								return -1 ;
+
+							continue ;
+						}
 						
 						// 書き出し
-						fwrite( (u8 *)temp + File->PressDataSize, File->DataSize, 1, DestP ) ;
+						Written = pSink->WriteFile( hFile, (u8 *)temp + File->PressDataSize, File->DataSize ) ;
 						
 						// メモリの解放
 						free( temp ) ;
@@ -1023,7 +1056,7 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 							u32 MoveSize, WriteSize ;
 							
 							WriteSize = 0 ;
-							while( WriteSize < File->DataSize )
+							while( Written && WriteSize < File->DataSize )
 							{
 								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE_VER5 ? DXA_BUFFERSIZE_VER5 : File->DataSize - WriteSize ;
 
@@ -1038,7 +1071,7 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 								}
 
 								// 書き出し
-								fwrite( Buffer, MoveSize, 1, DestP ) ;
+								Written = pSink->WriteFile( hFile, Buffer, MoveSize ) ;
 								
 								WriteSize += MoveSize ;
 							}
@@ -1046,53 +1079,61 @@ int DXArchive_VER5::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 					}
 				}
 				
-				// ファイルを閉じる
-				fclose( DestP ) ;
+				// ファイルを閉じる、タイムスタンプと属性を設定する
+				if( !pSink->CloseFile( hFile, File->Time.Create, File->Time.LastAccess, File->Time.LastWrite, File->Attributes ) )
+					Written = false ;
 
 				// バッファを開放する
 				free( Buffer ) ;
 
-				// ファイルのタイムスタンプを設定する
-				{
-					HANDLE HFile ;
-					FILETIME CreateTime, LastAccessTime, LastWriteTime ;
-
-					TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-					HFile = CreateFile( pName,
-										GENERIC_WRITE, 0, NULL,
-										OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL ) ;
-					delete[] pName;
-
-					if( HFile == INVALID_HANDLE_VALUE )
-					{
-						HFile = HFile ;
-					}
-
-					CreateTime.dwHighDateTime     = ( u32 )( File->Time.Create     >> 32        ) ;
-					CreateTime.dwLowDateTime      = ( u32 )( File->Time.Create     & 0xffffffff ) ;
-					LastAccessTime.dwHighDateTime = ( u32 )( File->Time.LastAccess >> 32        ) ;
-					LastAccessTime.dwLowDateTime  = ( u32 )( File->Time.LastAccess & 0xffffffff ) ;
-					LastWriteTime.dwHighDateTime  = ( u32 )( File->Time.LastWrite  >> 32        ) ;
-					LastWriteTime.dwLowDateTime   = ( u32 )( File->Time.LastWrite  & 0xffffffff ) ;
-					SetFileTime( HFile, &CreateTime, &LastAccessTime, &LastWriteTime ) ;
-					CloseHandle( HFile ) ;
-				}
+				if( !Written )
+					return -1 ;
 
-				// ファイル属性を付ける
-				pName = GetOriginalFileName(NameP + File->NameAddress);
-				SetFileAttributes(pName, File->Attributes & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
-				delete[] pName;
+				if( pObserver != NULL )
+					pObserver->OnExtracted( FilePath, File->DataSize, File->Time.LastWrite ) ;
 			}
 		}
 	}
 	
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( DirPath ) ;
-
 	// 終了
 	return 0 ;
 }
 
+// 指定のディレクトリデータにあるファイルを一覧に追加する
+void DXArchive_VER5::DirectoryList( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, const std::wstring &DirPath, DXArchiveListing *Listing )
+{
+	u32 i, FileHeadSize ;
+	DARC_FILEHEAD_VER5 *File ;
+
+	FileHeadSize = Head->Version >= 0x0002 ? sizeof( DARC_FILEHEAD_VER5 ) : sizeof( DARC_FILEHEAD_VER1 ) ;
+	File = ( DARC_FILEHEAD_VER5 * )( FileP + Dir->FileHeadAddress ) ;
+	for( i = 0 ; i < Dir->FileHeadNum ; i ++, File = (DARC_FILEHEAD_VER5 *)( (u8 *)File + FileHeadSize ) )
+	{
+		TCHAR *pName = GetOriginalFileName( NameP + File->NameAddress ) ;
+
+		DXArchiveEntry Entry ;
+		Entry.path = DirPath.empty() ? std::wstring( pName ) : DirPath + L"/" + pName ;
+		Entry.directory = ( File->Attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ;
+		Entry.attributes = File->Attributes ;
+		Entry.create = File->Time.Create ;
+		Entry.lastAccess = File->Time.LastAccess ;
+		Entry.lastWrite = File->Time.LastWrite ;
+		Entry.dataSize = File->DataSize ;
+
+		// Version 1 heads end before PressDataSize
+		if( Head->Version >= 0x0002 && File->PressDataSize != 0xffffffff )
+			Entry.pressDataSize = File->PressDataSize ;
+
+		delete[] pName ;
+
+		Listing->entries.push_back( Entry ) ;
+
+		// ディレクトリの場合は再帰をかける
+		if( Entry.directory )
+			DirectoryList( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER5 * )( DirP + File->DataAddress ), Entry.path, Listing ) ;
+	}
+}
+
 // ディレクトリ内のファイルパスを取得する
 int DXArchive_VER5::GetDirectoryFilePath( const TCHAR *DirectoryPath, TCHAR *FileNameBuffer )
 {
@@ -1499,124 +1540,17 @@ NOENCODE:
 // デコード( 戻り値:解凍後のサイズ  -1 はエラー  Dest に NULL を入れることも可能 )
 int DXArchive_VER5::Decode( void *Src, void *Dest )
 {
-	u32 srcsize, destsize, code, indexsize, keycode, conbo, index = 0;
-	u8 *srcp, *destp, *dp, *sp ;
-
-	destp = (u8 *)Dest ;
-	srcp  = (u8 *)Src ;
-	
-	// 解凍後のデータサイズを得る
-	destsize = *((u32 *)&srcp[0]) ;
-
-	// 圧縮データのサイズを得る
-	srcsize = *((u32 *)&srcp[4]) - 9 ;
-
-	// キーコード
-	keycode = srcp[8] ;
-	
 	// 出力先がない場合はサイズだけ返す
 	if( Dest == NULL )
-		return destsize ;
-	
-	// 展開開始
-	sp  = srcp + 9 ;
-	dp  = destp ;
-	while( srcsize )
-	{
-		// キーコードか同かで処理を分岐
-		if( sp[0] != keycode )
-		{
-			// 非圧縮コードの場合はそのまま出力
-			*dp = *sp ;
-			dp      ++ ;
-			sp      ++ ;
-			srcsize -- ;
-			continue ;
-		}
-	
-		// キーコードが連続していた場合はキーコード自体を出力
-		if( sp[1] == keycode )
-		{
-			*dp = (u8)keycode ;
-			dp      ++ ;
-			sp      += 2 ;
-			srcsize -= 2 ;
-			
-			continue ;
-		}
-
-		// 第一バイトを得る
-		code = sp[1] ;
-
-		// もしキーコードよりも大きな値だった場合はキーコード
-		// とのバッティング防止の為に＋１しているので－１する
-		if( code > keycode ) code -- ;
-
-		sp      += 2 ;
-		srcsize -= 2 ;
+		return ( int )*( ( u32 * )Src ) ;
 
-		// 連続長を取得する
-		conbo = code >> 3 ;
-		if( code & ( 0x1 << 2 ) )
-		{
-			conbo |= *sp << 5 ;
-			sp      ++ ;
-			srcsize -- ;
-		}
-		conbo += MIN_COMPRESS_VER5 ;	// 保存時に減算した最小圧縮バイト数を足す
-
-		// 参照相対アドレスを取得する
-		indexsize = code & 0x3 ;
-		switch( indexsize )
-		{
-		case 0 :
-			index = *sp ;
-			sp      ++ ;
-			srcsize -- ;
-			break ;
-			
-		case 1 :
-			index = *((u16 *)sp) ;
-			sp      += 2 ;
-			srcsize -= 2 ;
-			break ;
-			
-		case 2 :
-			index = *((u16 *)sp) | ( sp[2] << 16 ) ;
-			sp      += 3 ;
-			srcsize -= 3 ;
-			break ;
-		}
-		index ++ ;		// 保存時に－１しているので＋１する
-
-		// 展開
-		if( index < conbo )
-		{
-			u32 num ;
-
-			num  = index ;
-			while( conbo > num )
-			{
-				memcpy( dp, dp - num, num ) ;
-				dp    += num ;
-				conbo -= num ;
-				num   += num ;
-			}
-			if( conbo != 0 )
-			{
-				memcpy( dp, dp - num, conbo ) ;
-				dp += conbo ;
-			}
-		}
-		else
-		{
-			memcpy( dp, dp - index, conbo ) ;
-			dp += conbo ;
-		}
-	}
+	return lzDecode::Decode<false>( Src, 0, Dest, 0, MIN_COMPRESS_VER5 ) ;
+}
 
-	// 解凍後のサイズを返す
-	return (int)destsize ;
+// 入出力のサイズを検証しながらデコード( 戻り値:解凍後のサイズ  -1 はエラー )
+int DXArchive_VER5::DecodeChecked( void *Src, u64 SrcSize, void *Dest, u64 DestSize )
+{
+	return lzDecode::Decode<true>( Src, SrcSize, Dest, DestSize, MIN_COMPRESS_VER5 ) ;
 }
 
 
@@ -1910,14 +1844,16 @@ NOPRESS:
 }
 
 // アーカイブファイルを展開する
-int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString )
+int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString, DXArchiveObserver *pObserver, DXArchiveSink *pSink, u32 /*ThreadNum*/ )
 {
 	u8 *HeadBuffer = NULL ;
 	DARC_HEAD_VER5 Head ;
 	u8 *FileP, *NameP, *DirP ;
 	FILE *ArcP = NULL ;
-	TCHAR OldDir[MAX_PATH] ;
 	u8 Key[DXA_KEYSTR_LENGTH_VER5] ;
+	DXArchiveDiskSink DiskSink ;
+
+	if( pSink == NULL ) pSink = &DiskSink ;
 
 	// 鍵文字列の作成
 	KeyCreate( KeyString, Key ) ;
@@ -1926,10 +1862,6 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
 	if( ArcP == NULL ) return -1 ;
 
-	// 出力先のディレクトリにカレントディレクトリを変更する
-	GetCurrentDirectory( MAX_PATH, OldDir ) ;
-	SetCurrentDirectory( OutputPath ) ;
-
 	// ヘッダを解析する
 	{
 		KeyConvFileRead( &Head, sizeof( DARC_HEAD_VER5 ), ArcP, Key, 0 ) ;
@@ -1973,7 +1905,7 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	}
 
 	// アーカイブの展開を開始する
-	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER5 * )DirP, ArcP, Key ) ;
+	if( DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER5 * )DirP, ArcP, Key, OutputPath != NULL ? OutputPath : TEXT(""), pObserver, pSink ) < 0 ) goto ERR ;
 	
 	// ファイルを閉じる
 	fclose( ArcP ) ;
@@ -1981,9 +1913,6 @@ int DXArchive_VER5::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	// ヘッダを読み込んでいたメモリを解放する
 	free( HeadBuffer ) ;
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( OldDir ) ;
-
 	// 終了
 	return 0 ;
 
@@ -1991,14 +1920,121 @@ ERR :
 	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
 	if( ArcP != NULL ) fclose( ArcP ) ;
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( OldDir ) ;
-
 	// 終了
 	return -1 ;
 }
 
 
+// Decrypt only the header tables with the given key and check their structure, nothing is extracted
+int DXArchive_VER5::ProbeArchive(const TCHAR *ArchiveName, const char *KeyString )
+{
+	u8 *HeadBuffer = NULL ;
+	DARC_HEAD_VER5 Head ;
+	FILE *ArcP = NULL ;
+	int Result ;
+
+	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
+	if( ArcP == NULL ) return -1 ;
+
+	Result = ReadHeadTable( ArcP, KeyString, &Head, &HeadBuffer ) ;
+
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+	fclose( ArcP ) ;
+
+	return Result ;
+}
+
+// List the contents of the archive, only the header and the tables are read
+int DXArchive_VER5::ListArchive(const TCHAR *ArchiveName, DXArchiveListing *Listing, const char *KeyString )
+{
+	u8 *HeadBuffer = NULL ;
+	DARC_HEAD_VER5 Head ;
+	FILE *ArcP = NULL ;
+	int Result ;
+
+	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
+	if( ArcP == NULL ) return -1 ;
+
+	Result = ReadHeadTable( ArcP, KeyString, &Head, &HeadBuffer ) ;
+
+	if( Result == 0 )
+	{
+		Listing->version = Head.Version ;
+		Listing->cryptVersion = 0 ;
+		Listing->entries.clear() ;
+
+		DirectoryList( HeadBuffer, HeadBuffer + Head.DirectoryTableStartAddress, HeadBuffer + Head.FileTableStartAddress, &Head, ( DARC_DIRECTORY_VER5 * )( HeadBuffer + Head.DirectoryTableStartAddress ), L"", Listing ) ;
+	}
+
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+	fclose( ArcP ) ;
+
+	return Result ;
+}
+
+// ヘッダテーブルを読み込み、暗号化を解除して構造を検査する
+int DXArchive_VER5::ReadHeadTable( FILE *ArcP, const char *KeyString, DARC_HEAD_VER5 *Head, u8 **HeadBufferP )
+{
+	u8 *HeadBuffer = NULL ;
+	u8 Key[DXA_KEYSTR_LENGTH_VER5] ;
+	u32 FileSize ;
+	u32 FileHeadSize ;
+	int Result = -1 ;
+
+	*HeadBufferP = NULL ;
+
+	KeyCreate( KeyString, Key ) ;
+
+	fseek( ArcP, 0L, SEEK_END ) ;
+	FileSize = ( u32 )ftell( ArcP ) ;
+	fseek( ArcP, 0L, SEEK_SET ) ;
+
+	if( FileSize < sizeof( DARC_HEAD_VER5 ) ) goto END ;
+
+	KeyConvFileRead( Head, sizeof( DARC_HEAD_VER5 ), ArcP, Key, 0 ) ;
+
+	// Same fallback for version 2 and older archives as in DecodeArchive
+	if( Head->Head != DXA_HEAD_VER5 )
+	{
+		memset( Key, 0xffffffff, DXA_KEYSTR_LENGTH_VER5 ) ;
+
+		fseek( ArcP, 0L, SEEK_SET ) ;
+		KeyConvFileRead( Head, sizeof( DARC_HEAD_VER5 ), ArcP, Key, 0 ) ;
+	}
+
+	if( Head->Head != DXA_HEAD_VER5 || Head->Version > DXA_VER_VER5 ) goto END ;
+
+	// The tables have to be located inside of the file
+	if( Head->FileNameTableStartAddress > FileSize || Head->HeadSize > FileSize - Head->FileNameTableStartAddress || Head->DataStartAddress > Head->FileNameTableStartAddress ) goto END ;
+
+	HeadBuffer = ( u8 * )malloc( Head->HeadSize ) ;
+	if( HeadBuffer == NULL ) goto END ;
+
+	fseek( ArcP, Head->FileNameTableStartAddress, SEEK_SET ) ;
+	if( Head->Version >= 0x0005 )
+	{
+		KeyConvFileRead( HeadBuffer, Head->HeadSize, ArcP, Key, 0 ) ;
+	}
+	else
+	{
+		KeyConvFileRead( HeadBuffer, Head->HeadSize, ArcP, Key ) ;
+	}
+
+	FileHeadSize = Head->Version >= 0x0002 ? sizeof( DARC_FILEHEAD_VER5 ) : sizeof( DARC_FILEHEAD_VER1 ) ;
+
+	if( CheckArchiveHeadTable< DARC_DIRECTORY_VER5, DARC_FILEHEAD_VER5 >( HeadBuffer, Head->HeadSize, Head->FileTableStartAddress, Head->DirectoryTableStartAddress, Head->FileNameTableStartAddress - Head->DataStartAddress, FileHeadSize ) )
+	{
+		*HeadBufferP = HeadBuffer ;
+		HeadBuffer = NULL ;
+		Result = 0 ;
+	}
+
+END :
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+
+	return Result ;
+}
+
 
 // コンストラクタ
 DXArchive_VER5::DXArchive_VER5(TCHAR *ArchivePath )
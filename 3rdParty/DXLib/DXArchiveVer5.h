@@ -15,6 +15,7 @@
 // include --------------------------------------
 #include <stdio.h>
 #include <tchar.h>
+#include <string>
 
 // define ---------------------------------------
 
@@ -176,6 +177,10 @@ typedef struct tagDARC_DIRECTORY_VER5
 
 #pragma pack(pop)
 
+class DXArchiveObserver ;
+struct DXArchiveListing ;
+class DXArchiveSink ;
+
 // class ----------------------------------------
 
 // アーカイブクラス
@@ -195,7 +200,9 @@ public :
 
 	static int			EncodeArchive(const TCHAR *OutputFileName, TCHAR **FileOrDirectoryPath, int FileNum, bool Press = false, const char *KeyString = NULL ) ;	// アーカイブファイルを作成する
 	static int			EncodeArchiveOneDirectory(const TCHAR *OutputFileName, const TCHAR *FolderPath, bool Press = false, const char *KeyString = NULL, u16 cryptVersion = 0); // アーカイブファイルを作成する(ディレクトリ一個だけ)
-	static int			DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString = NULL ) ;								// アーカイブファイルを展開する
+	static int			DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString = NULL, DXArchiveObserver *pObserver = NULL, DXArchiveSink *pSink = NULL, u32 ThreadNum = 1 ) ;				// アーカイブファイルを展開する( ThreadNum is ignored, the files are always extracted one after another )
+	static int			ProbeArchive(const TCHAR *ArchiveName, const char *KeyString = NULL ) ;													// Decrypt only the header tables and check if they form a valid archive ( 0:valid  -1:invalid )
+	static int			ListArchive(const TCHAR *ArchiveName, DXArchiveListing *Listing, const char *KeyString = NULL ) ;							// List the contents of the archive from its header tables, no file data is read ( 0:success  -1:failure )
 
 	int					OpenArchiveFile( const TCHAR *ArchivePath, const char *KeyString = NULL ) ;				// アーカイブファイルを開く( 0:成功  -1:失敗 )
 	int					OpenArchiveFileMem( const TCHAR *ArchivePath, const char *KeyString = NULL ) ;			// アーカイブファイルを開き最初にすべてメモリ上に読み込んでから処理する( 0:成功  -1:失敗 )
@@ -228,6 +235,7 @@ public :
 	static DATE_RESULT DateCmp( DARC_FILETIME_VER5 *date1, DARC_FILETIME_VER5 *date2 ) ;		// どちらが新しいかを比較する
 	static int Encode( void *Src, unsigned int SrcSize, void *Dest ) ;				// データを圧縮する( 戻り値:圧縮後のデータサイズ )
 	static int Decode( void *Src, void *Dest ) ;									// データを解凍する( 戻り値:解凍後のデータサイズ )
+	static int DecodeChecked( void *Src, u64 SrcSize, void *Dest, u64 DestSize ) ;				// 入出力のサイズを検証しながらデータを解凍する( 戻り値:解凍後のデータサイズ  -1 はエラー )
 
 	DARC_DIRECTORY_VER5 *GetCurrentDirectoryInfo( void ) ;									// アーカイブ内のカレントディレクトリの情報を取得する
 	DARC_FILEHEAD_VER5 *GetFileInfo( const TCHAR *FilePath ) ;							// ファイルの情報を得る
@@ -269,7 +277,9 @@ protected :
 	} SEARCHDATA ;
 
 	static int DirectoryEncode(TCHAR *DirectoryName, u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY_VER5 *ParentDir, SIZESAVE *Size, int DataNumber, FILE *DestP, void *TempBuffer, bool Press, unsigned char *Key ) ;	// 指定のディレクトリにあるファイルをアーカイブデータに吐き出す
-	static int DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, FILE *ArcP, unsigned char *Key ) ;											// 指定のディレクトリデータにあるファイルを展開する
+	static int DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, FILE *ArcP, unsigned char *Key, const TCHAR *OutputDir, DXArchiveObserver *pObserver, DXArchiveSink *pSink ) ;											// 指定のディレクトリデータにあるファイルを展開する
+	static void DirectoryList( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER5 *Head, DARC_DIRECTORY_VER5 *Dir, const std::wstring &DirPath, DXArchiveListing *Listing ) ;				// Add the entries of the directory data to the listing, DirPath is the path of the directory inside of the archive
+	static int ReadHeadTable( FILE *ArcP, const char *KeyString, DARC_HEAD_VER5 *Head, u8 **HeadBufferP ) ;		// Read, decrypt and check the header tables ( 0:valid  -1:invalid )
 	static int StrICmp( const TCHAR *Str1, const TCHAR *Str2 ) ;							// 比較対照の文字列中の大文字を小文字として扱い比較する( 0:等しい  1:違う )
 	static int ConvSearchData( SEARCHDATA *Dest, const TCHAR *Src, int *Length ) ;		// 文字列を検索用のデータに変換( ヌル文字か \ があったら終了 )
 	static int AddFileNameData( const TCHAR *FileName, u8 *FileNameTable ) ;				// ファイル名データを追加する( 戻り値は使用したデータバイト数 )
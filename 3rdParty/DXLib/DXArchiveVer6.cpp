@@ -12,10 +12,17 @@
 
 // include ----------------------------
 #include "DXArchiveVer6.h"
+#include "ArchiveListing.h"
+#include "ArchiveObserver.h"
+#include "ArchiveProbe.h"
+#include "ArchiveSink.h"
+#include "KeyConvSimd.h"
+#include "LzDecode.h"
 #include <stdio.h>
 #include <windows.h>
 #include <stdint.h>
 #include <string.h>
+#include <string>
 
 // define -----------------------------
 
@@ -29,6 +36,18 @@
 static WCHAR *sjis2utf8(const char *sjis, const int32_t &len);
 static char *utf82sjis(const WCHAR *utf8);
 
+// Join an output directory and an archive entry name, an empty directory refers to the current directory
+static std::wstring JoinOutputPath(const std::wstring &dir, const TCHAR *pName)
+{
+	if (dir.empty()) return std::wstring(pName);
+
+	std::wstring path = dir;
+	if (path.back() != TEXT('\\') && path.back() != TEXT('/'))
+		path += TEXT('\\');
+
+	return path + pName;
+}
+
 // struct -----------------------------
 
 // 圧縮時間短縮用リスト
@@ -479,34 +498,11 @@ void DXArchive_VER6::KeyCreate( const char *Source, unsigned char *Key )
 // 鍵文字列を使用して Xor 演算( Key は必ず DXA_KEYSTR_LENGTH_VER6 の長さがなければならない )
 void DXArchive_VER6::KeyConv( void *Data, s64 Size, s64 Position, unsigned char *Key )
 {
-	Position %= DXA_KEYSTR_LENGTH_VER6 ;
-
-	if( Size < 0x100000000 )
-	{
-		u32 i, j ;
-
-		j = ( u32 )Position ;
-		for( i = 0 ; i < Size ; i ++ )
-		{
-			((u8 *)Data)[i] ^= Key[j] ;
+	if( Size <= 0 ) return ;
 
-			j ++ ;
-			if( j == DXA_KEYSTR_LENGTH_VER6 ) j = 0 ;
-		}
-	}
-	else
-	{
-		s64 i, j ;
-
-		j = Position ;
-		for( i = 0 ; i < Size ; i ++ )
-		{
-			((u8 *)Data)[i] ^= Key[j] ;
+	Position %= DXA_KEYSTR_LENGTH_VER6 ;
 
-			j ++ ;
-			if( j == DXA_KEYSTR_LENGTH_VER6 ) j = 0 ;
-		}
-	}
+	keyConv::xorKey< DXA_KEYSTR_LENGTH_VER6 >( Data, Size, Position, Key ) ;
 }
 
 // データを鍵文字列を使用して Xor 演算した後ファイルに書き出す関数( Key は必ず DXA_KEYSTR_LENGTH_VER6 の長さがなければならない )
@@ -776,12 +772,9 @@ NOPRESS:
 #include <vector>
 
 // 指定のディレクトリデータにあるファイルを展開する
-int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER6 *Head, DARC_DIRECTORY_VER6 *Dir, FILE *ArcP, unsigned char *Key )
+int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_VER6 *Head, DARC_DIRECTORY_VER6 *Dir, FILE *ArcP, unsigned char *Key, const TCHAR *OutputDir, DXArchiveObserver *pObserver, DXArchiveSink *pSink )
 {
-	TCHAR DirPath[MAX_PATH] ;
-	
-	// 現在のカレントディレクトリを保存
-	GetCurrentDirectory( MAX_PATH, DirPath ) ;
+	std::wstring DirPath = OutputDir ;
 
 	// ディレクトリ情報がある場合は、まず展開用のディレクトリを作成する
 	if( Dir->DirectoryAddress != 0xffffffffffffffff && Dir->ParentDirectoryAddress != 0xffffffffffffffff )
@@ -793,12 +786,8 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 		
 		// ディレクトリの作成
 		TCHAR *pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		CreateDirectory( pName, NULL ) ;
-		delete[] pName;
-
-		// そのディレクトリにカレントディレクトリを移す
-		pName = GetOriginalFileName(NameP + DirFile->NameAddress);
-		SetCurrentDirectory(pName) ;
+		DirPath = JoinOutputPath( OutputDir, pName ) ;
+		pSink->MakeDirectory( DirPath ) ;
 		delete[] pName;
 	}
 
@@ -816,11 +805,10 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 			if( File->Attributes & FILE_ATTRIBUTE_DIRECTORY )
 			{
 				// ディレクトリの場合は再帰をかける
-				DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER6 * )( DirP + File->DataAddress ), ArcP, Key ) ;
+				if( DirectoryDecode( NameP, DirP, FileP, Head, ( DARC_DIRECTORY_VER6 * )( DirP + File->DataAddress ), ArcP, Key, DirPath.c_str(), pObserver, pSink ) < 0 ) return -1 ;
 			}
 			else
 			{
-				FILE *DestP ;
 				void *Buffer ;
 			
 				// ファイルの場合は展開する
@@ -831,10 +819,28 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 
 				// ファイルを開く
 				TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
+				const std::wstring FilePath = JoinOutputPath( DirPath, pName ) ;
 
-				DestP = _tfopen(pName, TEXT("wb"));
+				// Entries the observer already has are left untouched
+				if( pObserver != NULL && !pObserver->ShouldExtract( FilePath, File->DataSize, File->Time.LastWrite ) )
+				{
+					delete[] pName ;
+					free( Buffer ) ;
+					continue ;
+				}
+
+				DXArchiveSink::FileHandle hFile = pSink->OpenFile( FilePath, File->DataSize ) ;
+				if( hFile == NULL )
+				{
+					delete[] pName ;
+					free( Buffer ) ;
+					return -1 ;
+				}
 
 				delete[] pName;
+
+				// A file the sink failed to write is not reported to the observer
+				bool Written = true ;
 			
 				// データがある場合のみ転送
 				if( File->DataSize != 0 )
@@ -857,10 +863,20 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 						KeyConvFileRead( temp, File->PressDataSize, ArcP, Key, File->DataSize ) ;
 						
 						// 解凍
-						Decode( temp, (u8 *)temp + File->PressDataSize ) ;
+						if( DecodeChecked( temp, File->PressDataSize, (u8 *)temp + File->PressDataSize, File->DataSize ) < 0 )
+						{
+							free( temp ) ;
+							free( Buffer ) ;
+
+							// The sink decides if the other files are still decoded
+							if( !pSink->FailFile( hFile, FilePath, File->DataSize, "corrupt LZ data" ) )
+								return -1 ;
+
+							continue ;
+						}
 						
 						// 書き出し
-						fwrite64( (u8 *)temp + File->PressDataSize, File->DataSize, DestP ) ;
+						Written = pSink->WriteFile( hFile, (u8 *)temp + File->PressDataSize, File->DataSize ) ;
 						
 						// メモリの解放
 						free( temp ) ;
@@ -874,7 +890,7 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 							u64 MoveSize, WriteSize ;
 							
 							WriteSize = 0 ;
-							while( WriteSize < File->DataSize )
+							while( Written && WriteSize < File->DataSize )
 							{
 								MoveSize = File->DataSize - WriteSize > DXA_BUFFERSIZE_VER6 ? DXA_BUFFERSIZE_VER6 : File->DataSize - WriteSize ;
 
@@ -882,7 +898,7 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 								KeyConvFileRead( Buffer, MoveSize, ArcP, Key, File->DataSize + WriteSize ) ;
 
 								// 書き出し
-								fwrite64( Buffer, MoveSize, DestP ) ;
+								Written = pSink->WriteFile( hFile, Buffer, MoveSize ) ;
 								
 								WriteSize += MoveSize ;
 							}
@@ -890,52 +906,57 @@ int DXArchive_VER6::DirectoryDecode( u8 *NameP, u8 *DirP, u8 *FileP, DARC_HEAD_V
 					}
 				}
 				
-				// ファイルを閉じる
-				fclose( DestP ) ;
+				// ファイルを閉じる、タイムスタンプと属性を設定する
+				if( !pSink->CloseFile( hFile, File->Time.Create, File->Time.LastAccess, File->Time.LastWrite, File->Attributes ) )
+					Written = false ;
 
 				// バッファを開放する
 				free( Buffer ) ;
 
-				// ファイルのタイムスタンプを設定する
-				{
-					HANDLE HFile ;
-					FILETIME CreateTime, LastAccessTime, LastWriteTime ;
-					TCHAR *pName = GetOriginalFileName(NameP + File->NameAddress);
-					HFile = CreateFile(pName,
-										GENERIC_WRITE, 0, NULL,
-										OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL ) ;
-					delete[] pName;
-
-					if( HFile == INVALID_HANDLE_VALUE )
-					{
-						HFile = HFile ;
-					}
-
-					CreateTime.dwHighDateTime     = ( u32 )( File->Time.Create     >> 32        ) ;
-					CreateTime.dwLowDateTime      = ( u32 )( File->Time.Create     & 0xffffffffffffffff ) ;
-					LastAccessTime.dwHighDateTime = ( u32 )( File->Time.LastAccess >> 32        ) ;
-					LastAccessTime.dwLowDateTime  = ( u32 )( File->Time.LastAccess & 0xffffffffffffffff ) ;
-					LastWriteTime.dwHighDateTime  = ( u32 )( File->Time.LastWrite  >> 32        ) ;
-					LastWriteTime.dwLowDateTime   = ( u32 )( File->Time.LastWrite  & 0xffffffffffffffff ) ;
-					SetFileTime( HFile, &CreateTime, &LastAccessTime, &LastWriteTime ) ;
-					CloseHandle( HFile ) ;
-				}
+				if( !Written )
+					return -1 ;
 
-				// ファイル属性を付ける
-				pName = GetOriginalFileName(NameP + File->NameAddress);
-				SetFileAttributes(pName, (u32)File->Attributes & ~(FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_HIDDEN));
-				delete[] pName;
+				if( pObserver != NULL )
+					pObserver->OnExtracted( FilePath, File->DataSize, File->Time.LastWrite ) ;
 			}
 		}
 	}
 	
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( DirPath ) ;
-
 	// 終了
 	return 0 ;
 }
 
+// 指定のディレクトリデータにあるファイルを一覧に追加する
+void DXArchive_VER6::DirectoryList( u8 *NameP, u8 *DirP, u8 *FileP, DARC_DIRECTORY_VER6 *Dir, const std::wstring &DirPath, DXArchiveListing *Listing )
+{
+	u64 i ;
+	DARC_FILEHEAD_VER6 *File ;
+
+	File = ( DARC_FILEHEAD_VER6 * )( FileP + Dir->FileHeadAddress ) ;
+	for( i = 0 ; i < Dir->FileHeadNum ; i ++, File ++ )
+	{
+		TCHAR *pName = GetOriginalFileName( NameP + File->NameAddress ) ;
+
+		DXArchiveEntry Entry ;
+		Entry.path = DirPath.empty() ? std::wstring( pName ) : DirPath + L"/" + pName ;
+		Entry.directory = ( File->Attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ;
+		Entry.attributes = File->Attributes ;
+		Entry.create = File->Time.Create ;
+		Entry.lastAccess = File->Time.LastAccess ;
+		Entry.lastWrite = File->Time.LastWrite ;
+		Entry.dataSize = File->DataSize ;
+		Entry.pressDataSize = File->PressDataSize ;
+
+		delete[] pName ;
+
+		Listing->entries.push_back( Entry ) ;
+
+		// ディレクトリの場合は再帰をかける
+		if( Entry.directory )
+			DirectoryList( NameP, DirP, FileP, ( DARC_DIRECTORY_VER6 * )( DirP + File->DataAddress ), Entry.path, Listing ) ;
+	}
+}
+
 // ディレクトリ内のファイルパスを取得する
 int DXArchive_VER6::GetDirectoryFilePath( const TCHAR *DirectoryPath, TCHAR *FileNameBuffer )
 {
@@ -1342,124 +1363,17 @@ NOENCODE:
 // デコード( 戻り値:解凍後のサイズ  -1 はエラー  Dest に NULL を入れることも可能 )
 int DXArchive_VER6::Decode( void *Src, void *Dest )
 {
-	u32 srcsize, destsize, code, indexsize, keycode, conbo, index = 0;
-	u8 *srcp, *destp, *dp, *sp ;
-
-	destp = (u8 *)Dest ;
-	srcp  = (u8 *)Src ;
-	
-	// 解凍後のデータサイズを得る
-	destsize = *((u32 *)&srcp[0]) ;
-
-	// 圧縮データのサイズを得る
-	srcsize = *((u32 *)&srcp[4]) - 9 ;
-
-	// キーコード
-	keycode = srcp[8] ;
-	
 	// 出力先がない場合はサイズだけ返す
 	if( Dest == NULL )
-		return destsize ;
-	
-	// 展開開始
-	sp  = srcp + 9 ;
-	dp  = destp ;
-	while( srcsize )
-	{
-		// キーコードか同かで処理を分岐
-		if( sp[0] != keycode )
-		{
-			// 非圧縮コードの場合はそのまま出力
-			*dp = *sp ;
-			dp      ++ ;
-			sp      ++ ;
-			srcsize -- ;
-			continue ;
-		}
-	
-		// キーコードが連続していた場合はキーコード自体を出力
-		if( sp[1] == keycode )
-		{
-			*dp = (u8)keycode ;
-			dp      ++ ;
-			sp      += 2 ;
-			srcsize -= 2 ;
-			
-			continue ;
-		}
+		return ( int )*( ( u32 * )Src ) ;
 
-		// 第一バイトを得る
-		code = sp[1] ;
-
-		// もしキーコードよりも大きな値だった場合はキーコード
-		// とのバッティング防止の為に＋１しているので－１する
-		if( code > keycode ) code -- ;
-
-		sp      += 2 ;
-		srcsize -= 2 ;
-
-		// 連続長を取得する
-		conbo = code >> 3 ;
-		if( code & ( 0x1 << 2 ) )
-		{
-			conbo |= *sp << 5 ;
-			sp      ++ ;
-			srcsize -- ;
-		}
-		conbo += MIN_COMPRESS ;	// 保存時に減算した最小圧縮バイト数を足す
-
-		// 参照相対アドレスを取得する
-		indexsize = code & 0x3 ;
-		switch( indexsize )
-		{
-		case 0 :
-			index = *sp ;
-			sp      ++ ;
-			srcsize -- ;
-			break ;
-			
-		case 1 :
-			index = *((u16 *)sp) ;
-			sp      += 2 ;
-			srcsize -= 2 ;
-			break ;
-			
-		case 2 :
-			index = *((u16 *)sp) | ( sp[2] << 16 ) ;
-			sp      += 3 ;
-			srcsize -= 3 ;
-			break ;
-		}
-		index ++ ;		// 保存時に－１しているので＋１する
-
-		// 展開
-		if( index < conbo )
-		{
-			u32 num ;
-
-			num  = index ;
-			while( conbo > num )
-			{
-				memcpy( dp, dp - num, num ) ;
-				dp    += num ;
-				conbo -= num ;
-				num   += num ;
-			}
-			if( conbo != 0 )
-			{
-				memcpy( dp, dp - num, conbo ) ;
-				dp += conbo ;
-			}
-		}
-		else
-		{
-			memcpy( dp, dp - index, conbo ) ;
-			dp += conbo ;
-		}
-	}
+	return lzDecode::Decode<false>( Src, 0, Dest, 0, MIN_COMPRESS ) ;
+}
 
-	// 解凍後のサイズを返す
-	return (int)destsize ;
+// 入出力のサイズを検証しながらデコード( 戻り値:解凍後のサイズ  -1 はエラー )
+int DXArchive_VER6::DecodeChecked( void *Src, u64 SrcSize, void *Dest, u64 DestSize )
+{
+	return lzDecode::Decode<true>( Src, SrcSize, Dest, DestSize, MIN_COMPRESS ) ;
 }
 
 
@@ -1755,14 +1669,16 @@ NOPRESS:
 }
 
 // アーカイブファイルを展開する
-int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString )
+int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, const char *KeyString, DXArchiveObserver *pObserver, DXArchiveSink *pSink, u32 /*ThreadNum*/ )
 {
 	u8 *HeadBuffer = NULL ;
 	DARC_HEAD_VER6 Head ;
 	u8 *FileP, *NameP, *DirP ;
 	FILE *ArcP = NULL ;
-	TCHAR OldDir[MAX_PATH] ;
 	u8 Key[DXA_KEYSTR_LENGTH_VER6] ;
+	DXArchiveDiskSink DiskSink ;
+
+	if( pSink == NULL ) pSink = &DiskSink ;
 
 	// 鍵文字列の作成
 	KeyCreate( KeyString, Key ) ;
@@ -1771,10 +1687,6 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
 	if( ArcP == NULL ) return -1 ;
 
-	// 出力先のディレクトリにカレントディレクトリを変更する
-	GetCurrentDirectory( MAX_PATH, OldDir ) ;
-	SetCurrentDirectory( OutputPath ) ;
-
 	// ヘッダを解析する
 	{
 		KeyConvFileRead( &Head, sizeof( DARC_HEAD_VER6 ), ArcP, Key, 0 ) ;
@@ -1801,7 +1713,7 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	}
 
 	// アーカイブの展開を開始する
-	DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER6 * )DirP, ArcP, Key ) ;
+	if( DirectoryDecode( NameP, DirP, FileP, &Head, ( DARC_DIRECTORY_VER6 * )DirP, ArcP, Key, OutputPath != NULL ? OutputPath : TEXT(""), pObserver, pSink ) < 0 ) goto ERR ;
 	
 	// ファイルを閉じる
 	fclose( ArcP ) ;
@@ -1809,9 +1721,6 @@ int DXArchive_VER6::DecodeArchive(TCHAR *ArchiveName, const TCHAR *OutputPath, c
 	// ヘッダを読み込んでいたメモリを解放する
 	free( HeadBuffer ) ;
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( OldDir ) ;
-
 	// 終了
 	return 0 ;
 
@@ -1819,14 +1728,102 @@ ERR :
 	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
 	if( ArcP != NULL ) fclose( ArcP ) ;
 
-	// カレントディレクトリを元に戻す
-	SetCurrentDirectory( OldDir ) ;
-
 	// 終了
 	return -1 ;
 }
 
 
+// Decrypt only the header tables with the given key and check their structure, nothing is extracted
+int DXArchive_VER6::ProbeArchive(const TCHAR *ArchiveName, const char *KeyString )
+{
+	u8 *HeadBuffer = NULL ;
+	DARC_HEAD_VER6 Head ;
+	FILE *ArcP = NULL ;
+	int Result ;
+
+	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
+	if( ArcP == NULL ) return -1 ;
+
+	Result = ReadHeadTable( ArcP, KeyString, &Head, &HeadBuffer ) ;
+
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+	fclose( ArcP ) ;
+
+	return Result ;
+}
+
+// List the contents of the archive, only the header and the tables are read
+int DXArchive_VER6::ListArchive(const TCHAR *ArchiveName, DXArchiveListing *Listing, const char *KeyString )
+{
+	u8 *HeadBuffer = NULL ;
+	DARC_HEAD_VER6 Head ;
+	FILE *ArcP = NULL ;
+	int Result ;
+
+	ArcP = _tfopen( ArchiveName, TEXT("rb") ) ;
+	if( ArcP == NULL ) return -1 ;
+
+	Result = ReadHeadTable( ArcP, KeyString, &Head, &HeadBuffer ) ;
+
+	if( Result == 0 )
+	{
+		Listing->version = Head.Version ;
+		Listing->cryptVersion = 0 ;
+		Listing->entries.clear() ;
+
+		DirectoryList( HeadBuffer, HeadBuffer + Head.DirectoryTableStartAddress, HeadBuffer + Head.FileTableStartAddress, ( DARC_DIRECTORY_VER6 * )( HeadBuffer + Head.DirectoryTableStartAddress ), L"", Listing ) ;
+	}
+
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+	fclose( ArcP ) ;
+
+	return Result ;
+}
+
+// ヘッダテーブルを読み込み、暗号化を解除して構造を検査する
+int DXArchive_VER6::ReadHeadTable( FILE *ArcP, const char *KeyString, DARC_HEAD_VER6 *Head, u8 **HeadBufferP )
+{
+	u8 *HeadBuffer = NULL ;
+	u8 Key[DXA_KEYSTR_LENGTH_VER6] ;
+	u64 FileSize ;
+	int Result = -1 ;
+
+	*HeadBufferP = NULL ;
+
+	KeyCreate( KeyString, Key ) ;
+
+	_fseeki64( ArcP, 0L, SEEK_END ) ;
+	FileSize = ( u64 )_ftelli64( ArcP ) ;
+	_fseeki64( ArcP, 0L, SEEK_SET ) ;
+
+	if( FileSize < sizeof( DARC_HEAD_VER6 ) ) goto END ;
+
+	KeyConvFileRead( Head, sizeof( DARC_HEAD_VER6 ), ArcP, Key, 0 ) ;
+
+	if( Head->Head != DXA_HEAD_VER6 || Head->Version > DXA_VER_VER6 || Head->Version < 0x0006 ) goto END ;
+
+	// The tables have to be located inside of the file
+	if( Head->FileNameTableStartAddress > FileSize || Head->HeadSize > FileSize - Head->FileNameTableStartAddress || Head->DataStartAddress > Head->FileNameTableStartAddress ) goto END ;
+
+	HeadBuffer = ( u8 * )malloc( ( size_t )Head->HeadSize ) ;
+	if( HeadBuffer == NULL ) goto END ;
+
+	_fseeki64( ArcP, Head->FileNameTableStartAddress, SEEK_SET ) ;
+	KeyConvFileRead( HeadBuffer, Head->HeadSize, ArcP, Key, 0 ) ;
+
+	if( CheckArchiveHeadTable< DARC_DIRECTORY_VER6, DARC_FILEHEAD_VER6 >( HeadBuffer, Head->HeadSize, Head->FileTableStartAddress, Head->DirectoryTableStartAddress, Head->FileNameTableStartAddress - Head->DataStartAddress, sizeof( DARC_FILEHEAD_VER6 ) ) )
+	{
+		*HeadBufferP = HeadBuffer ;
+		HeadBuffer = NULL ;
+		Result = 0 ;
+	}
+
+END :
+	if( HeadBuffer != NULL ) free( HeadBuffer ) ;
+
+	return Result ;
+}
+
 
 // コンストラクタ
 DXArchive_VER6::DXArchive_VER6(TCHAR *ArchivePath )
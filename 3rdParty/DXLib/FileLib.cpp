@@ -13,6 +13,7 @@
 #include <mbstring.h>
 #include <windows.h>
 #include "FileLib.h"
+#include "Crc32.h"
 
 // define ---------------------------------------
 
@@ -1492,43 +1493,7 @@ extern int CheckMultiByteChar( char *Buf )
 // バイナリデータを元に CRC32 のハッシュ値を計算する
 extern u32 FileLib_HashCRC32( const void *SrcData, size_t SrcDataSize )
 {
-	static u32 CRC32Table[ 256 ] ;
-	static int CRC32TableInit = 0 ;
-	u32 CRC = 0xffffffff ;
-	u8 *SrcByte = ( u8 * )SrcData ;
-	u32 i ;
-
-	// テーブルが初期化されていなかったら初期化する
-	if( CRC32TableInit == 0 )
-	{
-		u32 Magic = 0xedb88320 ;	// 0x4c11db7 をビットレベルで順番を逆にしたものが 0xedb88320
-		u32 j ;
-
-		for( i = 0; i < 256; i++ )
-		{
-			u32 Data = i ;
-			for( j = 0; j < 8; j++ )
-			{
-				int b = ( Data & 1 ) ;
-				Data >>= 1 ;
-				if( b != 0 )
-				{
-					Data ^= Magic ;
-				}
-			}
-			CRC32Table[ i ] = Data ;
-		}
-
-		// テーブルを初期化したフラグを立てる
-		CRC32TableInit = 1 ;
-	}
-
-	for( i = 0 ; i < SrcDataSize ; i ++ )
-	{
-		CRC = CRC32Table[ ( u8 )( CRC ^ SrcByte[ i ] ) ] ^ ( CRC >> 8 ) ;
-	}
-
-	return CRC ^ 0xffffffff ;
+	return crc32::hash( SrcData, SrcDataSize ) ;
 }
 
 
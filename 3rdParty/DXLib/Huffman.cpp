@@ -15,6 +15,13 @@
 #include <malloc.h>
 #include <string.h>
 
+// define ---------------------------------------
+
+#define HUFFMAN_TABLE_BITS		(11)							// 解凍時に一回のテーブル参照で解決するビット数
+#define HUFFMAN_TABLE_SIZE		( 1 << HUFFMAN_TABLE_BITS )		// 解凍用テーブルの要素数
+#define HUFFMAN_DECODE_UNROLL	( 56 / HUFFMAN_TABLE_BITS )		// 読み込みバッファを一回補充する毎に解凍する数値の数
+#define HUFFMAN_HEAD_MAX_BYTES	( ( 6 + 64 + 6 + 64 + 256 * ( 3 + 1 + 16 ) + 7 ) / 8 )	// 圧縮データの情報の最大バイト数
+
 // data type ------------------------------------
 
 // 数値ごとの出現数や算出されたエンコード後のビット列や、結合部分の情報等の構造体
@@ -37,6 +44,31 @@ struct BIT_STREAM
 	u8 Bits ;
 } ;
 
+// 解凍時のビット単位読み込み用データ構造体( 64bit のバッファに最下位ビットから詰めていく )
+struct BIT_READER
+{
+	const u8 *Data ;		// 圧縮データ本体
+	u64 Size ;				// 圧縮データ本体のサイズ( これ以降は 0 として扱う )
+	u64 Bytes ;				// 次にバッファに読み込むバイト位置
+	u64 Buffer ;			// 読み込み済みで未使用のビット
+	u32 Bits ;				// Buffer にある未使用のビット数
+} ;
+
+// 解凍用テーブルの要素、圧縮データの先頭 HUFFMAN_TABLE_BITS ビットに対応するノードと使用するビット数
+struct HUFFMAN_TABLE_ENTRY
+{
+	u16 NodeIndex ;			// 数値データ、ビット列が HUFFMAN_TABLE_BITS より長い場合は途中の結合データ
+	u16 BitNum ;			// 使用するビット数
+} ;
+
+// 二つの数値データを一度に解凍する為のテーブルの要素、二つ目のビット列も HUFFMAN_TABLE_BITS ビットに収まる場合に使用する
+struct HUFFMAN_PAIR_ENTRY
+{
+	u8 Data[ 2 ] ;			// 数値データ
+	u8 Num ;				// 数値データの数( 0 の場合は HUFFMAN_TABLE_ENTRY のテーブルを使用する )
+	u8 BitNum ;				// 使用するビット数
+} ;
+
 // 圧縮データの情報
 //   6bit      圧縮前のデータのサイズのビット数(A) - 1( 0=1ビット 63=64ビット )
 //   (A)bit    圧縮前のデータのサイズ
@@ -55,6 +87,10 @@ static void BitStream_Write( BIT_STREAM *BitStream, u8 BitNum, u64 OutputData )
 static u64  BitStream_Read(  BIT_STREAM *BitStream, u8 BitNum ) ;						// ビット単位の数値の読み込みを行う
 static u8   BitStream_GetBitNum( u64 Data ) ;											// 指定の数値のビット数を取得する
 static u64  BitStream_GetBytes( BIT_STREAM *BitStream ) ;								// ビット単位の入出力データのサイズ( バイト数 )を取得する
+static void BitReader_Refill( BIT_READER *Reader ) ;									// 解凍時の読み込みバッファに 56bit 以上のビットを用意する
+static void Huffman_FillTable( HUFFMAN_TABLE_ENTRY *Table, const HUFFMAN_NODE *Node, int NodeIndex, u32 Depth, u32 Code ) ;	// 解凍用テーブルを作成する
+static void Huffman_FillPairTable( HUFFMAN_PAIR_ENTRY *PairTable, const HUFFMAN_TABLE_ENTRY *Table ) ;						// 二つの数値データを一度に解凍する為のテーブルを作成する
+static u8   Huffman_DecodeOne( BIT_READER *Reader, const HUFFMAN_TABLE_ENTRY *Table, const u16 ( *ChildNode )[ 2 ] ) ;		// 数値データを一つ解凍する
 
 // code -----------------------------------------
 
@@ -127,6 +163,116 @@ u64 BitStream_GetBytes( BIT_STREAM *BitStream )
 	return BitStream->Bytes + ( BitStream->Bits != 0 ? 1 : 0 ) ;
 }
 
+// 解凍時の読み込みバッファに 56bit 以上のビットを用意する
+void BitReader_Refill( BIT_READER *Reader )
+{
+	// 8バイト読める間はまとめて読み込み、バッファに収まったバイト数だけ進める
+	if( Reader->Bytes + 8 <= Reader->Size )
+	{
+		u64 Data ;
+
+		memcpy( &Data, Reader->Data + Reader->Bytes, 8 ) ;
+		Reader->Buffer |= Data << Reader->Bits ;
+		Reader->Bytes  += ( 63 - Reader->Bits ) >> 3 ;
+		Reader->Bits   |= 56 ;
+		return ;
+	}
+
+	// 最後の 8バイトは 1バイトずつ、データの終端以降は 0 を読み込む
+	while( Reader->Bits <= 56 )
+	{
+		if( Reader->Bytes < Reader->Size )
+		{
+			Reader->Buffer |= ( u64 )Reader->Data[ Reader->Bytes ] << Reader->Bits ;
+		}
+		Reader->Bytes ++ ;
+		Reader->Bits  += 8 ;
+	}
+}
+
+// 解凍用テーブルを作成する
+// 天辺から下りながら、数値データか HUFFMAN_TABLE_BITS の深さに辿り着いたノードをビット列が一致する全ての要素にセットする
+void Huffman_FillTable( HUFFMAN_TABLE_ENTRY *Table, const HUFFMAN_NODE *Node, int NodeIndex, u32 Depth, u32 Code )
+{
+	u32 i ;
+
+	if( NodeIndex > 255 && Depth < HUFFMAN_TABLE_BITS )
+	{
+		// 先に読むビットほど下位にあるので、子のビットは Depth ビット目になる
+		Huffman_FillTable( Table, Node, Node[ NodeIndex ].ChildNode[ 0 ], Depth + 1, Code ) ;
+		Huffman_FillTable( Table, Node, Node[ NodeIndex ].ChildNode[ 1 ], Depth + 1, Code | ( 1 << Depth ) ) ;
+		return ;
+	}
+
+	for( i = Code ; i < HUFFMAN_TABLE_SIZE ; i += 1 << Depth )
+	{
+		Table[ i ].NodeIndex = ( u16 )NodeIndex ;
+		Table[ i ].BitNum    = ( u16 )Depth ;
+	}
+}
+
+// 二つの数値データを一度に解凍する為のテーブルを作成する
+// 一つ目の数値データのビット列の後に残ったビットだけで二つ目の数値データが決まる場合は二つ、それ以外は一つ解凍する
+void Huffman_FillPairTable( HUFFMAN_PAIR_ENTRY *PairTable, const HUFFMAN_TABLE_ENTRY *Table )
+{
+	u32 i ;
+
+	for( i = 0 ; i < HUFFMAN_TABLE_SIZE ; i ++ )
+	{
+		const HUFFMAN_TABLE_ENTRY *First = &Table[ i ] ;
+		const HUFFMAN_TABLE_ENTRY *Second ;
+
+		PairTable[ i ].Num = 0 ;
+
+		if( First->NodeIndex > 255 )
+		{
+			continue ;
+		}
+
+		PairTable[ i ].Data[ 0 ] = ( u8 )First->NodeIndex ;
+		PairTable[ i ].Data[ 1 ] = 0 ;
+		PairTable[ i ].Num       = 1 ;
+		PairTable[ i ].BitNum    = ( u8 )First->BitNum ;
+
+		// 残りのビットの上位は 0 で埋まっているので、残りのビット数以内で決まる数値データのみ使用できる
+		Second = &Table[ i >> First->BitNum ] ;
+		if( Second->NodeIndex <= 255 && First->BitNum + Second->BitNum <= HUFFMAN_TABLE_BITS )
+		{
+			PairTable[ i ].Data[ 1 ] = ( u8 )Second->NodeIndex ;
+			PairTable[ i ].Num       = 2 ;
+			PairTable[ i ].BitNum    = ( u8 )( First->BitNum + Second->BitNum ) ;
+		}
+	}
+}
+
+// 数値データを一つ解凍する( Reader には HUFFMAN_TABLE_BITS 以上のビットが必要 )
+u8 Huffman_DecodeOne( BIT_READER *Reader, const HUFFMAN_TABLE_ENTRY *Table, const u16 ( *ChildNode )[ 2 ] )
+{
+	const HUFFMAN_TABLE_ENTRY *Entry ;
+	int NodeIndex ;
+
+	// テーブルから数値データ、又は途中の結合データを得る
+	Entry = &Table[ Reader->Buffer & ( HUFFMAN_TABLE_SIZE - 1 ) ] ;
+	Reader->Buffer >>= Entry->BitNum ;
+	Reader->Bits    -= Entry->BitNum ;
+	NodeIndex        = Entry->NodeIndex ;
+
+	// 数値データに辿り着くまで結合データを下りていく
+	while( NodeIndex > 255 )
+	{
+		if( Reader->Bits == 0 )
+		{
+			BitReader_Refill( Reader ) ;
+		}
+
+		NodeIndex = ChildNode[ NodeIndex - 256 ][ Reader->Buffer & 1 ] ;
+		Reader->Buffer >>= 1 ;
+		Reader->Bits    -- ;
+	}
+
+	return ( u8 )NodeIndex ;
+}
+
 // データを圧縮
 //
 // 戻り値:圧縮後のサイズ  0 はエラー  Dest に NULL を入れると圧縮データ格納に必要なサイズが返る
@@ -499,14 +645,23 @@ u64 Huffman_Encode( void *Src, u64 SrcSize, void *Dest )
 //
 // 戻り値:解凍後のサイズ  0 はエラー  Dest に NULL を入れると解凍データ格納に必要なサイズが返る
 u64 Huffman_Decode( void *Press, void *Dest )
+{
+	return Huffman_Decode( Press, ~0ULL, Dest, ~0ULL ) ;
+}
+
+// 圧縮データを解凍
+//
+// 戻り値:解凍後のサイズ  0 はエラー  Dest に NULL を入れると解凍データ格納に必要なサイズが返る
+// The header and the stream have to be inside of PressSize bytes and the decoded data inside of DestSize bytes, otherwise nothing is written
+u64 Huffman_Decode( void *Press, u64 PressSize, void *Dest, u64 DestSize )
 {
     // 結合データと数値データ、０～２５５までが数値データ
     HUFFMAN_NODE Node[256 + 255] ;
 
-    u64 PressSizeCounter, DestSizeCounter, DestSize ;
+    u64 DestSizeCounter ;
     unsigned char *PressPoint, *DestPoint ;
 	u64 OriginalSize ;
-	u64 PressSize ;
+	u64 StreamSize ;
 	u64 HeadSize ;
 	u16 Weight[ 256 ] ;
     int i ;
@@ -522,10 +677,22 @@ u64 Huffman_Decode( void *Press, void *Dest )
 		u8 Minus ;
 		u16 SaveData ;
 
-		BitStream_Init( &BitStream, PressPoint, true ) ;
+		u8 HeadBuffer[ HUFFMAN_HEAD_MAX_BYTES ] ;
+
+		// A short buffer is parsed from a zero filled copy, so the header is never read past PressSize
+		if( PressSize < HUFFMAN_HEAD_MAX_BYTES )
+		{
+			memset( HeadBuffer, 0, sizeof( HeadBuffer ) ) ;
+			memcpy( HeadBuffer, PressPoint, ( size_t )PressSize ) ;
+			BitStream_Init( &BitStream, HeadBuffer, true ) ;
+		}
+		else
+		{
+			BitStream_Init( &BitStream, PressPoint, true ) ;
+		}
 
 		OriginalSize = BitStream_Read( &BitStream, ( u8 )( BitStream_Read( &BitStream, 6 ) + 1 ) ) ;
-		PressSize    = BitStream_Read( &BitStream, ( u8 )( BitStream_Read( &BitStream, 6 ) + 1 ) ) ;
+		StreamSize   = BitStream_Read( &BitStream, ( u8 )( BitStream_Read( &BitStream, 6 ) + 1 ) ) ;
 
 		// 出現頻度のテーブルを復元する
 		BitNum      = ( u8 )( BitStream_Read( &BitStream, 3 ) + 1 ) * 2 ;
@@ -542,330 +709,147 @@ u64 Huffman_Decode( void *Press, void *Dest )
 
 		HeadSize = BitStream_GetBytes( &BitStream ) ;
 	}
-    
+
+	// 圧縮データが PressSize に収まっていない場合はエラー
+	if( HeadSize > PressSize || StreamSize > PressSize - HeadSize )
+		return 0 ;
+
     // Dest が NULL の場合は 解凍後のデータのサイズを返す
     if( Dest == NULL )
         return OriginalSize ;
 
+	// 解凍後のデータが DestSize に収まらない場合はエラー
+	if( OriginalSize > DestSize )
+		return 0 ;
+
     // 解凍後のデータのサイズを取得する
     DestSize = OriginalSize ;
 
     // 各数値の結合データを構築する
+    // 圧縮時は残っている要素の中から出現数値が一番少ない要素( 同じ場合は要素配列のインデックスが小さい方 )を
+    // 二つ選んで結合している、結合データは作成された順に出現数値が増えていくので、出現数値順に並べた
+    // 数値データと作成順の結合データの二つの列の先頭を比べるだけで圧縮時と同じ要素を選ぶことができる
     {
-        int NodeIndex, MinNode1, MinNode2 ;
-        int NodeNum, DataNum ;
+        int SortedData[ 256 ] ;
+        int MinNode[ 2 ] ;
+        int DataPos, NodePos, NodeNum, j ;
 
         // 数値データを初期化する
-        for( i = 0 ; i < 256 + 255 ; i ++ )
+        for( i = 0 ; i < 256 ; i ++ )
         {
             Node[i].Weight = Weight[i] ;    // 出現数は保存しておいたデータからコピー
             Node[i].ChildNode[0] = -1 ;    // 数値データが終点なので -1 をセットする
             Node[i].ChildNode[1] = -1 ;    // 数値データが終点なので -1 をセットする
-            Node[i].ParentNode = -1 ;      // まだどの要素とも結合されていないので -1 をセットする
+            SortedData[i] = i ;
         }
 
-        // 出現数の少ない数値データ or 結合データを繋いで
-        // 新しい結合データを作成、全ての要素を繋いで残り１個になるまで繰り返す
-        // (圧縮時と同じコードです)
-        DataNum = 256 ; // 残り要素数
-        NodeNum = 256 ; // 次に新しく作る結合データの要素配列のインデックス
-        while( DataNum > 1 )
+        // 数値データを出現数値順に並べる( 挿入ソートなので出現数値が同じ場合はインデックス順のまま )
+        for( i = 1 ; i < 256 ; i ++ )
         {
-            // 出現数値の低い要素二つを探す
-            {
-                MinNode1 = -1 ;
-                MinNode2 = -1 ;
-                
-                // 残っている要素全てを調べるまでループ
-                NodeIndex = 0 ;
-                for( i = 0 ; i < DataNum ; NodeIndex ++ )
-                {
-                    // もう既に何処かの要素と結合されている場合は対象外
-                    if( Node[NodeIndex].ParentNode != -1 ) continue ;
-                    
-                    i ++ ;
-                    
-                    // まだ有効な要素をセットしていないか、より出現数値の
-                    // 少ない要素が見つかったら更新
-                    if( MinNode1 == -1 || Node[MinNode1].Weight > Node[NodeIndex].Weight )
-                    {
-                        // 今まで一番出現数値が少なかったと思われた
-                        // 要素は二番目に降格
-                        MinNode2 = MinNode1 ;
+            int Data = SortedData[ i ] ;
 
-                        // 新しい一番の要素の要素配列のインデックスを保存
-                        MinNode1 = NodeIndex ;
-                    }
-                    else
-                    {
-                        // 一番よりは出現数値が多くても、二番目よりは出現数値が
-                        // 少ないかもしれないので一応チェック(又は二番目に出現数値の
-                        // 少ない要素がセットされていなかった場合もセット)
-                        if( MinNode2 == -1 || Node[MinNode2].Weight > Node[NodeIndex].Weight )
-                        {
-                            MinNode2 = NodeIndex ;
-                        }
-                    }
-                }
+            for( j = i - 1 ; j >= 0 && Node[ SortedData[ j ] ].Weight > Node[ Data ].Weight ; j -- )
+            {
+                SortedData[ j + 1 ] = SortedData[ j ] ;
             }
-            
-            // 二つの要素を繋いで新しい要素(結合データ)を作る
-            Node[NodeNum].ParentNode = -1 ;  // 新しいデータは当然まだ何処とも繋がっていないので -1 
-            Node[NodeNum].Weight = Node[MinNode1].Weight + Node[MinNode2].Weight ;    // 出現数値は二つの数値を足したものをセットする
-            Node[NodeNum].ChildNode[0] = MinNode1 ;    // この結合部で 0 を選んだら出現数値が一番少ない要素に繋がる
-            Node[NodeNum].ChildNode[1] = MinNode2 ;    // この結合部で 1 を選んだら出現数値が二番目に少ない要素に繋がる
-
-            // 結合された要素二つに、自分達に何の値が割り当てられたかをセットする
-            Node[MinNode1].Index = 0 ;    // 一番出現数値が少ない要素は 0 番
-            Node[MinNode2].Index = 1 ;    // 二番目に出現数値が少ない要素は 1 番
-
-            // 結合された要素二つに、自分達を結合した結合データの要素配列インデックスをセットする
-            Node[MinNode1].ParentNode = NodeNum ;
-            Node[MinNode2].ParentNode = NodeNum ;
-
-            // 要素の数を一個増やす
-            NodeNum ++ ;
-
-            // 残り要素の数は、一つ要素が新しく追加された代わりに
-            // 二つの要素が結合されて検索の対象から外れたので
-            // 結果 1 - 2 で -1 
-            DataNum -- ;
+            SortedData[ j + 1 ] = Data ;
         }
 
-        // 各数値の圧縮時のビット列を割り出す
+        // 出現数の少ない数値データ or 結合データを繋いで
+        // 新しい結合データを作成、全ての要素を繋いで残り１個になるまで繰り返す
+        DataPos = 0 ;
+        NodePos = 256 ;
+        for( NodeNum = 256 ; NodeNum < 256 + 255 ; NodeNum ++ )
         {
-            unsigned char TempBitArray[32] ;
-            int TempBitIndex, TempBitCount, BitIndex, BitCount ;
-        
-            // 数値データと結合データの数だけ繰り返す
-            for( i = 0 ; i < 256 + 254 ; i ++ )
+            // 出現数値の低い要素二つを選ぶ、同じ出現数値ならインデックスの小さい数値データが先
+            for( j = 0 ; j < 2 ; j ++ )
             {
-                // 数値データから結合データを上へ上へと辿ってビット数を数える
+                if( NodePos == NodeNum || ( DataPos < 256 && Node[ SortedData[ DataPos ] ].Weight <= Node[ NodePos ].Weight ) )
                 {
-                    // ビット数を初期化しておく
-                    Node[i].BitNum = 0 ;
-                    
-                    // 一時的に数値データから遡っていったときのビット列を保存する処理の準備
-                    TempBitIndex = 0 ;
-                    TempBitCount = 0 ;
-                    TempBitArray[TempBitIndex] = 0 ;
-                    
-                    // 何処かと結合されている限りカウントし続ける(天辺は何処とも結合されていないので終点だと分かる)
-                    for( NodeIndex = ( int )i ; Node[NodeIndex].ParentNode != -1 ; NodeIndex = Node[NodeIndex].ParentNode )
-                    {
-                        // 配列要素一つに入るビットデータは８個なので、同じ配列要素に
-                        // 既に８個保存していたら次の配列要素に保存先を変更する
-                        if( TempBitCount == 8 )
-                        {
-                            TempBitCount = 0 ;
-                            TempBitIndex ++ ;
-                            TempBitArray[TempBitIndex] = 0 ;
-                        }
-                        
-                        // 新しく書き込む情報で今までのデータを上書きしてしまわないように１ビット左にシフトする
-                        TempBitArray[TempBitIndex] <<= 1 ;
-
-                        // 結合データに割り振られたインデックスを最下位ビット(一番右側のビット)に書き込む
-                        TempBitArray[TempBitIndex] |= (unsigned char)Node[NodeIndex].Index ;
-
-                        // 保存したビット数を増やす
-                        TempBitCount ++ ;
-
-                        // ビット数を増やす
-                        Node[i].BitNum ++ ;
-                    }
+                    MinNode[ j ] = SortedData[ DataPos ] ;
+                    DataPos ++ ;
                 }
-				
-                // TempBitArray に溜まったデータは数値データから結合データを天辺に向かって
-                // 上へ上へと遡っていった時のビット列なので、逆さまにしないと圧縮後のビット
-                // 配列として使えない(展開時に天辺の結合データから数値データまで辿ることが
-                // 出来ない)ので、順序を逆さまにしたものを数値データ内のビット列バッファに保存する
+                else
                 {
-                    BitCount = 0 ;
-                    BitIndex = 0 ;
-                    
-                    // 最初のバッファを初期化しておく
-                    // (全部 論理和(or)演算 で書き込むので、最初から１になっている
-                    // ビットに０を書き込んでも１のままになってしまうため)
-                    Node[i].BitArray[BitIndex] = 0 ;
-                    
-                    // 一時的に保存しておいたビット列の最初まで遡る
-                    while( TempBitIndex >= 0 )
-                    {
-                        // 書き込んだビット数が一つの配列要素に入る８ビットに
-                        // 達してしまったら次の配列要素に移る
-                        if( BitCount == 8 )
-                        {
-                            BitCount = 0 ;
-                            BitIndex ++ ;
-                            Node[i].BitArray[BitIndex] = 0 ;
-                        }
-
-                        // まだ何も書き込まれていないビットアドレスに１ビット書き込む
-                        Node[i].BitArray[BitIndex] |= (unsigned char)( ( TempBitArray[TempBitIndex] & 1 ) << BitCount ) ;
-						
-                        // 書き込み終わったビットはもういらないので次のビットを
-                        // 書き込めるように１ビット右にシフトする
-                        TempBitArray[TempBitIndex] >>= 1 ;
-                        
-                        // １ビット書き込んだので残りビット数を１個減らす
-                        TempBitCount -- ;
-                        
-                        // もし現在書き込み元となっている配列要素に書き込んでいない
-                        // ビット情報が無くなったら次の配列要素に移る
-                        if( TempBitCount == 0 )
-                        {
-                            TempBitIndex -- ;
-                            TempBitCount = 8 ;
-                        }
-                        
-                        // 書き込んだビット数を増やす
-                        BitCount ++ ;
-                    }
+                    MinNode[ j ] = NodePos ;
+                    NodePos ++ ;
                 }
             }
-		}
+
+            // 二つの要素を繋いで新しい要素(結合データ)を作る
+            Node[NodeNum].Weight = Node[MinNode[0]].Weight + Node[MinNode[1]].Weight ;    // 出現数値は二つの数値を足したものをセットする
+            Node[NodeNum].ChildNode[0] = MinNode[0] ;    // この結合部で 0 を選んだら出現数値が一番少ない要素に繋がる
+            Node[NodeNum].ChildNode[1] = MinNode[1] ;    // この結合部で 1 を選んだら出現数値が二番目に少ない要素に繋がる
+        }
     }
 
     // 解凍処理
+    // 圧縮データは各バイトの最下位ビットから順に格納されているので、64bit のバッファに下位から詰めて
+    // 先頭 HUFFMAN_TABLE_BITS ビットでテーブルを引き、それより長いビット列は結合データから 1bit ずつ下りる
     {
-        unsigned char *PressData ;
-        int PressBitCounter, PressBitData, Index, NodeIndex ;
-		int NodeIndexTable[ 512 ] ;
-		int j ;
-
-		// 各ビット配列がどのノードに繋がるかのテーブルを作成する
+		HUFFMAN_TABLE_ENTRY Table[ HUFFMAN_TABLE_SIZE ] ;
+		HUFFMAN_PAIR_ENTRY PairTable[ HUFFMAN_TABLE_SIZE ] ;
+		u16 ChildNode[ 255 ][ 2 ] ;
+		BIT_READER Reader ;
+		u32 j ;
+
+		// 結合データの天辺は一番最後の結合データが格納される５１０番目(０番から数える)
+		Huffman_FillTable( Table, Node, 510, 0, 0 ) ;
+		Huffman_FillPairTable( PairTable, Table ) ;
+
+		// 下りる時に参照する結合データの子をまとめておく
+		for( i = 0 ; i < 255 ; i ++ )
 		{
-			u16 BitMask[ 9 ] ;
-
-			for( i = 0 ; i < 9 ; i ++ )
-			{
-				BitMask[ i ] = ( u16 )( ( 1 << ( i + 1 ) ) - 1 ) ;
-			}
-
-			for( i = 0 ; i < 512 ; i ++ )
-			{
-				NodeIndexTable[ i ] = -1 ;
-
-				// ビット列に適合したノードを探す
-				for( j = 0 ; j < 256 + 254 ; j ++ )
-				{
-					u16 BitArray01 ;
-
-					if( Node[ j ].BitNum > 9 )
-					{
-						continue ;
-					}
-
-					BitArray01 = ( u16 )Node[ j ].BitArray[ 0 ] | ( Node[ j ].BitArray[ 1 ] << 8 ) ;
-					if( ( i & BitMask[ Node[ j ].BitNum - 1 ] ) == ( BitArray01 & BitMask[ Node[ j ].BitNum - 1 ] ) )
-					{
-						NodeIndexTable[ i ] = j ;
-						break ;
-					}
-				}
-			}
+			ChildNode[ i ][ 0 ] = ( u16 )Node[ 256 + i ].ChildNode[ 0 ] ;
+			ChildNode[ i ][ 1 ] = ( u16 )Node[ 256 + i ].ChildNode[ 1 ] ;
 		}
 
-        // 圧縮データ本体の先頭アドレスをセット
-        // (圧縮データ本体は元のサイズ、圧縮後のサイズ、各数値の出現数等を
-        // 格納するデータ領域の後にある)
-        PressData = PressPoint + HeadSize ;
+        // 圧縮データ本体は元のサイズ、圧縮後のサイズ、各数値の出現数等を
+        // 格納するデータ領域の後にある
+		Reader.Data   = PressPoint + HeadSize ;
+		Reader.Size   = StreamSize ;
+		Reader.Bytes  = 0 ;
+		Reader.Buffer = 0 ;
+		Reader.Bits   = 0 ;
 
-        // 解凍したデータの格納アドレスを初期化
+        // 補充後は 56bit 以上あるので、HUFFMAN_DECODE_UNROLL 回までは補充せずにテーブルを引ける
+        // 一回で最大二つの数値データを出力するので、出力先に余裕がある間だけまとめて解凍する
         DestSizeCounter = 0 ;
-        
-        // 圧縮データの参照アドレスを初期化
-        PressSizeCounter = 0 ;
-        
-        // 圧縮ビットデータのカウンタを初期化
-        PressBitCounter = 0 ;
-        
-        // 圧縮データの１バイト目をセット
-        PressBitData = PressData[PressSizeCounter] ;
-
-        // 圧縮前のデータサイズになるまで解凍処理を繰り返す
-        for( DestSizeCounter = 0 ; DestSizeCounter < DestSize ; DestSizeCounter ++ )
+        while( DestSize - DestSizeCounter >= HUFFMAN_DECODE_UNROLL * 2 )
         {
-            // ビット列から数値データを検索する
-            {
-				// 最後の17byte分のデータは天辺から探す( 最後の次のバイトを読み出そうとしてメモリの不正なアクセスになる可能性があるため )
-				if( DestSizeCounter >= DestSize - 17 )
+			BitReader_Refill( &Reader ) ;
+
+			for( j = 0 ; j < HUFFMAN_DECODE_UNROLL ; j ++ )
+			{
+				const HUFFMAN_PAIR_ENTRY *Pair = &PairTable[ Reader.Buffer & ( HUFFMAN_TABLE_SIZE - 1 ) ] ;
+
+				if( Pair->Num == 0 )
 				{
-					// 結合データの天辺は一番最後の結合データが格納される５１０番目(０番から数える)
-					// 天辺から順に下に降りていく
-					NodeIndex = 510 ;
+					// ビット列が長い場合は結合データを下りる
+					DestPoint[ DestSizeCounter ] = Huffman_DecodeOne( &Reader, Table, ChildNode ) ;
+					DestSizeCounter ++ ;
+
+					// 下りる途中で補充している可能性があるので、残りは次の補充の後で解凍する
+					break ;
 				}
-				else
-				{
-					// それ以外の場合はテーブルを使用する
 
-                    // もし PressBitData に格納されている全ての
-                    // ビットデータを使い切ってしまった場合は次の
-                    // ビットデータをセットする
-                    if( PressBitCounter == 8 )
-                    {
-                        PressSizeCounter ++ ;
-                        PressBitData = PressData[PressSizeCounter] ;
-                        PressBitCounter = 0 ;
-                    }
+				DestPoint[ DestSizeCounter     ] = Pair->Data[ 0 ] ;
+				DestPoint[ DestSizeCounter + 1 ] = Pair->Data[ 1 ] ;
+				DestSizeCounter += Pair->Num ;
+				Reader.Buffer  >>= Pair->BitNum ;
+				Reader.Bits     -= Pair->BitNum ;
+			}
+        }
 
-					// 圧縮データを9bit分用意する
-					PressBitData = ( PressBitData | ( PressData[ PressSizeCounter + 1 ] << ( 8 - PressBitCounter ) ) ) & 0x1ff ;
-
-					// テーブルから最初の結合データを探す
-					NodeIndex = NodeIndexTable[ PressBitData ] ;
-
-					// 使った分圧縮データのアドレスを進める
-					PressBitCounter += Node[ NodeIndex ].BitNum ;
-					if( PressBitCounter >= 16 )
-					{
-						PressSizeCounter += 2 ;
-						PressBitCounter -= 16 ;
-						PressBitData = PressData[PressSizeCounter] >> PressBitCounter ;
-					}
-					else
-					if( PressBitCounter >= 8 )
-					{
-						PressSizeCounter ++ ;
-						PressBitCounter -= 8 ;
-						PressBitData = PressData[PressSizeCounter] >> PressBitCounter ;
-					}
-					else
-					{
-						PressBitData >>= Node[ NodeIndex ].BitNum ;
-					}
-				}
-                
-                // 数値データに辿り着くまで結合データを下りていく
-                while( NodeIndex > 255 )
-                {
-                    // もし PressBitData に格納されている全ての
-                    // ビットデータを使い切ってしまった場合は次の
-                    // ビットデータをセットする
-                    if( PressBitCounter == 8 )
-                    {
-                        PressSizeCounter ++ ;
-                        PressBitData = PressData[PressSizeCounter] ;
-                        PressBitCounter = 0 ;
-                    }
-                    
-                    // １ビット取得する
-                    Index = PressBitData & 1 ;
-                    
-                    // 使用した１ビット分だけ右にシフトする
-                    PressBitData >>= 1 ;
-                    
-                    // 使用したビット数を一個増やす
-                    PressBitCounter ++ ;
-                    
-                    // 次の要素(結合データか数値データかはまだ分からない)に移る
-                    NodeIndex = Node[NodeIndex].ChildNode[Index] ;
-                }
-            }
+        // 残りは一つずつ解凍する
+        for( ; DestSizeCounter < DestSize ; DestSizeCounter ++ )
+        {
+			if( Reader.Bits < HUFFMAN_TABLE_BITS )
+			{
+				BitReader_Refill( &Reader ) ;
+			}
 
-            // 辿り着いた数値データを出力
-            DestPoint[DestSizeCounter] = (unsigned char)NodeIndex ;
+			DestPoint[ DestSizeCounter ] = Huffman_DecodeOne( &Reader, Table, ChildNode ) ;
         }
     }
 
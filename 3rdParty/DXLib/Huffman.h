@@ -52,4 +52,8 @@ extern u64 Huffman_Encode( void *Src, u64 SrcSize, void *Dest ) ;
 // 戻り値:解凍後のサイズ  0 はエラー  Dest に NULL を入れると解凍データ格納に必要なサイズが返る
 extern u64 Huffman_Decode( void *Press, void *Dest ) ;
 
+// 圧縮データを解凍( PressSize と DestSize を超えて読み書きしない )
+// 戻り値:解凍後のサイズ  0 はエラー( 圧縮データが PressSize に、解凍後のデータが DestSize に収まらない場合も含む )  Dest に NULL を入れると解凍データ格納に必要なサイズが返る
+extern u64 Huffman_Decode( void *Press, u64 PressSize, void *Dest, u64 DestSize ) ;
+
 #endif // HUFFMAN_H
\ No newline at end of file
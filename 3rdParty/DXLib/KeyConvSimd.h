@@ -0,0 +1,244 @@
+/*
+ *  File: KeyConvSimd.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
+// Vectorized XOR of the data with a short repeating key, used by the KeyConv functions of all archive versions.
+// The key is expanded into KEY_LEN vectors starting at the key position of the first byte, as KEY_LEN vectors
+// cover a whole number of key periods, the same vectors apply to every following block of KEY_LEN vectors.
+// xorStream applies a precomputed keystream (see WolfCryptStream) the same way.
+namespace keyConv
+{
+template<std::size_t KEY_LEN>
+inline void xorKeyPlain(uint8_t *pData, const uint64_t &size, const uint64_t &position, const uint8_t *pKey)
+{
+	std::size_t j = static_cast<std::size_t>(position % KEY_LEN);
+
+	for (uint64_t i = 0; i < size; i++)
+	{
+		pData[i] ^= pKey[j];
+
+		j++;
+		if (j == KEY_LEN) j = 0;
+	}
+}
+
+struct SSE2
+{
+	using Vec                          = __m128i;
+	static constexpr std::size_t WIDTH = 16;
+
+	static Vec Load(const uint8_t *p)
+	{
+		return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+	}
+
+	static void Store(uint8_t *p, const Vec &v)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm_xor_si128(a, b);
+	}
+
+	static Vec Set(const uint8_t &value)
+	{
+		return _mm_set1_epi8(static_cast<char>(value));
+	}
+};
+
+struct AVX2
+{
+	using Vec                          = __m256i;
+	static constexpr std::size_t WIDTH = 32;
+
+	static Vec Load(const uint8_t *p)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+	}
+
+	static void Store(uint8_t *p, const Vec &v)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm256_xor_si256(a, b);
+	}
+
+	static Vec Set(const uint8_t &value)
+	{
+		return _mm256_set1_epi8(static_cast<char>(value));
+	}
+};
+
+struct AVX512
+{
+	using Vec                          = __m512i;
+	static constexpr std::size_t WIDTH = 64;
+
+	static Vec Load(const uint8_t *p)
+	{
+		return _mm512_loadu_si512(p);
+	}
+
+	static void Store(uint8_t *p, const Vec &v)
+	{
+		_mm512_storeu_si512(p, v);
+	}
+
+	static Vec Xor(const Vec &a, const Vec &b)
+	{
+		return _mm512_xor_si512(a, b);
+	}
+
+	static Vec Set(const uint8_t &value)
+	{
+		return _mm512_set1_epi8(static_cast<char>(value));
+	}
+};
+
+template<std::size_t KEY_LEN, typename Ops>
+inline void xorKeySimd(uint8_t *pData, const uint64_t &size, const uint64_t &position, const uint8_t *pKey)
+{
+	constexpr std::size_t BLOCK = KEY_LEN * Ops::WIDTH;
+
+	// Setting up the key vectors costs more than it saves for short data
+	if (size < BLOCK)
+	{
+		xorKeyPlain<KEY_LEN>(pData, size, position, pKey);
+		return;
+	}
+
+	uint8_t pattern[BLOCK];
+
+	for (std::size_t i = 0, j = static_cast<std::size_t>(position % KEY_LEN); i < BLOCK; i++)
+	{
+		pattern[i] = pKey[j];
+
+		j++;
+		if (j == KEY_LEN) j = 0;
+	}
+
+	typename Ops::Vec keys[KEY_LEN];
+	for (std::size_t k = 0; k < KEY_LEN; k++)
+		keys[k] = Ops::Load(pattern + k * Ops::WIDTH);
+
+	uint64_t i = 0;
+
+	for (; i + BLOCK <= size; i += BLOCK)
+	{
+		for (std::size_t k = 0; k < KEY_LEN; k++)
+		{
+			uint8_t *p = pData + i + k * Ops::WIDTH;
+			Ops::Store(p, Ops::Xor(Ops::Load(p), keys[k]));
+		}
+	}
+
+	// Less than a block left, it starts at the same key position as a block
+	for (std::size_t k = 0; i + Ops::WIDTH <= size; i += Ops::WIDTH, k++)
+	{
+		uint8_t *p = pData + i;
+		Ops::Store(p, Ops::Xor(Ops::Load(p), keys[k]));
+	}
+
+	xorKeyPlain<KEY_LEN>(pData + i, size - i, position + i, pKey);
+}
+
+using XorKeyFunction = void (*)(uint8_t *, const uint64_t &, const uint64_t &, const uint8_t *);
+
+template<std::size_t KEY_LEN>
+inline XorKeyFunction selectXorKey(const simd::CpuFeatures &features)
+{
+	if (features.avx512f)
+		return xorKeySimd<KEY_LEN, AVX512>;
+	else if (features.avx2)
+		return xorKeySimd<KEY_LEN, AVX2>;
+	else if (features.sse2)
+		return xorKeySimd<KEY_LEN, SSE2>;
+	else
+		return xorKeyPlain<KEY_LEN>;
+}
+
+// XOR size bytes of the data with the key of KEY_LEN bytes, position is the key offset of the first byte
+template<std::size_t KEY_LEN>
+inline void xorKey(void *pData, const uint64_t &size, const uint64_t &position, const uint8_t *pKey)
+{
+	static const XorKeyFunction xorKeyFunc = selectXorKey<KEY_LEN>(simd::detectCpuFeatures());
+	xorKeyFunc(static_cast<uint8_t *>(pData), size, position, pKey);
+}
+
+inline void xorStreamPlain(uint8_t *pData, const uint8_t *pStream, const uint64_t &size, const uint8_t &value)
+{
+	for (uint64_t i = 0; i < size; i++)
+		pData[i] ^= pStream[i] ^ value;
+}
+
+template<typename Ops>
+inline void xorStreamSimd(uint8_t *pData, const uint8_t *pStream, const uint64_t &size, const uint8_t &value)
+{
+	const typename Ops::Vec valueVec = Ops::Set(value);
+
+	uint64_t i = 0;
+
+	for (; i + Ops::WIDTH <= size; i += Ops::WIDTH)
+	{
+		uint8_t *p = pData + i;
+		Ops::Store(p, Ops::Xor(Ops::Load(p), Ops::Xor(Ops::Load(pStream + i), valueVec)));
+	}
+
+	xorStreamPlain(pData + i, pStream + i, size - i, value);
+}
+
+using XorStreamFunction = void (*)(uint8_t *, const uint8_t *, const uint64_t &, const uint8_t &);
+
+inline XorStreamFunction selectXorStream(const simd::CpuFeatures &features)
+{
+	if (features.avx512f)
+		return xorStreamSimd<AVX512>;
+	else if (features.avx2)
+		return xorStreamSimd<AVX2>;
+	else if (features.sse2)
+		return xorStreamSimd<SSE2>;
+	else
+		return xorStreamPlain;
+}
+
+// XOR size bytes of the data with the keystream and a constant byte
+inline void xorStream(void *pData, const uint8_t *pStream, const uint64_t &size, const uint8_t &value)
+{
+	static const XorStreamFunction xorStreamFunc = selectXorStream(simd::detectCpuFeatures());
+	xorStreamFunc(static_cast<uint8_t *>(pData), pStream, size, value);
+}
+} // namespace keyConv
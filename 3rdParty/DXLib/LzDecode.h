@@ -0,0 +1,549 @@
+/*
+ *  File: LzDecode.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <immintrin.h>
+#include <vector>
+
+// LZ decoder shared by the Decode functions of all archive versions.
+// The stream starts with a 9 byte header (decompressed size, compressed size including the header, key code),
+// every byte that is not the key code is a literal, the key code introduces a match or an escaped key code.
+// Literal runs are copied 16 bytes at a time while searching for the next key code, short matches are copied in
+// 16 byte chunks, long ones with memcpy. The chunks over-copy by up to 15 bytes, so they are only used while that
+// many bytes remain in the source and destination, the tail is decoded byte wise.
+//
+// The CHECKED version validates every read and write against the given buffer sizes and returns -1 instead,
+// so a stream decrypted with a wrong key can not corrupt memory. The unchecked version trusts the stream.
+//
+// Stream decodes the same format incrementally for entries which should not be decompressed at once.
+namespace lzDecode
+{
+static constexpr uint32_t HEAD_SIZE = 9;
+static constexpr uint32_t CHUNK     = 16;
+
+// Longer matches are copied with memcpy
+static constexpr uint32_t MAX_CHUNK_MATCH = 64;
+
+// Copies the literals up to the next key code, returns the number of copied bytes
+inline std::size_t copyLiterals(uint8_t *pDest, const uint8_t *pSrc, const uint8_t *pSrcEnd, const uint8_t *pDestEnd, const uint8_t &keyCode)
+{
+	const __m128i key = _mm_set1_epi8(static_cast<char>(keyCode));
+	std::size_t len   = 0;
+
+	while (pSrc + len + CHUNK <= pSrcEnd && pDest + len + CHUNK <= pDestEnd)
+	{
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + len));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pDest + len), data);
+
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, key)));
+		if (mask != 0) return len + std::countr_zero(mask);
+
+		len += CHUNK;
+	}
+
+	while (pSrc + len < pSrcEnd && pDest + len < pDestEnd && pSrc[len] != keyCode)
+	{
+		pDest[len] = pSrc[len];
+		len++;
+	}
+
+	return len;
+}
+
+// Copies a match of length size starting offset bytes before pDest without over-copying
+inline void copyMatchExact(uint8_t *pDest, const uint32_t &offset, uint32_t size)
+{
+	if (offset >= size)
+	{
+		std::memcpy(pDest, pDest - offset, size);
+		return;
+	}
+
+	// Overlapping match, the last offset bytes repeat, the copied block doubles with every step
+	uint32_t num = offset;
+	while (size > num)
+	{
+		std::memcpy(pDest, pDest - num, num);
+		pDest += num;
+		size -= num;
+		num += num;
+	}
+
+	if (size != 0)
+		std::memcpy(pDest, pDest - num, size);
+}
+
+// Copies a match of length size starting offset bytes before pDest
+inline void copyMatch(uint8_t *pDest, const uint32_t &offset, const uint32_t &size, const uint8_t *pDestEnd)
+{
+	// Long matches are left to memcpy, as are matches without room for over-copying
+	if (size > MAX_CHUNK_MATCH || pDest + size + CHUNK > pDestEnd)
+	{
+		copyMatchExact(pDest, offset, size);
+		return;
+	}
+
+	const uint8_t *pSrc = pDest - offset;
+	uint32_t i          = 0;
+
+	if (offset >= CHUNK)
+	{
+		// Each chunk only reads bytes written before it, two chunks are processed at once if they are independent
+		if (offset >= CHUNK * 2)
+		{
+			for (; i + CHUNK < size; i += CHUNK * 2)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i + CHUNK));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(pDest + i), a);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(pDest + i + CHUNK), b);
+			}
+		}
+
+		for (; i < size; i += CHUNK)
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pDest + i), _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i)));
+
+		return;
+	}
+
+	// Short distance, the pattern repeats every offset bytes, so every byte equals the one step bytes before it
+	// with step being the first multiple of offset that allows whole chunks, only the first step bytes are copied byte wise
+	const uint32_t step = offset * ((CHUNK + offset - 1) / offset);
+
+	for (; i < step && i < size; i++)
+		pDest[i] = pSrc[i];
+
+	for (; i < size; i += CHUNK)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pDest + i), _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDest + i - step)));
+}
+
+template<bool CHECKED>
+inline int Decode(const void *pSrcData, const uint64_t &srcCapacity, void *pDestData, const uint64_t &destCapacity, const uint32_t &minCompress)
+{
+	const uint8_t *pSrc = static_cast<const uint8_t *>(pSrcData);
+	uint8_t *pDest      = static_cast<uint8_t *>(pDestData);
+
+	if constexpr (CHECKED)
+	{
+		if (srcCapacity < HEAD_SIZE) return -1;
+	}
+
+	uint32_t destSize, srcSize;
+	std::memcpy(&destSize, pSrc, sizeof(uint32_t));
+	std::memcpy(&srcSize, pSrc + 4, sizeof(uint32_t));
+	const uint8_t keyCode = pSrc[8];
+
+	if constexpr (CHECKED)
+	{
+		if (srcSize < HEAD_SIZE || srcSize > srcCapacity || destSize > destCapacity || destSize > INT32_MAX) return -1;
+	}
+
+	const uint8_t *sp      = pSrc + HEAD_SIZE;
+	const uint8_t *pSrcEnd = pSrc + srcSize;
+	uint8_t *dp            = pDest;
+	uint8_t *pDestEnd      = pDest + destSize;
+
+	while (sp < pSrcEnd)
+	{
+		if (*sp != keyCode)
+		{
+			const std::size_t len = copyLiterals(dp, sp, pSrcEnd, pDestEnd, keyCode);
+
+			// Only stops without a key code if the destination is full
+			if (len == 0)
+			{
+				if constexpr (CHECKED) return -1;
+				break;
+			}
+
+			dp += len;
+			sp += len;
+			continue;
+		}
+
+		if constexpr (CHECKED)
+		{
+			if (pSrcEnd - sp < 2) return -1;
+		}
+
+		// Two key codes in a row are an escaped key code
+		if (sp[1] == keyCode)
+		{
+			if constexpr (CHECKED)
+			{
+				if (dp == pDestEnd) return -1;
+			}
+
+			*dp++ = keyCode;
+			sp += 2;
+			continue;
+		}
+
+		// Codes above the key code were incremented by the encoder to avoid the escape sequence
+		uint32_t code = sp[1];
+		if (code > keyCode) code--;
+
+		sp += 2;
+
+		const uint32_t indexSize = code & 0x3;
+
+		if constexpr (CHECKED)
+		{
+			const std::size_t needed = ((code & (0x1 << 2)) ? 1 : 0) + (indexSize == 3 ? 0 : indexSize + 1);
+			if (static_cast<std::size_t>(pSrcEnd - sp) < needed) return -1;
+		}
+
+		// Match length, the encoder subtracted the minimum length
+		uint32_t conbo = code >> 3;
+		if (code & (0x1 << 2))
+			conbo |= *sp++ << 5;
+		conbo += minCompress;
+
+		// Distance of the match, stored minus one
+		uint32_t index = 0;
+		switch (indexSize)
+		{
+			case 0:
+				index = sp[0];
+				sp++;
+				break;
+
+			case 1:
+				index = sp[0] | (sp[1] << 8);
+				sp += 2;
+				break;
+
+			case 2:
+				index = sp[0] | (sp[1] << 8) | (sp[2] << 16);
+				sp += 3;
+				break;
+		}
+		index++;
+
+		if constexpr (CHECKED)
+		{
+			if (index > static_cast<std::size_t>(dp - pDest) || conbo > static_cast<std::size_t>(pDestEnd - dp)) return -1;
+		}
+
+		copyMatch(dp, index, conbo, pDestEnd);
+		dp += conbo;
+	}
+
+	if constexpr (CHECKED)
+	{
+		// A valid stream ends exactly at both ends
+		if (sp != pSrcEnd || dp != pDestEnd) return -1;
+	}
+
+	return static_cast<int>(destSize);
+}
+
+// Incremental, always checked decoder. Only the last WINDOW bytes of the output are kept, which is the largest
+// distance a match can reach, and the compressed data is pulled from the source through a small buffer, so the
+// memory use does not depend on the size of the stream. Reading backwards beyond the window restarts the stream.
+// The window has CHUNK spare bytes for the over-copying of copyLiterals, which may only hit bytes out of reach.
+class Stream
+{
+public:
+	// Reads size bytes at offset of the compressed stream, false if they can not be read
+	using Source = std::function<bool(uint8_t *, const uint64_t &, const std::size_t &)>;
+
+	static constexpr uint64_t WINDOW        = 1 << 24;
+	static constexpr std::size_t SRC_BUFFER = 0x10000;
+
+	// Longest code: key code, code, length byte and three index bytes
+	static constexpr std::size_t MAX_CODE = 6;
+
+public:
+	Stream(const Source &source, const uint64_t &srcCapacity, const uint32_t &minCompress) :
+		m_source(source),
+		m_srcCapacity(srcCapacity),
+		m_minCompress(minCompress),
+		m_buffer(SRC_BUFFER)
+	{
+	}
+
+	// Read the header and start at the beginning of the decoded data, false if the header is invalid
+	bool Reset()
+	{
+		uint8_t head[HEAD_SIZE];
+		uint32_t destSize, srcSize;
+
+		m_failed = true;
+
+		if (m_srcCapacity < HEAD_SIZE || !m_source(head, 0, HEAD_SIZE)) return false;
+
+		std::memcpy(&destSize, head, sizeof(uint32_t));
+		std::memcpy(&srcSize, head + 4, sizeof(uint32_t));
+
+		if (srcSize < HEAD_SIZE || srcSize > m_srcCapacity || destSize > INT32_MAX) return false;
+
+		m_destSize  = destSize;
+		m_srcSize   = srcSize;
+		m_keyCode   = head[8];
+		m_srcOffset = HEAD_SIZE;
+		m_bufPos    = 0;
+		m_bufEnd    = 0;
+		m_written   = 0;
+		m_read      = 0;
+		m_index     = 0;
+
+		// Small streams fit into the window and are never overwritten
+		m_window.resize(static_cast<std::size_t>(std::min<uint64_t>(m_destSize, WINDOW + CHUNK)));
+		m_history = m_window.size() == m_destSize ? m_destSize : WINDOW;
+		m_failed  = false;
+
+		return true;
+	}
+
+	uint64_t Size() const
+	{
+		return m_destSize;
+	}
+
+	uint64_t Tell() const
+	{
+		return m_read;
+	}
+
+	// Move the read position, data still in the window is reused, false if the stream is damaged
+	bool Seek(const uint64_t &position)
+	{
+		if (m_failed || position > m_destSize) return false;
+
+		if (position <= m_written)
+		{
+			if (m_written - position <= m_history)
+			{
+				m_read = position;
+				return true;
+			}
+
+			if (!Reset()) return false;
+		}
+
+		while (m_written < position)
+		{
+			m_read = m_written;
+			if (!fill(position - m_written)) return false;
+		}
+
+		m_read = position;
+
+		return true;
+	}
+
+	// Copy up to size bytes from the read position to pDest, returns the number of bytes or -1 if the stream is damaged
+	int64_t Read(void *pDest, uint64_t size)
+	{
+		uint8_t *dp = static_cast<uint8_t *>(pDest);
+		uint64_t done = 0;
+
+		if (m_failed) return -1;
+
+		size = std::min<uint64_t>(size, m_destSize - m_read);
+
+		while (done < size)
+		{
+			if (m_read == m_written && !fill(size - done)) return -1;
+
+			const std::size_t index = static_cast<std::size_t>(m_read % m_window.size());
+			const std::size_t len   = static_cast<std::size_t>(std::min<uint64_t>({ m_written - m_read, size - done, static_cast<uint64_t>(m_window.size() - index) }));
+
+			std::memcpy(dp + done, m_window.data() + index, len);
+			done += len;
+			m_read += len;
+		}
+
+		return static_cast<int64_t>(done);
+	}
+
+private:
+	// Make at least size bytes available in the buffer, fewer at the end of the stream
+	bool load(const std::size_t &size)
+	{
+		std::size_t avail = m_bufEnd - m_bufPos;
+
+		if (avail >= size || m_srcOffset == m_srcSize) return true;
+
+		std::memmove(m_buffer.data(), m_buffer.data() + m_bufPos, avail);
+
+		const std::size_t len = static_cast<std::size_t>(std::min<uint64_t>(m_buffer.size() - avail, m_srcSize - m_srcOffset));
+		if (!m_source(m_buffer.data() + avail, m_srcOffset, len)) return false;
+
+		m_srcOffset += len;
+		m_bufPos = 0;
+		m_bufEnd = avail + len;
+
+		return true;
+	}
+
+	void advance(const std::size_t &size)
+	{
+		m_written += size;
+		m_index += size;
+		if (m_index >= m_window.size()) m_index -= m_window.size();
+	}
+
+	// Copy a match inside of the window, matches crossing its end are copied byte wise
+	void copyWindowMatch(const uint32_t &offset, const uint32_t &size)
+	{
+		const std::size_t windowSize = m_window.size();
+		std::size_t dest             = m_index;
+
+		if (dest >= offset && dest + size <= windowSize)
+			copyMatchExact(m_window.data() + dest, offset, size);
+		else
+		{
+			std::size_t src = dest >= offset ? dest - offset : dest + windowSize - offset;
+
+			for (uint32_t i = 0; i < size; i++)
+			{
+				m_window[dest] = m_window[src];
+				if (++dest == windowSize) dest = 0;
+				if (++src == windowSize) src = 0;
+			}
+		}
+
+		advance(size);
+	}
+
+	// Decode at least size more bytes, or up to the end, while keeping the unread bytes inside of the window
+	bool fill(const uint64_t &size)
+	{
+		const uint64_t target = m_written + std::min<uint64_t>(size, WINDOW / 2);
+
+		while (m_written < target)
+		{
+			if (!load(MAX_CODE)) return fail();
+
+			const std::size_t avail = m_bufEnd - m_bufPos;
+			const uint8_t *sp       = m_buffer.data() + m_bufPos;
+
+			// The source ended before the output
+			if (avail == 0) return fail();
+
+			if (*sp != m_keyCode)
+			{
+				const std::size_t limit = static_cast<std::size_t>(std::min<uint64_t>({ target - m_written, static_cast<uint64_t>(m_window.size() - m_index), static_cast<uint64_t>(avail) }));
+				uint8_t *dp             = m_window.data() + m_index;
+				const std::size_t len   = copyLiterals(dp, sp, sp + limit, dp + limit, m_keyCode);
+
+				m_bufPos += len;
+				advance(len);
+				continue;
+			}
+
+			if (avail < 2) return fail();
+
+			// Two key codes in a row are an escaped key code
+			if (sp[1] == m_keyCode)
+			{
+				if (m_written == m_destSize) return fail();
+
+				m_window[m_index] = m_keyCode;
+				m_bufPos += 2;
+				advance(1);
+				continue;
+			}
+
+			uint32_t code = sp[1];
+			if (code > m_keyCode) code--;
+
+			const uint32_t indexSize = code & 0x3;
+			const std::size_t needed = 2 + ((code & (0x1 << 2)) ? 1 : 0) + (indexSize == 3 ? 0 : indexSize + 1);
+			if (avail < needed) return fail();
+
+			sp += 2;
+
+			uint32_t conbo = code >> 3;
+			if (code & (0x1 << 2))
+				conbo |= *sp++ << 5;
+			conbo += m_minCompress;
+
+			uint32_t index = 0;
+			switch (indexSize)
+			{
+				case 0:
+					index = sp[0];
+					break;
+
+				case 1:
+					index = sp[0] | (sp[1] << 8);
+					break;
+
+				case 2:
+					index = sp[0] | (sp[1] << 8) | (sp[2] << 16);
+					break;
+			}
+			index++;
+
+			if (index > m_written || conbo > m_destSize - m_written) return fail();
+
+			m_bufPos += needed;
+			copyWindowMatch(index, conbo);
+		}
+
+		// A valid stream ends exactly at both ends
+		if (m_written == m_destSize && (m_bufPos != m_bufEnd || m_srcOffset != m_srcSize)) return fail();
+
+		return true;
+	}
+
+	bool fail()
+	{
+		m_failed = true;
+		return false;
+	}
+
+private:
+	Source m_source;
+	uint64_t m_srcCapacity;
+	uint32_t m_minCompress;
+
+	uint64_t m_destSize  = 0;
+	uint64_t m_srcSize   = 0;
+	uint8_t m_keyCode    = 0;
+	bool m_failed        = true;
+
+	std::vector<uint8_t> m_buffer;
+	uint64_t m_srcOffset = 0; // Offset of the next byte loaded into the buffer
+	std::size_t m_bufPos = 0;
+	std::size_t m_bufEnd = 0;
+
+	std::vector<uint8_t> m_window;
+	uint64_t m_history  = 0; // Decoded bytes which stay intact in the window
+	uint64_t m_written  = 0; // Decoded bytes
+	uint64_t m_read     = 0; // Read position, never more than the window size behind m_written
+	std::size_t m_index = 0; // Window index of the next decoded byte
+};
+} // namespace lzDecode
@@ -0,0 +1,83 @@
+/*
+ *  File: WolfCryptStream.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "KeyConvSimd.h"
+
+// Keystream of wolfCrypt (WolfNew.h) for one key, built once per archive instead of deriving it byte by byte on every read.
+// The keystream byte of a position is key[pos % 256] ^ key[256 + pos / 256 % 256] (v3.5 with a modified key) and for v3.x
+// additionally ^ key[512 + pos / 0x10000 % 256]. The first two parts repeat every 64 KiB and are stored as a table,
+// the v3.x part is constant for each 64 KiB segment.
+class WolfCryptStream
+{
+public:
+	static constexpr uint32_t PERIOD = 0x10000;
+
+public:
+	void Init(const uint8_t *pKey, const bool &v35)
+	{
+		uint8_t key[512];
+
+		for (uint32_t i = 0; i < 512; i++)
+			key[i] = v35 ? static_cast<uint8_t>(pKey[i % 256] ^ (7 * i)) : pKey[i];
+
+		m_stream.resize(PERIOD);
+
+		for (uint32_t i = 0; i < PERIOD; i++)
+			m_stream[i] = key[i % 256] ^ key[256 + i / 256];
+
+		for (uint32_t i = 0; i < 256; i++)
+			m_segmentKey[i] = v35 ? 0 : pKey[512 + i];
+	}
+
+	bool IsValid() const
+	{
+		return !m_stream.empty();
+	}
+
+	// Same as wolfCrypt(pKey, pData, start, end, false, cryptVersion), pData is the data at position start
+	void Apply(uint8_t *pData, const int64_t &start, const int64_t &end) const
+	{
+		for (int64_t pos = start; pos < end;)
+		{
+			const uint32_t offset   = static_cast<uint32_t>(pos % PERIOD);
+			const int64_t chunkSize = std::min<int64_t>(end - pos, PERIOD - offset);
+
+			keyConv::xorStream(pData + (pos - start), m_stream.data() + offset, chunkSize, m_segmentKey[pos / PERIOD % 256]);
+
+			pos += chunkSize;
+		}
+	}
+
+private:
+	std::vector<uint8_t> m_stream = {};
+	uint8_t m_segmentKey[256]     = {};
+};
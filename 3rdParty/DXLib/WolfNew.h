@@ -30,11 +30,16 @@
 #include <array>
 #include <bit>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
 #include <numeric>
 #include <random>
 #include <string>
 #include <vector>
 
+#include "../../UberWolfLib/WolfX/SimdFeatures.hpp"
+
 inline bool isV35(const uint16_t &cryptVersion)
 {
 	return (cryptVersion >= 0x15E && cryptVersion < 0x3E8) || cryptVersion >= 0x3FC;
@@ -102,7 +107,7 @@ inline void calcSalt(const char *pStr, uint8_t *pSalt)
 
 inline uint32_t xorshift32(const uint32_t &seed = 0)
 {
-	static uint32_t state = 0;
+	static thread_local uint32_t state = 0;
 
 	if (seed != 0)
 		state = seed;
@@ -543,7 +548,7 @@ inline void cipher(uint8_t *pState, const uint8_t *pRoundKey)
 }
 
 // AES_CTR_xcrypt
-inline void aesCtrXCrypt(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
+inline void aesCtrXCryptPlain(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
 {
 	uint8_t state[AES_BLOCKLEN];
 	uint8_t *pIv = pKey + AES_KEY_EXP_SIZE;
@@ -574,6 +579,94 @@ inline void aesCtrXCrypt(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
 	}
 }
 
+// Same as aesCtrXCryptPlain using the AES-NI instructions, the cipher itself is standard AES so only the key expansion is kept.
+// The IV is a 128 bit big endian counter, AES_CTR_PIPELINE blocks are encrypted at once to hide the latency of aesenc
+#define AES_CTR_PIPELINE 8
+
+inline void aesCtrXCryptAesNi(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
+{
+	__m128i roundKeys[Nr + 1];
+	for (uint32_t i = 0; i <= Nr; i++)
+		roundKeys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pKey + i * AES_BLOCKLEN));
+
+	uint8_t *pIv = pKey + AES_KEY_EXP_SIZE;
+	uint64_t ivHigh, ivLow;
+	std::memcpy(&ivHigh, pIv, 8);
+	std::memcpy(&ivLow, pIv + 8, 8);
+	ivHigh = _byteswap_uint64(ivHigh);
+	ivLow  = _byteswap_uint64(ivLow);
+
+	const auto nextCounter = [&]() {
+		const __m128i counter = _mm_set_epi64x(static_cast<int64_t>(_byteswap_uint64(ivLow)), static_cast<int64_t>(_byteswap_uint64(ivHigh)));
+
+		ivLow++;
+		if (ivLow == 0) ivHigh++;
+
+		return _mm_xor_si128(counter, roundKeys[0]);
+	};
+
+	std::size_t i = 0;
+
+	for (; i + AES_CTR_PIPELINE * AES_BLOCKLEN <= size; i += AES_CTR_PIPELINE * AES_BLOCKLEN)
+	{
+		__m128i blocks[AES_CTR_PIPELINE];
+
+		for (uint32_t b = 0; b < AES_CTR_PIPELINE; b++)
+			blocks[b] = nextCounter();
+
+		for (uint32_t round = 1; round < Nr; round++)
+		{
+			for (uint32_t b = 0; b < AES_CTR_PIPELINE; b++)
+				blocks[b] = _mm_aesenc_si128(blocks[b], roundKeys[round]);
+		}
+
+		for (uint32_t b = 0; b < AES_CTR_PIPELINE; b++)
+		{
+			__m128i *pBlock = reinterpret_cast<__m128i *>(pData + i + b * AES_BLOCKLEN);
+			_mm_storeu_si128(pBlock, _mm_xor_si128(_mm_loadu_si128(pBlock), _mm_aesenclast_si128(blocks[b], roundKeys[Nr])));
+		}
+	}
+
+	// Remaining blocks, a partial last block still uses up a whole counter value
+	for (; i < size; i += AES_BLOCKLEN)
+	{
+		__m128i block = nextCounter();
+
+		for (uint32_t round = 1; round < Nr; round++)
+			block = _mm_aesenc_si128(block, roundKeys[round]);
+
+		uint8_t keyStream[AES_BLOCKLEN];
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(keyStream), _mm_aesenclast_si128(block, roundKeys[Nr]));
+
+		const std::size_t steps = std::min<std::size_t>(AES_BLOCKLEN, size - i);
+		for (std::size_t j = 0; j < steps; j++)
+			pData[i + j] ^= keyStream[j];
+	}
+
+	ivHigh = _byteswap_uint64(ivHigh);
+	ivLow  = _byteswap_uint64(ivLow);
+	std::memcpy(pIv, &ivHigh, 8);
+	std::memcpy(pIv + 8, &ivLow, 8);
+}
+
+using AesCtrXCryptFunction = void (*)(uint8_t *, uint8_t *, const std::size_t &);
+
+// Both versions are compared by the AES-CTR test of UberWolfTest
+inline AesCtrXCryptFunction selectAesCtrXCrypt(const simd::CpuFeatures &features)
+{
+	if (features.aes && features.sse2)
+		return aesCtrXCryptAesNi;
+
+	return aesCtrXCryptPlain;
+}
+
+// Encrypt / decrypt the data in place, the IV stored behind the round key is advanced by one for every started block
+inline void aesCtrXCrypt(uint8_t *pData, uint8_t *pKey, const std::size_t &size)
+{
+	static const AesCtrXCryptFunction aesCtrXCryptFunc = selectAesCtrXCrypt(simd::detectCpuFeatures());
+	aesCtrXCryptFunc(pData, pKey, size);
+}
+
 ////// AES CTR Crypt
 /////////////////////////////////
 
@@ -40,15 +40,6 @@
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ [[maybe_unused]] HINSTANCE hPrevInstance, _In_ [[maybe_unused]] LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
-	// For the archive extraction a subprocess is created, which will be terminated after the extraction is done.
-	// Therefore, check if the current process is a subprocess and if so, create an instance of UberWolfLib which will
-	// directly call the unpack function and then terminate the process
-	if (IsSubProcess())
-	{
-		[[maybe_unused]] UberWolfLib uwl;
-		return 0;
-	}
-
 	std::wstring title = L"UberWolf v" + selfUpdater::version::GetVersionInfo();
 
 	MainWindow mainWindow(hInstance, title);
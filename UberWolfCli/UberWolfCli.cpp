@@ -25,12 +25,20 @@
  */
 
 #include <CLI11/CLI11.hpp>
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
 #include <filesystem>
 #include <format>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <nlohmann/json.hpp>
 #include <vector>
 #include <windows.h>
 
+#include <BatchRunner.h>
+#include <ExtractFilter.h>
 #include <UberWolfLib.h>
 #include <Utils.h>
 
@@ -56,19 +64,236 @@ std::string buildPackInfo()
 	return info;
 }
 
-int main(int argc, char* argv[])
+std::string toUtf8(const std::wstring& str)
+{
+	return std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(str);
+}
+
+// FILETIME values count 100ns intervals since 1601-01-01
+std::string fileTimeToString(const uint64_t& fileTime)
+{
+	const std::chrono::sys_seconds time{ std::chrono::seconds(static_cast<int64_t>(fileTime / 10000000) - 11644473600) };
+	return std::format("{:%Y-%m-%d %H:%M:%S}", time);
+}
+
+std::string pressSizeToString(const uint64_t& size)
+{
+	return (size == DXArchiveEntry::NOT_PRESSED ? "-" : std::to_string(size));
+}
+
+void printListings(const ArchiveListings& listings)
 {
-	if (IsSubProcess())
+	for (const auto& [path, listing] : listings)
 	{
-		UberWolfLib uwl;
-		return 0;
+		std::cout << std::format("{} (version: {}, crypt version: {}, entries: {})", toUtf8(path), listing.version, listing.cryptVersion, listing.entries.size()) << std::endl;
+		std::cout << std::format("  {:>12} {:>12} {:>12}  {:19}  {}", "Size", "Pressed", "Huffman", "Modified", "Path") << std::endl;
+
+		for (const DXArchiveEntry& entry : listing.entries)
+			std::cout << std::format("  {:>12} {:>12} {:>12}  {:19}  {}{}", entry.dataSize, pressSizeToString(entry.pressDataSize), pressSizeToString(entry.huffPressDataSize), fileTimeToString(entry.lastWrite), toUtf8(entry.path), (entry.directory ? "/" : "")) << std::endl;
+
+		std::cout << std::endl;
+	}
+}
+
+void printListingsJson(const ArchiveListings& listings)
+{
+	nlohmann::ordered_json archives = nlohmann::ordered_json::array();
+
+	for (const auto& [path, listing] : listings)
+	{
+		nlohmann::ordered_json entries = nlohmann::ordered_json::array();
+
+		for (const DXArchiveEntry& entry : listing.entries)
+		{
+			nlohmann::ordered_json e;
+			e["path"]              = toUtf8(entry.path);
+			e["directory"]         = entry.directory;
+			e["attributes"]        = entry.attributes;
+			e["dataSize"]          = entry.dataSize;
+			e["pressDataSize"]     = (entry.pressDataSize == DXArchiveEntry::NOT_PRESSED ? nlohmann::ordered_json() : nlohmann::ordered_json(entry.pressDataSize));
+			e["huffPressDataSize"] = (entry.huffPressDataSize == DXArchiveEntry::NOT_PRESSED ? nlohmann::ordered_json() : nlohmann::ordered_json(entry.huffPressDataSize));
+			e["create"]            = fileTimeToString(entry.create);
+			e["lastAccess"]        = fileTimeToString(entry.lastAccess);
+			e["lastWrite"]         = fileTimeToString(entry.lastWrite);
+			entries.push_back(e);
+		}
+
+		nlohmann::ordered_json archive;
+		archive["archive"]      = toUtf8(path);
+		archive["version"]      = listing.version;
+		archive["cryptVersion"] = listing.cryptVersion;
+		archive["entries"]      = entries;
+		archives.push_back(archive);
+	}
+
+	std::cout << archives.dump(2) << std::endl;
+}
+
+void printVerifyReports(const ArchiveVerifyReports& reports)
+{
+	uint64_t totalSize = 0;
+	double totalTime   = 0.0;
+
+	for (const auto& [path, report] : reports)
+	{
+		std::cout << std::format("{} (entries: {}, failed: {})", toUtf8(path), report.entries.size(), report.GetInvalidCount()) << std::endl;
+		std::cout << std::format("  {:>12} {:>12}  {:8}  {:6}  {}", "Size", "Decoded", "CRC32", "Result", "Path") << std::endl;
+
+		for (const DXArchiveVerifyEntry& entry : report.entries)
+		{
+			std::cout << std::format("  {:>12} {:>12}  {:08x}  {:6}  {}", entry.dataSize, entry.decodedSize, entry.crc, (entry.IsValid() ? "OK" : "FAILED"), toUtf8(entry.path)) << std::endl;
+
+			if (!entry.error.empty())
+				std::cout << std::format("  {:>12} {:>12}  {:8}  {:6}  {}", "", "", "", "", entry.error) << std::endl;
+		}
+
+		if (!report.decoded)
+			std::cout << "  Decoding failed, the entries above were decoded before the error" << std::endl;
+
+		std::cout << std::format("  {} bytes in {:.3f} s ({:.1f} MiB/s), hash: {:08x}", report.GetTotalSize(), report.seconds, report.GetThroughput() / (1024.0 * 1024.0), report.GetHash()) << std::endl;
+		std::cout << std::endl;
+
+		totalSize += report.GetTotalSize();
+		totalTime += report.seconds;
+	}
+
+	std::cout << std::format("Total: {} bytes in {:.3f} s ({:.1f} MiB/s)", totalSize, totalTime, (totalTime > 0.0 ? static_cast<double>(totalSize) / totalTime / (1024.0 * 1024.0) : 0.0)) << std::endl;
+}
+
+void printVerifyReportsJson(const ArchiveVerifyReports& reports)
+{
+	nlohmann::ordered_json archives = nlohmann::ordered_json::array();
+
+	for (const auto& [path, report] : reports)
+	{
+		nlohmann::ordered_json entries = nlohmann::ordered_json::array();
+
+		for (const DXArchiveVerifyEntry& entry : report.entries)
+		{
+			nlohmann::ordered_json e;
+			e["path"]        = toUtf8(entry.path);
+			e["dataSize"]    = entry.dataSize;
+			e["decodedSize"] = entry.decodedSize;
+			e["crc32"]       = std::format("{:08x}", entry.crc);
+			e["valid"]       = entry.IsValid();
+			e["error"]       = entry.error;
+			entries.push_back(e);
+		}
+
+		nlohmann::ordered_json archive;
+		archive["archive"]    = toUtf8(path);
+		archive["decoded"]    = report.decoded;
+		archive["valid"]      = report.IsValid();
+		archive["totalSize"]  = report.GetTotalSize();
+		archive["seconds"]    = report.seconds;
+		archive["throughput"] = report.GetThroughput();
+		archive["hash"]       = std::format("{:08x}", report.GetHash());
+		archive["entries"]    = entries;
+		archives.push_back(archive);
 	}
 
+	std::cout << archives.dump(2) << std::endl;
+}
+
+// A list file contains one game executable per line, empty lines and lines starting with '#' are ignored
+tStrings readBatchList(const tString& listPath)
+{
+	tStrings paths;
+	std::wifstream f(listPath);
+	f.imbue(std::locale(f.getloc(), new std::codecvt_utf8<wchar_t>));
+
+	tString line;
+	while (std::getline(f, line))
+	{
+		while (!line.empty() && iswspace(line.back()))
+			line.pop_back();
+
+		if (!line.empty() && line.front() != TEXT('#'))
+			paths.push_back(line);
+	}
+
+	return paths;
+}
+
+// Everything before the first path segment with a wildcard is the directory to search, the rest is matched
+// the same way as the extraction filters, i.e., "D:/Games/**/Game*.exe" or "D:/Games/*/Game.exe"
+tStrings expandBatchGlob(const tString& glob)
+{
+	tString pattern = glob;
+	std::replace(pattern.begin(), pattern.end(), TEXT('\\'), TEXT('/'));
+
+	const std::size_t wildPos = pattern.find_first_of(TEXT("*?"));
+	if (wildPos == tString::npos)
+		return { glob };
+
+	const std::size_t sepPos = pattern.rfind(TEXT('/'), wildPos);
+	const fs::path baseDir   = (sepPos == tString::npos ? fs::current_path() : fs::path(pattern.substr(0, sepPos + 1)));
+	pattern                  = (sepPos == tString::npos ? pattern : pattern.substr(sepPos + 1));
+
+	// Without ** the pattern can not match deeper than its number of segments
+	const bool anyDepth  = (pattern.find(TEXT("**")) != tString::npos);
+	const int32_t depth  = static_cast<int32_t>(std::count(pattern.begin(), pattern.end(), TEXT('/')));
+	const tString prefix = (pattern.find(TEXT('/')) == tString::npos ? TEXT("./") : TEXT(""));
+
+	// A pattern without a separator would otherwise match the file name in every directory
+	const ExtractFilter filter({ prefix + pattern });
+
+	tStrings paths;
+	std::error_code ec;
+
+	for (auto it = fs::recursive_directory_iterator(baseDir, fs::directory_options::skip_permission_denied, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+	{
+		if (ec) break;
+
+		if (!anyDepth && it.depth() >= depth)
+			it.disable_recursion_pending();
+
+		if (it->is_regular_file(ec) && filter.Matches(prefix + it->path().lexically_relative(baseDir).generic_wstring()))
+			paths.push_back(FS_PATH_TO_TSTRING(it->path()));
+	}
+
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+int runBatch(const tString& source, const std::function<void(UberWolfLib&)>& setup, const uint32_t& jobs, const uint64_t& memBudget)
+{
+	const bool isList    = fs::is_regular_file(source) && fs::path(source).extension() != TEXT(".exe");
+	const tStrings games = (isList ? readBatchList(source) : expandBatchGlob(source));
+
+	if (games.empty())
+	{
+		std::cout << "No games found for the batch." << std::endl;
+		return -1;
+	}
+
+	std::cout << std::format("Processing {} games", games.size()) << std::endl;
+
+	std::size_t failed = 0;
+
+	BatchRunner runner(games, jobs, memBudget);
+	runner.Run(setup, [&](const BatchRunner::Result& result) {
+		if (!result.Success())
+			failed++;
+
+		std::wcout << std::format(L"[{}] {} ({:.0f} ms)", (result.Success() ? L"OK" : L"FAILED"), result.gameExePath, result.totalMs) << std::endl;
+	});
+
+	std::cout << std::format("Done: {} succeeded, {} failed", games.size() - failed, failed) << std::endl;
+
+	return (failed == 0 ? 0 : -1);
+}
+
+int main(int argc, char* argv[])
+{
 	CLI::App app{ UWCLI_NAME + " v" + selfUpdater::version::GetVersionInfo() };
 	argv = app.ensure_utf8(argv);
 
 	tStrings files;
-	app.add_option("FILE[s]", files, "<Game[Pro].exe>\n<data_folder>\n<.wolf-files>")->required();
+	CLI::Option* pFilesOpt = app.add_option("FILE[s]", files, "<Game[Pro].exe>\n<data_folder>\n<.wolf-files>");
+
+	tString batch = TEXT("");
+	app.add_option("-b,--batch", batch, "Process every game of the list file (one Game[Pro].exe per line) or glob, a result is written next to each game as " + WStringToString(BatchRunner::RESULT_FILE_NAME))->type_name("LIST|GLOB")->excludes(pFilesOpt);
 
 	bool override = false;
 	app.add_flag("-o,--override", override, "Override existing files");
@@ -79,11 +304,69 @@ int main(int argc, char* argv[])
 	bool decWolfX = false;
 	app.add_flag("-x,--wolfx", decWolfX, "Decrypt WolfX files if present");
 
+	uint32_t jobs = 0;
+	app.add_option("-j,--jobs", jobs, "Number of threads unpacking archives and the files inside of them (default: one per hardware thread)")->type_name("N");
+
+	uint64_t memBudget = 0;
+	app.add_option("--mem-budget", memBudget, "Limit for the summed size of the archives unpacked at once (default: unlimited)")->type_name("MiB");
+
+	tStrings include;
+	app.add_option("--include", include, "Only unpack, list or verify the entries matching the glob, can be given multiple times")->type_name("GLOB")->allow_extra_args(false);
+
+	tStrings exclude;
+	app.add_option("--exclude", exclude, "Skip the entries matching the glob when unpacking, listing or verifying, can be given multiple times")->type_name("GLOB")->allow_extra_args(false);
+
 	std::string packVersion = "";
 	app.add_option("-p,--pack", packVersion, buildPackInfo())->type_name("VER_IDX");
 
+	bool list = false;
+	CLI::Option* pListOpt = app.add_flag("-l,--list", list, "List the contents of the archives without unpacking them")->excludes("--batch");
+
+	bool verify = false;
+	app.add_flag("--verify", verify, "Decode every file of the archives without writing anything and report their sizes and CRC32")->excludes("--batch")->excludes(pListOpt);
+
+	bool json = false;
+	app.add_flag("--json", json, "Print the listing or the verification report as JSON");
+
 	CLI11_PARSE(app, argc, argv);
 
+	if (json && !list && !verify)
+	{
+		std::cerr << "[ERROR] --json requires --list or --verify" << std::endl;
+		return -1;
+	}
+
+	// The budget is given in MiB, larger values would overflow as bytes
+	static constexpr uint64_t MIB = 1024 * 1024;
+
+	if (memBudget > UINT64_MAX / MIB)
+	{
+		std::cerr << "[ERROR] --mem-budget must not be larger than " << UINT64_MAX / MIB << " MiB" << std::endl;
+		return -1;
+	}
+
+	if (verify && !packVersion.empty())
+	{
+		std::cerr << "[ERROR] Packing can not be used with --verify" << std::endl;
+		return -1;
+	}
+
+	if (!batch.empty())
+	{
+		if (!packVersion.empty())
+		{
+			std::cerr << "[ERROR] Packing can not be used in batch mode" << std::endl;
+			return -1;
+		}
+
+		const auto setup = [&](UberWolfLib& gameUwl) {
+			gameUwl.Configure(override, unprotect, decWolfX);
+			gameUwl.ConfigureFilter(include, exclude);
+		};
+
+		return runBatch(batch, setup, jobs, memBudget * MIB);
+	}
+
 	const tStrings zeroArg = { StringToWString(argv[0]) };
 	UberWolfLib uwl(zeroArg);
 
@@ -94,12 +377,56 @@ int main(int argc, char* argv[])
 	}
 
 	uwl.Configure(override, unprotect, decWolfX);
+	uwl.ConfigureScheduler(jobs, memBudget * MIB);
+	uwl.ConfigureFilter(include, exclude);
+
+	// The archive paths are printed as UTF-8
+	if (list || verify)
+		SetConsoleOutputCP(CP_UTF8);
+
+	const auto printResult = [&](const UWLExitCode& result, const ArchiveListings& listings) {
+		if (json)
+			printListingsJson(listings);
+		else
+			printListings(listings);
+
+		if (result != UWLExitCode::SUCCESS)
+			std::cerr << "Listing failed with exit code: " << static_cast<int>(result) << std::endl;
+
+		return (result == UWLExitCode::SUCCESS ? 0 : -1);
+	};
+
+	const auto printVerifyResult = [&](const UWLExitCode& result, const ArchiveVerifyReports& reports) {
+		if (json)
+			printVerifyReportsJson(reports);
+		else
+			printVerifyReports(reports);
+
+		if (result != UWLExitCode::SUCCESS)
+			std::cerr << "Verification failed with exit code: " << static_cast<int>(result) << std::endl;
+
+		const bool valid = std::all_of(reports.begin(), reports.end(), [](const auto& report) { return report.second.IsValid(); });
+
+		return (result == UWLExitCode::SUCCESS && valid ? 0 : -1);
+	};
 
 	// Check if the first argument is an executable
 	if (fs::exists(files.front()) && fs::is_regular_file(files.front()) && fs::path(files.front()).extension() == ".exe")
 	{
 		uwl.InitGame(files.front());
 
+		if (list)
+		{
+			ArchiveListings listings;
+			return printResult(uwl.ListData(listings), listings);
+		}
+
+		if (verify)
+		{
+			ArchiveVerifyReports reports;
+			return printVerifyResult(uwl.VerifyData(reports), reports);
+		}
+
 		if (packVersion.empty())
 		{
 			uwl.UnpackData();
@@ -170,6 +497,18 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	if (list)
+	{
+		ArchiveListings listings;
+		return printResult(uwl.ListDataVec(paths, listings), listings);
+	}
+
+	if (verify)
+	{
+		ArchiveVerifyReports reports;
+		return printVerifyResult(uwl.VerifyDataVec(paths, reports), reports);
+	}
+
 	uwl.UnpackDataVec(paths);
 
 	return 0;
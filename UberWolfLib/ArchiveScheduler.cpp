@@ -0,0 +1,159 @@
+/*
+ *  File: ArchiveScheduler.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "ArchiveScheduler.h"
+
+#include <algorithm>
+#include <exception>
+#include <numeric>
+
+ArchiveScheduler::ArchiveScheduler(const std::vector<uint64_t>& costs, const uint32_t& jobs, const uint64_t& budget) :
+	m_costs(costs),
+	m_order(costs.size()),
+	m_states(costs.size(), State::PENDING),
+	m_results(costs.size(), false),
+	m_jobs(std::max(jobs, 1u)),
+	m_budget(budget)
+{
+	// Largest jobs first, so a single big archive does not end up running alone at the end
+	std::iota(m_order.begin(), m_order.end(), 0);
+	std::stable_sort(m_order.begin(), m_order.end(), [this](const std::size_t& a, const std::size_t& b) { return m_costs[a] > m_costs[b]; });
+}
+
+ArchiveScheduler::~ArchiveScheduler()
+{
+	Stop();
+}
+
+void ArchiveScheduler::Start(const WorkFunc& work)
+{
+	m_work = work;
+
+	const std::size_t threadCnt = std::min<std::size_t>(m_jobs, m_costs.size());
+	for (std::size_t i = 0; i < threadCnt; i++)
+		m_workers.emplace_back(&ArchiveScheduler::workerLoop, this);
+}
+
+void ArchiveScheduler::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+
+		for (State& state : m_states)
+		{
+			if (state == State::PENDING)
+				state = State::SKIPPED;
+		}
+	}
+
+	m_cv.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+
+	m_workers.clear();
+}
+
+bool ArchiveScheduler::WaitFor(const std::size_t& idx, bool& result)
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_cv.wait(lock, [&] { return m_states[idx] == State::DONE || m_states[idx] == State::SKIPPED; });
+
+	result = m_results[idx];
+	return m_states[idx] == State::DONE;
+}
+
+uint32_t ArchiveScheduler::DefaultJobCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ArchiveScheduler::workerLoop()
+{
+	std::size_t idx;
+
+	while (nextJob(idx))
+	{
+		bool result = false;
+
+		try
+		{
+			result = m_work(idx);
+		}
+		catch (const std::exception&)
+		{
+			result = false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_states[idx]  = State::DONE;
+			m_results[idx] = result;
+			m_inFlight -= m_costs[idx];
+			m_running--;
+		}
+
+		m_cv.notify_all();
+	}
+}
+
+bool ArchiveScheduler::nextJob(std::size_t& idx)
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+
+	while (true)
+	{
+		if (m_stop)
+			return false;
+
+		bool pending = false;
+
+		for (const std::size_t& i : m_order)
+		{
+			if (m_states[i] != State::PENDING) continue;
+			pending = true;
+
+			if (m_budget == 0 || m_running == 0 || m_inFlight + m_costs[i] <= m_budget)
+			{
+				idx         = i;
+				m_states[i] = State::RUNNING;
+				m_inFlight += m_costs[i];
+				m_running++;
+				return true;
+			}
+		}
+
+		if (!pending)
+			return false;
+
+		// Everything left is too large for the remaining budget, wait for a running job to finish
+		m_cv.wait(lock);
+	}
+}
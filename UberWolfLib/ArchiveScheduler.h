@@ -0,0 +1,87 @@
+/*
+ *  File: ArchiveScheduler.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a set of jobs on a fixed number of worker threads.
+// The most expensive pending job is started first, as long as the sum of the costs of the running
+// jobs stays within the budget (a job is always started if nothing else is running).
+// Results are collected per job so the caller can consume them in the original order.
+class ArchiveScheduler
+{
+public:
+	using WorkFunc = std::function<bool(const std::size_t&)>;
+
+	ArchiveScheduler(const std::vector<uint64_t>& costs, const uint32_t& jobs, const uint64_t& budget = 0);
+	~ArchiveScheduler();
+
+	ArchiveScheduler(const ArchiveScheduler&)            = delete;
+	ArchiveScheduler& operator=(const ArchiveScheduler&) = delete;
+
+	void Start(const WorkFunc& work);
+
+	// Stops starting new jobs and waits for the running ones to finish
+	void Stop();
+
+	// Blocks until the job finished, returns false if the job was never started because of Stop()
+	bool WaitFor(const std::size_t& idx, bool& result);
+
+	static uint32_t DefaultJobCount();
+
+private:
+	enum class State
+	{
+		PENDING,
+		RUNNING,
+		DONE,
+		SKIPPED
+	};
+
+	void workerLoop();
+	bool nextJob(std::size_t& idx);
+
+private:
+	std::vector<uint64_t> m_costs;
+	std::vector<std::size_t> m_order;
+	std::vector<State> m_states;
+	std::vector<bool> m_results;
+	std::vector<std::thread> m_workers = {};
+	WorkFunc m_work                    = nullptr;
+	uint32_t m_jobs                    = 1;
+	uint64_t m_budget                  = 0;
+	uint64_t m_inFlight                = 0;
+	std::size_t m_running              = 0;
+	bool m_stop                        = false;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+};
@@ -0,0 +1,214 @@
+/*
+ *  File: BatchRunner.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "BatchRunner.h"
+#include "ArchiveScheduler.h"
+#include "UberLog.h"
+#include "Utils.h"
+#include "WolfDec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <locale>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(const Clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::string toUtf8(const tString& str)
+{
+	return std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(str);
+}
+
+BatchRunner::BatchRunner(const tStrings& gameExePaths, const uint32_t& jobs, const uint64_t& memBudget) :
+	m_gameExePaths(gameExePaths),
+	m_jobs(jobs == 0 ? ArchiveScheduler::DefaultJobCount() : jobs),
+	m_memBudget(memBudget)
+{
+}
+
+BatchRunner::Results BatchRunner::Run(const SetupFunc& setup, const ResultFunc& onResult)
+{
+	Results results(m_gameExePaths.size());
+	std::vector<uint64_t> costs;
+
+	for (const tString& p : m_gameExePaths)
+		costs.push_back(gameCost(p));
+
+	ArchiveScheduler scheduler(costs, m_jobs, m_memBudget);
+
+	// The config is loaded once, every game starts with a copy of its modes
+	const WolfDec wolfDec;
+
+	m_gamesLeft = m_gameExePaths.size();
+
+	scheduler.Start([&](const std::size_t& idx) {
+		results[idx] = processGame(m_gameExePaths[idx], setup, wolfDec);
+		m_gamesLeft--;
+
+		writeResult(results[idx]);
+		return results[idx].Success();
+	});
+
+	for (std::size_t idx = 0; idx < m_gameExePaths.size(); idx++)
+	{
+		bool success = false;
+
+		// processGame catches everything, a job without a result can only be caused by a failed allocation
+		if (!scheduler.WaitFor(idx, success) || results[idx].gameExePath.empty())
+		{
+			results[idx].gameExePath = m_gameExePaths[idx];
+			results[idx].error       = "Processing was aborted";
+		}
+
+		if (onResult)
+			onResult(results[idx]);
+	}
+
+	return results;
+}
+
+BatchRunner::Result BatchRunner::processGame(const tString& gameExePath, const SetupFunc& setup, const WolfDec& wolfDec)
+{
+	Result result;
+	result.gameExePath = gameExePath;
+
+	const Clock::time_point start = Clock::now();
+
+	try
+	{
+		UberWolfLib uwl(wolfDec);
+
+		if (setup)
+			setup(uwl);
+
+		// Running the archives of each game in parallel as well would oversubscribe the pool, until games finish and leave threads idle
+		uwl.ConfigureScheduler([this]() { return threadShare(); });
+
+		Clock::time_point stepStart = Clock::now();
+		const bool valid            = uwl.InitGame(gameExePath);
+		result.initMs               = elapsedMs(stepStart);
+
+		if (valid)
+		{
+			stepStart           = Clock::now();
+			result.unpackResult = uwl.UnpackData();
+			result.unpackMs     = elapsedMs(stepStart);
+
+			stepStart            = Clock::now();
+			result.protKeyResult = uwl.FindProtectionKey(result.protKey);
+			result.protKeyMs     = elapsedMs(stepStart);
+
+			const CryptMode* pMode = uwl.GetCryptMode();
+			if (pMode != nullptr)
+			{
+				result.mode = pMode->name;
+				result.key  = Key(pMode->key.begin(), pMode->key.end());
+
+				// Same format as the config file, which adds the terminating 0x00 itself
+				if (!result.key.empty() && result.key.back() == 0x00)
+					result.key.pop_back();
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		result.error = e.what();
+	}
+
+	result.totalMs = elapsedMs(start);
+
+	return result;
+}
+
+// The threads of the pool split between the games which are not finished yet
+uint32_t BatchRunner::threadShare() const
+{
+	const std::size_t gamesLeft = std::max<std::size_t>(m_gamesLeft, 1);
+	return static_cast<uint32_t>(m_jobs / std::min<std::size_t>(m_jobs, gamesLeft));
+}
+
+void BatchRunner::writeResult(const Result& result)
+{
+	nlohmann::ordered_json json;
+	json["game"]          = toUtf8(result.gameExePath);
+	json["success"]       = result.Success();
+	json["unpackResult"]  = static_cast<int32_t>(result.unpackResult);
+	json["mode"]          = result.mode;
+	json["key"]           = nlohmann::ordered_json::array();
+	json["protKeyResult"] = static_cast<int32_t>(result.protKeyResult);
+	json["protKey"]       = result.protKey;
+	json["error"]         = result.error;
+	json["timings"]       = { { "initMs", result.initMs }, { "unpackMs", result.unpackMs }, { "protKeyMs", result.protKeyMs }, { "totalMs", result.totalMs } };
+
+	for (const uint8_t& byte : result.key)
+		json["key"].push_back("0x" + ByteToHexString(byte));
+
+	const tString resultPath = FS_PATH_TO_TSTRING((fs::path(result.gameExePath).parent_path() / RESULT_FILE_NAME));
+
+	std::ofstream f(resultPath);
+	if (!f.is_open())
+	{
+		ERROR_LOG << std::format(TEXT("BatchRunner: Failed to write {}"), resultPath) << std::endl;
+		return;
+	}
+
+	f << json.dump(4);
+}
+
+// The summed size of the files next to the executable and in the data folder, only used to schedule the largest games first
+uint64_t BatchRunner::gameCost(const tString& gameExePath)
+{
+	uint64_t cost      = 0;
+	const fs::path dir = fs::path(gameExePath).parent_path();
+
+	for (const fs::path& p : { dir, dir / TEXT("Data") })
+	{
+		std::error_code ec;
+
+		for (const auto& entry : fs::directory_iterator(p, ec))
+		{
+			if (!entry.is_regular_file(ec))
+				continue;
+
+			const uintmax_t size = entry.file_size(ec);
+			if (!ec)
+				cost += size;
+		}
+	}
+
+	return cost;
+}
@@ -0,0 +1,91 @@
+/*
+ *  File: BatchRunner.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Types.h"
+#include "UberWolfLib.h"
+
+// Processes many games on one shared pool of worker threads, one game per job.
+// While there are at least as many games left as threads, each game unpacks its archives on one thread.
+// Towards the end of the batch the games still running take over the threads of the finished ones for
+// their next archives. A failing game is recorded in its result and the batch continues.
+// Every result is also written next to the game executable as RESULT_FILE_NAME.
+class BatchRunner
+{
+public:
+	inline static const tString RESULT_FILE_NAME = TEXT("UberWolfResult.json");
+
+	struct Result
+	{
+		tString gameExePath       = TEXT("");
+		UWLExitCode unpackResult  = UWLExitCode::NOT_INITIALIZED;
+		UWLExitCode protKeyResult = UWLExitCode::NOT_INITIALIZED;
+		std::string mode          = ""; // Name of the crypt mode which decoded the archives
+		Key key                   = {}; // Key of the crypt mode
+		std::string protKey       = ""; // Protection key of Pro games
+		std::string error         = ""; // Message of an exception thrown while processing the game
+		double initMs             = 0.0;
+		double unpackMs           = 0.0;
+		double protKeyMs          = 0.0;
+		double totalMs            = 0.0;
+
+		bool Success() const
+		{
+			return error.empty() && unpackResult == UWLExitCode::SUCCESS;
+		}
+	};
+
+	using Results = std::vector<Result>;
+
+	// Called for the UberWolfLib instance of every game before it is initialized, e.g., to apply the options
+	using SetupFunc = std::function<void(UberWolfLib&)>;
+	// Called from the calling thread for every finished game in the order of the paths
+	using ResultFunc = std::function<void(const Result&)>;
+
+public:
+	BatchRunner(const tStrings& gameExePaths, const uint32_t& jobs = 0, const uint64_t& memBudget = 0);
+
+	Results Run(const SetupFunc& setup = nullptr, const ResultFunc& onResult = nullptr);
+
+private:
+	Result processGame(const tString& gameExePath, const SetupFunc& setup, const WolfDec& wolfDec);
+	uint32_t threadShare() const;
+	static void writeResult(const Result& result);
+	static uint64_t gameCost(const tString& gameExePath);
+
+private:
+	tStrings m_gameExePaths;
+	uint32_t m_jobs;
+	uint64_t m_memBudget;
+	std::atomic<std::size_t> m_gamesLeft = 0; // Games which are pending or running
+};
@@ -0,0 +1,160 @@
+/*
+ *  File: ExtractFilter.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "ExtractFilter.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <filesystem>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+static bool globMatch(std::basic_string_view<TCHAR> pattern, std::basic_string_view<TCHAR> path)
+{
+	while (!pattern.empty())
+	{
+		if (pattern.starts_with(TEXT("**")))
+		{
+			pattern.remove_prefix(2);
+
+			// "**/" also matches no directory at all
+			if (pattern.starts_with(TEXT('/')) && globMatch(pattern.substr(1), path))
+				return true;
+
+			for (std::size_t i = 0; i <= path.size(); i++)
+			{
+				if (globMatch(pattern, path.substr(i)))
+					return true;
+			}
+
+			return false;
+		}
+
+		if (pattern.front() == TEXT('*'))
+		{
+			pattern.remove_prefix(1);
+
+			// A single '*' never crosses a directory separator
+			for (std::size_t i = 0; i <= path.size(); i++)
+			{
+				if (globMatch(pattern, path.substr(i)))
+					return true;
+
+				if (i < path.size() && path[i] == TEXT('/'))
+					break;
+			}
+
+			return false;
+		}
+
+		if (path.empty())
+			return false;
+
+		if (pattern.front() == TEXT('?'))
+		{
+			if (path.front() == TEXT('/'))
+				return false;
+		}
+		else if (std::towlower(pattern.front()) != std::towlower(path.front()))
+			return false;
+
+		pattern.remove_prefix(1);
+		path.remove_prefix(1);
+	}
+
+	return path.empty();
+}
+
+ExtractFilter::Observer::Observer(const ExtractFilter& filter, const tString& outDir, DXArchiveObserver* pNext) :
+	m_filter(filter),
+	m_outDir(outDir),
+	m_pNext(pNext)
+{
+}
+
+bool ExtractFilter::Observer::ShouldExtract(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite)
+{
+	const tString relPath = fs::path(filePath).lexically_relative(m_outDir).generic_wstring();
+
+	if (!m_filter.Matches(relPath))
+		return false;
+
+	m_matched++;
+
+	return (m_pNext == nullptr || m_pNext->ShouldExtract(filePath, size, lastWrite));
+}
+
+void ExtractFilter::Observer::OnExtracted(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite)
+{
+	if (m_pNext != nullptr)
+		m_pNext->OnExtracted(filePath, size, lastWrite);
+}
+
+ExtractFilter::ExtractFilter(const tStrings& include, const tStrings& exclude)
+{
+	for (const tString& pattern : include)
+		m_include.push_back(normalize(pattern));
+
+	for (const tString& pattern : exclude)
+		m_exclude.push_back(normalize(pattern));
+}
+
+bool ExtractFilter::Matches(const tString& path) const
+{
+	if (matchesAny(m_exclude, path))
+		return false;
+
+	return (m_include.empty() || matchesAny(m_include, path));
+}
+
+tString ExtractFilter::normalize(const tString& pattern)
+{
+	tString result = pattern;
+	std::replace(result.begin(), result.end(), TEXT('\\'), TEXT('/'));
+
+	// The paths never start with a separator
+	while (!result.empty() && result.front() == TEXT('/'))
+		result.erase(result.begin());
+
+	return result;
+}
+
+bool ExtractFilter::matchesAny(const tStrings& patterns, const tString& path)
+{
+	const std::size_t sepPos = path.rfind(TEXT('/'));
+	const tString fileName   = (sepPos == tString::npos ? path : path.substr(sepPos + 1));
+
+	for (const tString& pattern : patterns)
+	{
+		const bool nameOnly = (pattern.find(TEXT('/')) == tString::npos);
+
+		if (globMatch(pattern, nameOnly ? fileName : path))
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,82 @@
+/*
+ *  File: ExtractFilter.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <DXLib/ArchiveObserver.h>
+
+#include <string>
+
+#include "Types.h"
+
+// Include and exclude glob lists selecting the entries extracted from an archive.
+// Patterns are matched case insensitive against the path relative to the archive root with '/' as separator:
+// '?' matches one character, '*' any characters inside of one path segment and '**' any number of segments.
+// Patterns without a '/' only match the file name, so "*.dat" selects the .dat files of all directories.
+class ExtractFilter
+{
+public:
+	// Passes only the entries matching the filter on to the next observer (if any)
+	class Observer : public DXArchiveObserver
+	{
+	public:
+		Observer(const ExtractFilter& filter, const tString& outDir, DXArchiveObserver* pNext = nullptr);
+
+		bool ShouldExtract(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite) override;
+		void OnExtracted(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite) override;
+
+		uint32_t GetMatched() const
+		{
+			return m_matched;
+		}
+
+	private:
+		const ExtractFilter& m_filter;
+		tString m_outDir;
+		DXArchiveObserver* m_pNext;
+		uint32_t m_matched = 0;
+	};
+
+public:
+	ExtractFilter(const tStrings& include = {}, const tStrings& exclude = {});
+
+	// An empty filter selects every entry
+	bool IsEmpty() const
+	{
+		return m_include.empty() && m_exclude.empty();
+	}
+
+	// Excludes take precedence over includes, without includes every entry not excluded matches
+	bool Matches(const tString& path) const;
+
+private:
+	static tString normalize(const tString& pattern);
+	static bool matchesAny(const tStrings& patterns, const tString& path);
+
+private:
+	tStrings m_include;
+	tStrings m_exclude;
+};
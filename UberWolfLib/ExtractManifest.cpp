@@ -0,0 +1,341 @@
+/*
+ *  File: ExtractManifest.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "ExtractManifest.h"
+
+#include <DXLib/Crc32.h>
+
+#include <nlohmann/json.hpp>
+
+#include <codecvt>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <locale>
+#include <vector>
+
+#include "UberLog.h"
+#include "Utils.h"
+
+namespace fs = std::filesystem;
+
+// Interval in which the manifest is written during an extraction, on a crash at most the entries of this interval are extracted again
+static constexpr std::chrono::seconds SAVE_INTERVAL = std::chrono::seconds(2);
+
+ExtractManifest::ExtractManifest(const tString& archivePath, const tString& outDir, const std::string& fingerprint) :
+	m_manifestPath(PathFor(archivePath)),
+	m_outDir(outDir),
+	m_fingerprint(fingerprint),
+	m_lastSave(std::chrono::steady_clock::now())
+{
+	// The entries of a manifest written for a different archive describe other data, even if the paths match
+	Data data;
+	if (read(m_manifestPath, data) && !data.fingerprint.empty() && data.fingerprint == m_fingerprint)
+		m_prevEntries = data.entries;
+}
+
+ExtractManifest::Sink::Sink(ExtractManifest& manifest, DXArchiveSink& next) :
+	m_manifest(manifest),
+	m_next(next)
+{
+}
+
+void ExtractManifest::Sink::MakeDirectory(const std::wstring& dirPath)
+{
+	m_next.MakeDirectory(dirPath);
+}
+
+DXArchiveSink::FileHandle ExtractManifest::Sink::OpenFile(const std::wstring& filePath, const uint64_t& size)
+{
+	FileHandle hNext = m_next.OpenFile(filePath, size);
+	if (hNext == NULL) return NULL;
+
+	return new File{ hNext, filePath, 0 };
+}
+
+bool ExtractManifest::Sink::WriteFile(FileHandle hFile, const void* pData, const uint64_t& size)
+{
+	if (hFile == NULL) return false;
+
+	File* pFile = static_cast<File*>(hFile);
+	pFile->crc  = crc32::update(pFile->crc, pData, static_cast<std::size_t>(size));
+	return m_next.WriteFile(pFile->hNext, pData, size);
+}
+
+bool ExtractManifest::Sink::CloseFile(FileHandle hFile, const uint64_t& create, const uint64_t& lastAccess, const uint64_t& lastWrite, const uint64_t& attributes)
+{
+	if (hFile == NULL) return false;
+
+	File* pFile       = static_cast<File*>(hFile);
+	const bool closed = m_next.CloseFile(pFile->hNext, create, lastAccess, lastWrite, attributes);
+
+	if (closed)
+	{
+		std::lock_guard<std::mutex> lock(m_manifest.m_crcMutex);
+		m_manifest.m_crcs[pFile->path] = pFile->crc;
+	}
+
+	delete pFile;
+	return closed;
+}
+
+bool ExtractManifest::Sink::FailFile(FileHandle hFile, const std::wstring& filePath, const uint64_t& size, const char* error)
+{
+	// No CRC32 is stored, the observer is not told about a failed file
+	File* pFile         = static_cast<File*>(hFile);
+	const bool recorded = m_next.FailFile((pFile == NULL ? NULL : pFile->hNext), filePath, size, error);
+
+	delete pFile;
+	return recorded;
+}
+
+bool ExtractManifest::Sink::RemoveUnpackProtection() const
+{
+	return m_next.RemoveUnpackProtection();
+}
+
+tString ExtractManifest::PathFor(const tString& archivePath)
+{
+	return archivePath + FILE_SUFFIX;
+}
+
+bool ExtractManifest::Exists(const tString& archivePath)
+{
+	return fs::exists(PathFor(archivePath));
+}
+
+void ExtractManifest::Remove(const tString& archivePath)
+{
+	std::error_code ec;
+	fs::remove(PathFor(archivePath), ec);
+}
+
+bool ExtractManifest::IsComplete(const tString& archivePath, const tString& outDir, const std::string& fingerprint)
+{
+	Data data;
+	if (!read(PathFor(archivePath), data))
+		return false;
+
+	if (!data.complete || data.fingerprint.empty() || data.fingerprint != fingerprint)
+		return false;
+
+	// Files removed or modified after the extraction are extracted again
+	for (const auto& [relPath, entry] : data.entries)
+	{
+		const fs::path filePath = fs::path(outDir) / std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(relPath);
+		if (!isOnDisk(filePath.wstring(), entry))
+			return false;
+	}
+
+	return true;
+}
+
+bool ExtractManifest::ShouldExtract(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite)
+{
+	const std::string relPath = relativePath(filePath);
+	const auto it             = m_prevEntries.find(relPath);
+
+	if (it != m_prevEntries.end() && it->second.size == size && it->second.lastWrite == lastWrite && isOnDisk(filePath, it->second) && crcMatches(filePath, it->second))
+	{
+		m_entries[relPath] = it->second;
+		m_skipped++;
+		return false;
+	}
+
+	// Mark the manifest as incomplete before the first file is touched
+	if (!m_started)
+	{
+		m_started = true;
+		save(false);
+	}
+
+	return true;
+}
+
+void ExtractManifest::OnExtracted(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite)
+{
+	Entry entry;
+	entry.size      = size;
+	entry.lastWrite = lastWrite;
+
+	// The CRC32 was computed by the sink from the written data, so the file is not read back
+	{
+		std::lock_guard<std::mutex> lock(m_crcMutex);
+		const auto it = m_crcs.find(filePath);
+
+		if (it != m_crcs.end())
+		{
+			entry.crc32 = it->second;
+			m_crcs.erase(it);
+		}
+	}
+
+	std::error_code ec;
+	const uintmax_t fileSize = fs::file_size(filePath, ec);
+
+	if (!ec)
+	{
+		const fs::file_time_type fileTime = fs::last_write_time(filePath, ec);
+
+		entry.fileSize = static_cast<uint64_t>(fileSize);
+		entry.fileTime = (ec ? 0 : static_cast<int64_t>(fileTime.time_since_epoch().count()));
+	}
+
+	m_entries[relativePath(filePath)] = entry;
+	m_extracted++;
+
+	if (std::chrono::steady_clock::now() - m_lastSave >= SAVE_INTERVAL)
+		save(false);
+}
+
+void ExtractManifest::Finish()
+{
+	save(true);
+}
+
+void ExtractManifest::Flush()
+{
+	// Nothing was extracted, a complete manifest stays complete
+	if (m_started)
+		save(false);
+}
+
+bool ExtractManifest::read(const tString& manifestPath, Data& data)
+{
+	if (!fs::exists(manifestPath))
+		return false;
+
+	try
+	{
+		std::ifstream f(manifestPath);
+		const nlohmann::json json = nlohmann::json::parse(f);
+
+		data.fingerprint = json.value("fingerprint", "");
+		data.complete    = json.value("complete", false);
+
+		if (json.contains("entries") && json["entries"].is_object())
+		{
+			for (const auto& [relPath, value] : json["entries"].items())
+			{
+				Entry entry;
+				entry.size      = value.value("size", 0ULL);
+				entry.lastWrite = value.value("lastWrite", 0ULL);
+				entry.fileSize  = value.value("fileSize", 0ULL);
+				entry.fileTime  = value.value("fileTime", 0LL);
+				entry.crc32     = value.value("crc32", 0U);
+
+				data.entries[relPath] = entry;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// A broken manifest only costs a full extraction
+		ERROR_LOG << std::format(TEXT("Failed to read {}: {}"), manifestPath, StringToWString(e.what())) << std::endl;
+		data = Data();
+		return false;
+	}
+
+	return true;
+}
+
+bool ExtractManifest::isOnDisk(const std::wstring& filePath, const Entry& entry)
+{
+	std::error_code ec;
+	const uintmax_t fileSize = fs::file_size(filePath, ec);
+	if (ec || fileSize != entry.fileSize)
+		return false;
+
+	// The size alone misses files edited in place, manifests of older versions without a time are extracted again once
+	const fs::file_time_type fileTime = fs::last_write_time(filePath, ec);
+
+	return !ec && static_cast<int64_t>(fileTime.time_since_epoch().count()) == entry.fileTime;
+}
+
+bool ExtractManifest::crcMatches(const std::wstring& filePath, const Entry& entry)
+{
+	// Only done for the entries which are skipped, catches files changed in place without a new size or time
+	std::ifstream f(filePath, std::ios::binary);
+	if (!f) return false;
+
+	std::vector<char> buffer(1024 * 1024);
+	uint32_t crc = 0;
+
+	while (f)
+	{
+		f.read(buffer.data(), buffer.size());
+		crc = crc32::update(crc, buffer.data(), static_cast<std::size_t>(f.gcount()));
+	}
+
+	return !f.bad() && crc == entry.crc32;
+}
+
+std::string ExtractManifest::relativePath(const std::wstring& filePath) const
+{
+	const std::wstring relPath = fs::path(filePath).lexically_relative(m_outDir).generic_wstring();
+	return std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(relPath);
+}
+
+void ExtractManifest::save(const bool& complete)
+{
+	nlohmann::ordered_json json;
+	json["fingerprint"] = m_fingerprint;
+	json["complete"]    = complete;
+	json["entries"]     = nlohmann::ordered_json::object();
+
+	for (const auto& [relPath, entry] : m_entries)
+		json["entries"][relPath] = { { "size", entry.size }, { "lastWrite", entry.lastWrite }, { "fileSize", entry.fileSize }, { "fileTime", entry.fileTime }, { "crc32", entry.crc32 } };
+
+	// Until the extraction is complete keep the entries of the previous run which were not processed yet,
+	// a file that was only partially rewritten no longer matches the recorded size and is extracted again
+	if (!complete)
+	{
+		for (const auto& [relPath, entry] : m_prevEntries)
+		{
+			if (!m_entries.contains(relPath))
+				json["entries"][relPath] = { { "size", entry.size }, { "lastWrite", entry.lastWrite }, { "fileSize", entry.fileSize }, { "fileTime", entry.fileTime }, { "crc32", entry.crc32 } };
+		}
+	}
+
+	// Replace the manifest in one step, so a crash never leaves a partially written file behind
+	const tString tempPath = m_manifestPath + TEXT(".tmp");
+
+	{
+		std::ofstream f(tempPath);
+		f << json.dump(4);
+	}
+
+	std::error_code ec;
+	fs::rename(tempPath, m_manifestPath, ec);
+
+	if (ec)
+	{
+		ERROR_LOG << std::format(TEXT("Failed to write {}: {}"), m_manifestPath, StringToWString(ec.message())) << std::endl;
+		fs::remove(tempPath, ec);
+	}
+
+	m_lastSave = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,145 @@
+/*
+ *  File: ExtractManifest.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <DXLib/ArchiveObserver.h>
+#include <DXLib/ArchiveSink.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Types.h"
+
+// Record of an extracted archive, stored next to the archive as <archive>.manifest.json.
+// Holds the fingerprint of the archive and for every extracted entry the values of its file head
+// together with the size, last write time and CRC32 of the written file. Passed to DecodeArchive it skips entries
+// that are unchanged and still on disk, and is written periodically so an interrupted extraction resumes.
+class ExtractManifest : public DXArchiveObserver
+{
+public:
+	inline static const tString FILE_SUFFIX = TEXT(".manifest.json");
+
+	struct Entry
+	{
+		uint64_t size      = 0; // DataSize of the file head
+		uint64_t lastWrite = 0; // Time.LastWrite of the file head
+		uint64_t fileSize  = 0; // Size on disk, differs from size if the unpack protection was removed
+		int64_t fileTime   = 0; // Last write time on disk (file_time_type ticks), a file edited after the extraction no longer matches
+		uint32_t crc32     = 0; // CRC32 of the written data, computed while the file is written
+	};
+
+	// Passes the decoded files on to the next sink and hands the CRC32 of their data to the manifest
+	class Sink : public DXArchiveSink
+	{
+	public:
+		Sink(ExtractManifest& manifest, DXArchiveSink& next);
+
+		void MakeDirectory(const std::wstring& dirPath) override;
+		FileHandle OpenFile(const std::wstring& filePath, const uint64_t& size) override;
+		bool WriteFile(FileHandle hFile, const void* pData, const uint64_t& size) override;
+		bool CloseFile(FileHandle hFile, const uint64_t& create, const uint64_t& lastAccess, const uint64_t& lastWrite, const uint64_t& attributes) override;
+		bool FailFile(FileHandle hFile, const std::wstring& filePath, const uint64_t& size, const char* error) override;
+		bool RemoveUnpackProtection() const override;
+
+	private:
+		struct File
+		{
+			FileHandle hNext  = NULL;
+			std::wstring path = L"";
+			uint32_t crc      = 0;
+		};
+
+	private:
+		ExtractManifest& m_manifest;
+		DXArchiveSink& m_next;
+	};
+
+public:
+	// fingerprint is KeyCache::Fingerprint of the archive, computed once by the caller
+	ExtractManifest(const tString& archivePath, const tString& outDir, const std::string& fingerprint);
+
+	static tString PathFor(const tString& archivePath);
+	static bool Exists(const tString& archivePath);
+	static void Remove(const tString& archivePath);
+
+	// The archive is unchanged since it was completely extracted and all files are still present
+	static bool IsComplete(const tString& archivePath, const tString& outDir, const std::string& fingerprint);
+
+	bool ShouldExtract(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite) override;
+	void OnExtracted(const std::wstring& filePath, const uint64_t& size, const uint64_t& lastWrite) override;
+
+	// Mark the extraction as complete, entries which are no longer part of the archive are dropped
+	void Finish();
+
+	// Write the entries extracted so far without marking the extraction complete, used after a filtered extraction
+	void Flush();
+
+	uint32_t GetSkipped() const
+	{
+		return m_skipped;
+	}
+
+	uint32_t GetExtracted() const
+	{
+		return m_extracted;
+	}
+
+private:
+	using Entries = std::map<std::string, Entry>; // Key is the path relative to the output directory, UTF-8 with '/' as separator
+
+	struct Data
+	{
+		std::string fingerprint = "";
+		bool complete           = false;
+		Entries entries         = {};
+	};
+
+	static bool read(const tString& manifestPath, Data& data);
+	static bool isOnDisk(const std::wstring& filePath, const Entry& entry);
+	static bool crcMatches(const std::wstring& filePath, const Entry& entry);
+
+	std::string relativePath(const std::wstring& filePath) const;
+	void save(const bool& complete);
+
+private:
+	tString m_manifestPath;
+	tString m_outDir;
+	std::string m_fingerprint;
+	Entries m_prevEntries;
+	Entries m_entries    = {};
+	bool m_started       = false;
+	uint32_t m_skipped   = 0;
+	uint32_t m_extracted = 0;
+	std::chrono::steady_clock::time_point m_lastSave;
+
+	// CRC32 of the files closed by the sink until OnExtracted picks them up, the sink is called by all decode workers
+	std::map<std::wstring, uint32_t> m_crcs = {};
+	std::mutex m_crcMutex;
+};
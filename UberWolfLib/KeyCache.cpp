@@ -0,0 +1,249 @@
+/*
+ *  File: KeyCache.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "KeyCache.h"
+
+#include <DXLib/DXArchive.h>
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <windows.h>
+
+#include "UberLog.h"
+#include "Utils.h"
+
+namespace fs = std::filesystem;
+
+static constexpr std::size_t HASH_BYTES = 4096;
+
+static const std::string LOCK_FILE_NAME = KeyCache::CACHE_FILE_NAME + ".lock";
+
+// Replacing the cache fails while a process which does not use the lock (e.g. an older version or a virus scanner) has it open
+static constexpr uint32_t REPLACE_RETRIES   = 50;
+static constexpr DWORD REPLACE_RETRY_WAIT_MS = 20;
+
+// System wide lock of the cache file, readers share it, so the cache is never replaced while it is open for reading
+class CacheFileLock
+{
+public:
+	explicit CacheFileLock(const bool& exclusive)
+	{
+		m_hLock = CreateFileA(LOCK_FILE_NAME.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_hLock == INVALID_HANDLE_VALUE)
+		{
+			ERROR_LOG << std::format(TEXT("KeyCache: Failed to open the lock file: {}"), GetLastError()) << std::endl;
+			return;
+		}
+
+		if (!LockFileEx(m_hLock, (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0), 0, MAXDWORD, MAXDWORD, &m_ov))
+		{
+			ERROR_LOG << std::format(TEXT("KeyCache: Failed to lock the cache: {}"), GetLastError()) << std::endl;
+			CloseHandle(m_hLock);
+			m_hLock = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	~CacheFileLock()
+	{
+		if (m_hLock == INVALID_HANDLE_VALUE)
+			return;
+
+		UnlockFileEx(m_hLock, 0, MAXDWORD, MAXDWORD, &m_ov);
+		CloseHandle(m_hLock);
+	}
+
+	CacheFileLock(const CacheFileLock&)            = delete;
+	CacheFileLock& operator=(const CacheFileLock&) = delete;
+
+	operator bool() const
+	{
+		return m_hLock != INVALID_HANDLE_VALUE;
+	}
+
+private:
+	HANDLE m_hLock = INVALID_HANDLE_VALUE;
+	OVERLAPPED m_ov = {};
+};
+
+static bool replaceCacheFile(const std::string& tempName)
+{
+	for (uint32_t i = 0; i < REPLACE_RETRIES; i++)
+	{
+		if (MoveFileExA(tempName.c_str(), KeyCache::CACHE_FILE_NAME.c_str(), MOVEFILE_REPLACE_EXISTING))
+			return true;
+
+		const DWORD error = GetLastError();
+		if (error != ERROR_SHARING_VIOLATION && error != ERROR_ACCESS_DENIED)
+			break;
+
+		Sleep(REPLACE_RETRY_WAIT_MS);
+	}
+
+	return false;
+}
+
+// The caller holds a CacheFileLock
+static nlohmann::ordered_json readCacheFile()
+{
+	if (!fs::exists(KeyCache::CACHE_FILE_NAME) || fs::file_size(KeyCache::CACHE_FILE_NAME) == 0)
+		return nlohmann::ordered_json::object();
+
+	try
+	{
+		std::ifstream f(KeyCache::CACHE_FILE_NAME);
+		return nlohmann::ordered_json::parse(f);
+	}
+	catch (const std::exception& e)
+	{
+		ERROR_LOG << std::format(TEXT("KeyCache: Failed to parse {}: {}"), StringToWString(KeyCache::CACHE_FILE_NAME), StringToWString(e.what())) << std::endl;
+		return nlohmann::ordered_json::object();
+	}
+}
+
+std::string KeyCache::Fingerprint(const tString& filePath)
+{
+	std::ifstream f(filePath, std::ios::binary);
+	if (!f.is_open())
+		return "";
+
+	std::vector<uint8_t> data(HASH_BYTES);
+	f.read(reinterpret_cast<char*>(data.data()), data.size());
+	data.resize(static_cast<std::size_t>(f.gcount()));
+
+	if (data.size() < sizeof(DARC_HEAD))
+		return "";
+
+	std::error_code ec;
+	const uintmax_t fileSize = fs::file_size(filePath, ec);
+	if (ec)
+		return "";
+
+	std::string head;
+	for (std::size_t i = 0; i < sizeof(DARC_HEAD); i++)
+		head += ByteToHexString(data[i]);
+
+	return std::format("{:X}-{}-{:08X}", fileSize, head, DXArchive::HashCRC32(data.data(), data.size()));
+}
+
+bool KeyCache::Find(const std::string& fingerprint, Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	load();
+
+	const auto it = m_entries.find(fingerprint);
+	if (it == m_entries.end())
+		return false;
+
+	entry = it->second;
+	return true;
+}
+
+void KeyCache::Store(const std::string& fingerprint, const Entry& entry)
+{
+	if (fingerprint.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	load();
+
+	const auto it = m_entries.find(fingerprint);
+	if (it != m_entries.end() && it->second.decoder == entry.decoder && it->second.key == entry.key)
+		return;
+
+	m_entries[fingerprint] = entry;
+
+	// Other processes might have added entries since the file was loaded, so re-read and merge while holding the lock
+	const CacheFileLock fileLock(true);
+	if (!fileLock)
+		return;
+
+	nlohmann::ordered_json data = readCacheFile();
+
+	data[fingerprint]                 = nlohmann::ordered_json::object();
+	data[fingerprint]["name"]         = entry.name;
+	data[fingerprint]["mode"]         = entry.decoder;
+	data[fingerprint]["cryptVersion"] = entry.cryptVersion;
+	data[fingerprint]["key"]          = nlohmann::ordered_json::array();
+	for (const uint8_t& byte : entry.key)
+		data[fingerprint]["key"].push_back("0x" + ByteToHexString(byte));
+
+	// Write to a temporary file and replace the cache, so readers never see a partially written file
+	const std::string tempName = std::format("{}.{}.tmp", CACHE_FILE_NAME, GetCurrentProcessId());
+
+	{
+		std::ofstream f(tempName);
+		f << data.dump(4);
+	}
+
+	if (!replaceCacheFile(tempName))
+	{
+		ERROR_LOG << std::format(TEXT("KeyCache: Failed to write the cache: {}"), GetLastError()) << std::endl;
+		std::error_code ec;
+		fs::remove(tempName, ec);
+	}
+}
+
+void KeyCache::load()
+{
+	if (m_loaded)
+		return;
+
+	m_loaded = true;
+
+	nlohmann::ordered_json data;
+
+	{
+		// Without the lock the cache is still read, only a concurrent Store can fail to replace it
+		const CacheFileLock fileLock(false);
+		data = readCacheFile();
+	}
+
+	for (const auto& [fingerprint, value] : data.items())
+	{
+		if (!value.contains("mode") || !value.contains("key") || !value["key"].is_array())
+			continue;
+
+		try
+		{
+			Entry entry;
+			entry.name         = value.value("name", "CACHED");
+			entry.decoder      = value["mode"];
+			entry.cryptVersion = value.value("cryptVersion", static_cast<uint16_t>(0));
+
+			for (const auto& v : value["key"])
+				entry.key.push_back(static_cast<uint8_t>(std::stoul(std::string(v), nullptr, 16)));
+
+			m_entries[fingerprint] = entry;
+		}
+		catch (const std::exception&)
+		{
+			// Skip broken entries, they are replaced the next time the archive is decoded
+		}
+	}
+}
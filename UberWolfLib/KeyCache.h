@@ -0,0 +1,77 @@
+/*
+ *  File: KeyCache.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Types.h"
+
+// Persistent mapping of archive fingerprints to the crypt mode that decoded them.
+// Lookups use an in-memory copy of the cache file, writes merge into the file under a
+// system wide lock which readers share, so multiple processes can share the same cache.
+class KeyCache
+{
+public:
+	inline static const std::string CACHE_FILE_NAME = "UberWolfCache.json";
+
+	struct Entry
+	{
+		std::string name;
+		std::string decoder; // Same names as the mode in the config file: VER5, VER6, VER8
+		uint16_t cryptVersion = 0;
+		Key key               = {};
+	};
+
+public:
+	static KeyCache& GetInstance()
+	{
+		static KeyCache instance;
+		return instance;
+	}
+
+	KeyCache(KeyCache const&)      = delete;
+	void operator=(KeyCache const&) = delete;
+
+	// File size, DARC_HEAD and a CRC32 of the beginning of the file, empty if the file can not be read
+	static std::string Fingerprint(const tString& filePath);
+
+	bool Find(const std::string& fingerprint, Entry& entry);
+	void Store(const std::string& fingerprint, const Entry& entry);
+
+private:
+	KeyCache() = default;
+
+	void load();
+
+private:
+	std::map<std::string, Entry> m_entries = {};
+	bool m_loaded                          = false;
+	std::mutex m_mtx;
+};
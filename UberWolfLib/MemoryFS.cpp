@@ -0,0 +1,136 @@
+/*
+ *  File: MemoryFS.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "MemoryFS.h"
+
+#include <algorithm>
+#include <cwctype>
+
+void MemoryFS::MakeDirectory([[maybe_unused]] const std::wstring& dirPath)
+{
+	// Directories only exist as part of the file paths
+}
+
+MemoryFS::FileHandle MemoryFS::OpenFile(const std::wstring& filePath, const uint64_t& size)
+{
+	File* pFile = new File();
+
+	pFile->path = filePath;
+	std::replace(pFile->path.begin(), pFile->path.end(), TEXT('\\'), TEXT('/'));
+	pFile->data.reserve(static_cast<std::size_t>(size));
+
+	return pFile;
+}
+
+bool MemoryFS::WriteFile(FileHandle hFile, const void* pData, const uint64_t& size)
+{
+	if (hFile == nullptr) return false;
+
+	File* pFile           = static_cast<File*>(hFile);
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	pFile->data.insert(pFile->data.end(), pBytes, pBytes + size);
+	return true;
+}
+
+bool MemoryFS::CloseFile(FileHandle hFile, [[maybe_unused]] const uint64_t& create, [[maybe_unused]] const uint64_t& lastAccess, [[maybe_unused]] const uint64_t& lastWrite, [[maybe_unused]] const uint64_t& attributes)
+{
+	if (hFile == nullptr) return false;
+
+	File* pFile = static_cast<File*>(hFile);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+
+		File& file = m_files[normalize(pFile->path)];
+		m_totalSize -= file.data.size();
+		m_totalSize += pFile->data.size();
+		file = std::move(*pFile);
+	}
+
+	delete pFile;
+	return true;
+}
+
+bool MemoryFS::FailFile(FileHandle hFile, [[maybe_unused]] const std::wstring& filePath, [[maybe_unused]] const uint64_t& size, [[maybe_unused]] const char* error)
+{
+	// The partially decoded data is dropped, the failed decode is handled by the caller
+	delete static_cast<File*>(hFile);
+	return false;
+}
+
+bool MemoryFS::Exists(const tString& filePath) const
+{
+	return m_files.contains(normalize(filePath));
+}
+
+const MemoryFS::Buffer* MemoryFS::Find(const tString& filePath) const
+{
+	const auto it = m_files.find(normalize(filePath));
+	return (it == m_files.end() ? nullptr : &it->second.data);
+}
+
+MemoryFS::Buffer MemoryFS::Take(const tString& filePath)
+{
+	const auto it = m_files.find(normalize(filePath));
+	if (it == m_files.end()) return Buffer();
+
+	Buffer data = std::move(it->second.data);
+	m_totalSize -= data.size();
+	m_files.erase(it);
+
+	return data;
+}
+
+tStrings MemoryFS::List() const
+{
+	tStrings paths;
+
+	for (const auto& [key, file] : m_files)
+		paths.push_back(file.path);
+
+	return paths;
+}
+
+void MemoryFS::Clear()
+{
+	m_files.clear();
+	m_totalSize = 0;
+}
+
+tString MemoryFS::normalize(const tString& filePath)
+{
+	tString result = filePath;
+
+	std::replace(result.begin(), result.end(), TEXT('\\'), TEXT('/'));
+
+	// Entries are archive relative, a leading separator refers to the same file
+	const std::size_t start = result.find_first_not_of(TEXT('/'));
+	result.erase(0, (start == tString::npos ? result.size() : start));
+
+	std::transform(result.begin(), result.end(), result.begin(), [](const TCHAR& c) { return static_cast<TCHAR>(std::towlower(c)); });
+
+	return result;
+}
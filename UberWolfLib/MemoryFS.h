@@ -0,0 +1,94 @@
+/*
+ *  File: MemoryFS.h
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <DXLib/ArchiveSink.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+// Extraction target keeping the files of an archive in memory instead of writing them to disk.
+// Paths are relative to the archive root, lookups are case insensitive and accept '/' and '\' as separator.
+// Only one archive can be decoded into it at a time, its files are collected by their handles and added once they are closed.
+// Meant for steps that only read the extracted files, currently the protection key search. WolfXWrapper, the v3.5 unprotect
+// and WolfPro::RemoveProtection rewrite the files of the game folder and keep working on the extracted files on disk.
+class MemoryFS : public DXArchiveSink
+{
+public:
+	using Buffer = std::vector<uint8_t>;
+
+public:
+	MemoryFS() = default;
+
+	void MakeDirectory(const std::wstring& dirPath) override;
+	FileHandle OpenFile(const std::wstring& filePath, const uint64_t& size) override;
+	bool WriteFile(FileHandle hFile, const void* pData, const uint64_t& size) override;
+	bool CloseFile(FileHandle hFile, const uint64_t& create, const uint64_t& lastAccess, const uint64_t& lastWrite, const uint64_t& attributes) override;
+	bool FailFile(FileHandle hFile, const std::wstring& filePath, const uint64_t& size, const char* error) override;
+
+	bool Exists(const tString& filePath) const;
+
+	// Contents of the file, nullptr if it was not extracted
+	const Buffer* Find(const tString& filePath) const;
+
+	// Moves the contents of the file out of the filesystem, returns an empty buffer if it was not extracted
+	Buffer Take(const tString& filePath);
+
+	// Paths of all extracted files with '/' as separator, in the original case
+	tStrings List() const;
+
+	std::size_t GetFileCount() const
+	{
+		return m_files.size();
+	}
+
+	uint64_t GetTotalSize() const
+	{
+		return m_totalSize;
+	}
+
+	void Clear();
+
+private:
+	struct File
+	{
+		tString path = TEXT("");
+		Buffer data  = {};
+	};
+
+	static tString normalize(const tString& filePath);
+
+private:
+	std::map<tString, File> m_files = {};
+	uint64_t m_totalSize            = 0;
+	std::mutex m_mtx;
+};
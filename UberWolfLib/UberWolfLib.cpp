@@ -25,7 +25,9 @@
  */
 
 #include "UberWolfLib.h"
+#include "ArchiveScheduler.h"
 #include "Localizer.h"
+#include "MemoryFS.h"
 #include "UberLog.h"
 #include "Utils.h"
 #include "WolfDec.h"
@@ -33,10 +35,11 @@
 #include "WolfUtils.h"
 #include "resource.h"
 
-#include <eh.h>
+#include <algorithm>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <mutex>
 #include <nlohmann/json.hpp>
 
 #include <SelfUpdater/Version.hpp>
@@ -50,62 +53,46 @@ static const tStrings GAME_EXE_NAMES = {
 
 static const tString DATA_FOLDER_NAME = TEXT("Data");
 
-// TODO: Maybe implement error callbacks or something that notifies the application about errors
-
-// For parent process calls the first argument is expected to be the game executable path
-UberWolfLib::UberWolfLib(const tStrings& argv) :
-	m_gameExePath(TEXT("")),
-	m_dataFolder(TEXT("")),
-	m_valid(false)
+// Keep the files selected by the filter and the directories containing them, the same entries are unpacked or verified
+static void filterListing(DXArchiveListing& listing, const ExtractFilter& filter)
 {
-	if (argv.size() < 1)
-		throw std::runtime_error("UberWolfLib: Invalid arguments count");
+	if (filter.IsEmpty()) return;
 
-	uint32_t mode     = -1;
-	tString path      = TEXT("");
-	bool isSubProcess = IsSubProcess();
-	bool override     = false;
+	tStrings files;
 
-	if (isSubProcess && argv.size() >= 3)
+	for (const DXArchiveEntry& entry : listing.entries)
 	{
-		for (std::size_t i = 0; i < argv.size(); i++)
-		{
-			if (argv[i] == TEXT("-m"))
-			{
-				if (i + 2 >= argv.size())
-					throw std::runtime_error("UberWolfLib: -m argument requires two values");
+		if (!entry.directory && filter.Matches(entry.path))
+			files.push_back(entry.path);
+	}
 
-				mode = std::stoi(WStringToString(argv[i + 1]));
-				path = argv[i + 2];
+	std::vector<DXArchiveEntry> entries;
 
-				if (argv.size() > i + 3)
-					override = (argv[i + 3] == TEXT("-o"));
-				break;
-			}
-		}
+	for (const DXArchiveEntry& entry : listing.entries)
+	{
+		const tString prefix = entry.path + TEXT("/");
+
+		if (entry.directory ? std::any_of(files.begin(), files.end(), [&prefix](const tString& file) { return file.starts_with(prefix); }) : filter.Matches(entry.path))
+			entries.push_back(entry);
 	}
 
-	m_wolfDec = WolfDec(argv[0], mode, isSubProcess);
+	listing.entries = std::move(entries);
+}
 
-	if (isSubProcess)
-	{
-		// Add a new exception translator, this allows for proper catching of potential access violations
-		_set_se_translator([]([[maybe_unused]] unsigned int u, [[maybe_unused]] EXCEPTION_POINTERS* pExp) { throw std::exception(""); });
+// TODO: Maybe implement error callbacks or something that notifies the application about errors
 
-		// For subprocess calls the mode was passed as an argument
-		// directly call unpack, which in this case will also terminate the process
-		try
-		{
-			m_wolfDec.UnpackArchive(path.c_str(), override);
-		}
-		catch ([[maybe_unused]] const std::exception& e)
-		{
-			ExitProcess(1);
-		}
+// The second argument, if present, is expected to be the game executable path
+UberWolfLib::UberWolfLib(const tStrings& argv) :
+	m_gameExePath(TEXT("")),
+	m_dataFolder(TEXT("")),
+	m_valid(false)
+{
+	if (argv.size() < 1)
+		throw std::runtime_error("UberWolfLib: Invalid arguments count");
 
-		ExitProcess(0);
-	}
-	else if (argv.size() >= 2)
+	m_wolfDec = WolfDec();
+
+	if (argv.size() >= 2)
 		InitGame(argv[1]);
 }
 
@@ -114,6 +101,16 @@ UberWolfLib::UberWolfLib(int argc, char* argv[]) :
 {
 }
 
+UberWolfLib::UberWolfLib(const WolfDec& wolfDec) :
+	m_wolfDec(wolfDec),
+	m_gameExePath(TEXT("")),
+	m_dataFolder(TEXT("")),
+	m_valid(false)
+{
+	// The mode detected for another game does not apply to this one
+	m_wolfDec.Reset();
+}
+
 bool UberWolfLib::InitGame(const tString& gameExePath)
 {
 	m_valid = false;
@@ -205,21 +202,114 @@ UWLExitCode UberWolfLib::UnpackData()
 
 UWLExitCode UberWolfLib::UnpackDataVec(const tStrings& paths)
 {
+	tStrings archives;
+
 	for (const tString& p : paths)
 	{
 		if (IsWolfExtension(fs::path(p).extension()))
+			archives.push_back(p);
+	}
+
+	std::size_t i = 0;
+
+	// Unpack sequentially until the crypt mode is known, as detecting it (or the Pro key) modifies the decoder
+	for (; i < archives.size() && !m_wolfDec.IsModeSet(); i++)
+	{
+		UWLExitCode uec = unpackArchive(archives[i], m_config.filter);
+		if (uec != UWLExitCode::SUCCESS) return uec;
+	}
+
+	return unpackArchivesParallel(tStrings(archives.begin() + i, archives.end()));
+}
+
+UWLExitCode UberWolfLib::UnpackArchive(const tString& archivePath)
+{
+	return unpackArchive(archivePath, m_config.filter);
+}
+
+UWLExitCode UberWolfLib::ListData(ArchiveListings& listings)
+{
+	if (!m_valid)
+		return UWLExitCode::NOT_INITIALIZED;
+
+	tStrings paths;
+
+	for (const auto& dirEntry : fs::directory_iterator(m_dataFolder))
+	{
+		if (IsWolfExtension(dirEntry.path().extension()))
+			paths.push_back(FS_PATH_TO_TSTRING(dirEntry.path()));
+	}
+
+	return ListDataVec(paths, listings);
+}
+
+UWLExitCode UberWolfLib::ListDataVec(const tStrings& paths, ArchiveListings& listings)
+{
+	for (const tString& p : paths)
+	{
+		if (!IsWolfExtension(fs::path(p).extension()))
+			continue;
+
+		// The special files are skipped like when unpacking or verifying
+		if (!m_wolfDec.IsValidFile(p))
+			continue;
+
+		UWLExitCode uec = listArchive(p, listings[p]);
+		if (uec != UWLExitCode::SUCCESS)
 		{
-			UWLExitCode uec = unpackArchive(p);
-			if (uec != UWLExitCode::SUCCESS) return uec;
+			listings.erase(p);
+			return uec;
 		}
 	}
 
 	return UWLExitCode::SUCCESS;
 }
 
-UWLExitCode UberWolfLib::UnpackArchive(const tString& archivePath)
+UWLExitCode UberWolfLib::ListArchive(const tString& archivePath, DXArchiveListing& listing)
+{
+	return listArchive(archivePath, listing);
+}
+
+UWLExitCode UberWolfLib::VerifyData(ArchiveVerifyReports& reports)
+{
+	if (!m_valid)
+		return UWLExitCode::NOT_INITIALIZED;
+
+	tStrings paths;
+
+	for (const auto& dirEntry : fs::directory_iterator(m_dataFolder))
+	{
+		if (IsWolfExtension(dirEntry.path().extension()))
+			paths.push_back(FS_PATH_TO_TSTRING(dirEntry.path()));
+	}
+
+	return VerifyDataVec(paths, reports);
+}
+
+UWLExitCode UberWolfLib::VerifyDataVec(const tStrings& paths, ArchiveVerifyReports& reports)
 {
-	return unpackArchive(archivePath);
+	UWLExitCode result = UWLExitCode::SUCCESS;
+
+	for (const tString& p : paths)
+	{
+		if (!IsWolfExtension(fs::path(p).extension()))
+			continue;
+
+		if (!m_wolfDec.IsValidFile(p))
+			continue;
+
+		// A broken archive does not stop the others from being verified, the first error is returned
+		const UWLExitCode uec = verifyArchive(p, reports[p]);
+		if (uec != UWLExitCode::SUCCESS && result == UWLExitCode::SUCCESS)
+			result = uec;
+	}
+
+	return result;
+}
+
+UWLExitCode UberWolfLib::VerifyArchive(const tString& archivePath, DXArchiveVerifyReport& report)
+{
+	return verifyArchive(archivePath, report);
 }
 
 UWLExitCode UberWolfLib::FindDxArcKey(const bool& quiet)
@@ -256,21 +346,30 @@ UWLExitCode UberWolfLib::FindProtectionKey(std::string& key)
 			return UWLExitCode::FILE_NOT_FOUND;
 		}
 
-		if (unpackArchive(target) != UWLExitCode::SUCCESS) return UWLExitCode::UNPACK_FAILED;
-	}
+		// Removing the protection works on the extracted files of the whole archive
+		if (m_config.unprotect)
+		{
+			if (unpackArchive(target, m_config.filter) != UWLExitCode::SUCCESS) return UWLExitCode::UNPACK_FAILED;
+		}
+		else
+		{
+			// Only the key file is needed, it is read from memory so nothing is left next to the archive
+			MemoryFS memFs;
 
-	Key keyVec = m_wolfPro.GetProtectionKey();
-	if (keyVec.empty())
-		return UWLExitCode::PROT_KEY_DETECT_FAILED;
+			if (unpackArchive(target, ExtractFilter({ m_wolfPro.GetProtKeyFileName() }), false, false, &memFs) != UWLExitCode::SUCCESS) return UWLExitCode::UNPACK_FAILED;
 
-	key = "";
-	for (const uint8_t& byte : keyVec)
-		key += static_cast<char>(byte);
+			const MemoryFS::Buffer* pGameDat = memFs.Find(m_wolfPro.GetProtKeyFileName());
+			if (pGameDat == nullptr)
+			{
+				ERROR_LOG << std::format(TEXT("UberWolfLib: Could not find protection file: {}"), m_wolfPro.GetProtKeyFileName()) << std::endl;
+				return UWLExitCode::FILE_NOT_FOUND;
+			}
 
-	if (m_config.unprotect)
-		m_wolfPro.RemoveProtection();
+			return setProtectionKey(m_wolfPro.GetProtectionKey(*pGameDat), key);
+		}
+	}
 
-	return UWLExitCode::SUCCESS;
+	return setProtectionKey(m_wolfPro.GetProtectionKey(), key);
 }
 
 UWLExitCode UberWolfLib::FindProtectionKey(std::wstring& key)
@@ -337,7 +436,22 @@ UWLExitCode UberWolfLib::packData(const tString& dataPath)
 	return result ? UWLExitCode::SUCCESS : UWLExitCode::UNKNOWN_ERROR;
 }
 
-UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& quiet, const bool& secondRun)
+UWLExitCode UberWolfLib::setProtectionKey(const Key& keyVec, std::string& key)
+{
+	if (keyVec.empty())
+		return UWLExitCode::PROT_KEY_DETECT_FAILED;
+
+	key = "";
+	for (const uint8_t& byte : keyVec)
+		key += static_cast<char>(byte);
+
+	if (m_config.unprotect)
+		m_wolfPro.RemoveProtection();
+
+	return UWLExitCode::SUCCESS;
+}
+
+UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const ExtractFilter& filter, const bool& quiet, const bool& secondRun, MemoryFS* pMemFs)
 {
 	// Make sure the file exists
 	if (!fs::exists(archivePath))
@@ -354,7 +468,7 @@ UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& q
 	if (!m_wolfDec.IsValidFile(archivePath))
 		return UWLExitCode::SUCCESS;
 
-	if (!m_config.override && m_wolfDec.IsAlreadyUnpacked(archivePath))
+	if (pMemFs == nullptr && !m_config.override && filter.IsEmpty() && m_wolfDec.IsAlreadyUnpacked(archivePath))
 	{
 		INFO_LOG << vFormat(LOCALIZE("unpacked_msg"), fileName) << std::endl;
 		return UWLExitCode::SUCCESS;
@@ -363,7 +477,10 @@ UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& q
 	if (!quiet)
 		INFO_LOG << vFormat(LOCALIZE("unpacking_msg"), fileName);
 
-	bool result = m_wolfDec.UnpackArchive(archivePath, m_config.override);
+	// Only one archive is unpacked, so all threads decode its files
+	m_wolfDec.SetExtractThreads(jobCount());
+
+	bool result = (pMemFs == nullptr ? m_wolfDec.UnpackArchive(archivePath, m_config.override, filter) : m_wolfDec.UnpackArchive(archivePath, *pMemFs, filter));
 
 	if (!result)
 	{
@@ -381,7 +498,7 @@ UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& q
 			UWLExitCode uec = FindDxArcKey(true);
 
 			if (uec == UWLExitCode::SUCCESS)
-				return unpackArchive(archivePath, true, true);
+				return unpackArchive(archivePath, filter, true, true, pMemFs);
 		}
 
 		INFO_LOG << LOCALIZE("failed_msg") << std::endl;
@@ -392,6 +509,167 @@ UWLExitCode UberWolfLib::unpackArchive(const tString& archivePath, const bool& q
 	return result ? UWLExitCode::SUCCESS : UWLExitCode::KEY_MISSING;
 }
 
+// Same key handling as unpackArchive, but without any output as the listing is the output
+UWLExitCode UberWolfLib::listArchive(const tString& archivePath, DXArchiveListing& listing, const bool& secondRun)
+{
+	if (archivePath.empty())
+		return UWLExitCode::INVALID_PATH;
+
+	if (!fs::exists(archivePath))
+		return UWLExitCode::FILE_NOT_FOUND;
+
+	if (!m_wolfDec)
+		return UWLExitCode::WOLF_DEC_NOT_INITIALIZED;
+
+	if (m_wolfDec.ListArchive(archivePath, listing))
+	{
+		filterListing(listing, m_config.filter);
+		return UWLExitCode::SUCCESS;
+	}
+
+	if (!m_valid)
+	{
+		if (!findGameFromArchive(archivePath))
+			return UWLExitCode::NOT_INITIALIZED;
+	}
+
+	if (!secondRun && FindDxArcKey(true) == UWLExitCode::SUCCESS)
+		return listArchive(archivePath, listing, true);
+
+	return UWLExitCode::KEY_MISSING;
+}
+
+// Same key handling as listArchive, the archives are verified one after another with all threads decoding the files of one
+UWLExitCode UberWolfLib::verifyArchive(const tString& archivePath, DXArchiveVerifyReport& report, const bool& secondRun)
+{
+	if (archivePath.empty())
+		return UWLExitCode::INVALID_PATH;
+
+	if (!fs::exists(archivePath))
+		return UWLExitCode::FILE_NOT_FOUND;
+
+	if (!m_wolfDec)
+		return UWLExitCode::WOLF_DEC_NOT_INITIALIZED;
+
+	m_wolfDec.SetExtractThreads(jobCount());
+
+	if (m_wolfDec.VerifyArchive(archivePath, report, m_config.filter))
+		return UWLExitCode::SUCCESS;
+
+	// The known mode reads the header, the archive itself is broken and another key would not decode it either
+	DXArchiveListing listing;
+	if (m_wolfDec.IsModeSet() && m_wolfDec.ListArchive(archivePath, listing))
+		return UWLExitCode::UNPACK_FAILED;
+
+	if (!m_valid)
+	{
+		if (!findGameFromArchive(archivePath))
+			return UWLExitCode::NOT_INITIALIZED;
+	}
+
+	if (!secondRun && FindDxArcKey(true) == UWLExitCode::SUCCESS)
+		return verifyArchive(archivePath, report, true);
+
+	// The report of the failed attempt is kept, it shows the entries decoded before the error
+	return UWLExitCode::KEY_MISSING;
+}
+
+UWLExitCode UberWolfLib::unpackArchivesParallel(const tStrings& paths)
+{
+	const uint32_t jobs = jobCount();
+
+	if (jobs <= 1 || paths.size() <= 1)
+	{
+		for (const tString& p : paths)
+		{
+			UWLExitCode uec = unpackArchive(p, m_config.filter);
+			if (uec != UWLExitCode::SUCCESS) return uec;
+		}
+
+		return UWLExitCode::SUCCESS;
+	}
+
+	enum class Outcome
+	{
+		SKIPPED,
+		ALREADY_UNPACKED,
+		UNPACKED
+	};
+
+	std::vector<Outcome> outcomes(paths.size(), Outcome::SKIPPED);
+	std::vector<uint64_t> sizes;
+
+	for (const tString& p : paths)
+	{
+		std::error_code ec;
+		const uintmax_t size = fs::file_size(p, ec);
+		sizes.push_back(ec ? 0 : static_cast<uint64_t>(size));
+	}
+
+	ArchiveScheduler scheduler(sizes, jobs, m_config.memBudget);
+
+	// The threads are split between the archives unpacked at the same time
+	m_wolfDec.SetExtractThreads(jobs / static_cast<uint32_t>(std::min<std::size_t>(jobs, paths.size())));
+
+	// The workers only use the already detected mode, failures are handled by unpackArchive below
+	scheduler.Start([&](const std::size_t& idx) {
+		const tString& p = paths[idx];
+
+		if (!fs::exists(p))
+			return false;
+
+		if (!m_wolfDec.IsValidFile(p))
+			return true;
+
+		if (!m_config.override && m_config.filter.IsEmpty() && m_wolfDec.IsAlreadyUnpacked(p))
+		{
+			outcomes[idx] = Outcome::ALREADY_UNPACKED;
+			return true;
+		}
+
+		outcomes[idx] = Outcome::UNPACKED;
+		return m_wolfDec.UnpackArchive(p, m_config.override, m_config.filter);
+	});
+
+	// Collect the results in the original order to keep the log identical to a sequential run
+	for (std::size_t idx = 0; idx < paths.size(); idx++)
+	{
+		bool result = false;
+
+		if (scheduler.WaitFor(idx, result) && result)
+		{
+			const tString fileName = fs::path(paths[idx]).filename();
+
+			if (outcomes[idx] == Outcome::ALREADY_UNPACKED)
+				INFO_LOG << vFormat(LOCALIZE("unpacked_msg"), fileName) << std::endl;
+			else if (outcomes[idx] == Outcome::UNPACKED)
+			{
+				INFO_LOG << vFormat(LOCALIZE("unpacking_msg"), fileName);
+				INFO_LOG << LOCALIZE("done_msg") << std::endl;
+			}
+
+			continue;
+		}
+
+		// The key detection fallback modifies the decoder, so from the first failure on
+		// everything that did not finish yet is unpacked sequentially
+		scheduler.Stop();
+
+		UWLExitCode uec = unpackArchive(paths[idx], m_config.filter);
+		if (uec != UWLExitCode::SUCCESS) return uec;
+	}
+
+	return UWLExitCode::SUCCESS;
+}
+
+uint32_t UberWolfLib::jobCount() const
+{
+	if (m_config.jobsFunc)
+		return std::max<uint32_t>(m_config.jobsFunc(), 1);
+
+	return (m_config.jobs == 0 ? ArchiveScheduler::DefaultJobCount() : m_config.jobs);
+}
+
 bool UberWolfLib::findDataFolder()
 {
 	m_dataAsFile = false;
@@ -445,6 +723,10 @@ UWLExitCode UberWolfLib::findDxArcKeyFile(const bool& quiet)
 
 void UberWolfLib::updateConfig(const bool& useOldDxArc, const Key& key)
 {
+	// Games processed concurrently share the config file
+	static std::mutex mtx;
+	std::lock_guard<std::mutex> lock(mtx);
+
 	nlohmann::ordered_json data;
 
 	// Load the config file if it exists and is not empty
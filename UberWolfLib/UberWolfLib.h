@@ -30,6 +30,12 @@
 #include "WolfDec.h"
 #include "WolfPro.h"
 
+#include <DXLib/ArchiveListing.h>
+#include <DXLib/ArchiveVerify.h>
+
+#include <functional>
+#include <map>
+
 enum class UWLExitCode
 {
 	SUCCESS = 0,
@@ -47,19 +53,32 @@ enum class UWLExitCode
 	UNKNOWN_ERROR = 999
 };
 
+// Archive listings by archive path
+using ArchiveListings = std::map<tString, DXArchiveListing>;
+
+// Archive verification reports by archive path
+using ArchiveVerifyReports = std::map<tString, DXArchiveVerifyReport>;
+
 class UberWolfLib
 {
 	struct Config
 	{
-		bool override  = false;
-		bool unprotect = false;
-		bool decWolfX  = false;
+		bool override                      = false;
+		bool unprotect                     = false;
+		bool decWolfX                      = false;
+		uint32_t jobs                      = 0;       // Number of threads unpacking archives and their files, 0 = one per hardware thread
+		std::function<uint32_t()> jobsFunc = nullptr; // Replaces jobs if set, queried before every archive
+		uint64_t memBudget                 = 0;       // Limit for the summed size of the archives unpacked at once, 0 = unlimited
+		ExtractFilter filter               = {};      // Entries unpacked, listed or verified, empty = all
 	};
 
 public:
 	UberWolfLib(const tStrings& argv);
 	UberWolfLib(int argc = 0, char* argv[] = nullptr);
 
+	// Starts with a copy of the modes of wolfDec instead of loading the config file again, e.g., for the games of a batch
+	explicit UberWolfLib(const WolfDec& wolfDec);
+
 	operator bool() const
 	{
 		return m_valid;
@@ -72,6 +91,25 @@ public:
 		m_config.decWolfX  = decWolfX;
 	}
 
+	void ConfigureScheduler(const uint32_t& jobs = 0, const uint64_t& memBudget = 0)
+	{
+		m_config.jobs      = jobs;
+		m_config.jobsFunc  = nullptr;
+		m_config.memBudget = memBudget;
+	}
+
+	// The number of threads can change while the archives are unpacked, e.g., a share of a pool used by other work as well
+	void ConfigureScheduler(const std::function<uint32_t()>& jobsFunc, const uint64_t& memBudget = 0)
+	{
+		m_config.jobsFunc  = jobsFunc;
+		m_config.memBudget = memBudget;
+	}
+
+	void ConfigureFilter(const tStrings& include = {}, const tStrings& exclude = {})
+	{
+		m_config.filter = ExtractFilter(include, exclude);
+	}
+
 	bool InitGame(const tString& gameExePath);
 
 	UWLExitCode PackData(const int32_t& encIdx);
@@ -82,12 +120,27 @@ public:
 	UWLExitCode UnpackDataVec(const tStrings& paths);
 	UWLExitCode UnpackArchive(const tString& archivePath);
 
+	UWLExitCode ListData(ArchiveListings& listings);
+	UWLExitCode ListDataVec(const tStrings& paths, ArchiveListings& listings);
+	UWLExitCode ListArchive(const tString& archivePath, DXArchiveListing& listing);
+
+	// Decode the archives without writing anything, a report with failed entries still returns SUCCESS.
+	// Every archive is verified and gets a report, the first error is returned
+	UWLExitCode VerifyData(ArchiveVerifyReports& reports);
+	UWLExitCode VerifyDataVec(const tStrings& paths, ArchiveVerifyReports& reports);
+	UWLExitCode VerifyArchive(const tString& archivePath, DXArchiveVerifyReport& report);
+
 	UWLExitCode FindDxArcKey(const bool& quiet = false);
 	UWLExitCode FindProtectionKey(std::string& key);
 	UWLExitCode FindProtectionKey(std::wstring& key);
 
 	void ResetWolfDec();
 
+	const CryptMode* GetCryptMode() const
+	{
+		return m_wolfDec.GetCurrentMode();
+	}
+
 	static std::size_t RegisterLogCallback(const LogCallback& callback);
 	static void UnregisterLogCallback(const std::size_t& idx);
 	static void RegisterLocQueryFunc(const LocalizerQuery& queryFunc);
@@ -106,7 +159,12 @@ public:
 
 private:
 	UWLExitCode packData(const tString& dataPath);
-	UWLExitCode unpackArchive(const tString& archivePath, const bool& quiet = false, const bool& secondRun = false);
+	UWLExitCode unpackArchive(const tString& archivePath, const ExtractFilter& filter, const bool& quiet = false, const bool& secondRun = false, MemoryFS* pMemFs = nullptr);
+	UWLExitCode setProtectionKey(const Key& keyVec, std::string& key);
+	UWLExitCode unpackArchivesParallel(const tStrings& paths);
+	uint32_t jobCount() const;
+	UWLExitCode listArchive(const tString& archivePath, DXArchiveListing& listing, const bool& secondRun = false);
+	UWLExitCode verifyArchive(const tString& archivePath, DXArchiveVerifyReport& report, const bool& secondRun = false);
 	bool findDataFolder();
 	UWLExitCode findDxArcKeyFile(const bool& quiet = false);
 	void updateConfig(const bool& useOldDxArc, const Key& key);
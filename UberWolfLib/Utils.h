@@ -32,19 +32,10 @@
 #include <fstream>
 #include <iostream>
 #include <map>
-#include <tlhelp32.h>
 #include <vector>
 
 #include "Types.h"
 
-struct ProcessInfo
-{
-	DWORD pid;
-	DWORD parentPid;
-	std::wstring name;
-	std::wstring parentName;
-};
-
 inline std::wstring StringToWString(const std::string& str)
 {
 	std::wstring wstr;
@@ -88,49 +79,6 @@ inline std::string ByteToHexString(const uint8_t& byte)
 	return std::string(hex);
 }
 
-// Function to get the parent process ID
-inline ProcessInfo GetProcessInfo(const DWORD& pid)
-{
-	PROCESSENTRY32 processEntry;
-	processEntry.dwSize = sizeof(PROCESSENTRY32);
-
-	HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-
-	if (hSnapshot == INVALID_HANDLE_VALUE)
-		return ProcessInfo{};
-
-	std::map<DWORD, ProcessInfo> processMap;
-
-	if (Process32First(hSnapshot, &processEntry))
-	{
-		do
-		{
-			processMap[processEntry.th32ProcessID] = ProcessInfo{ processEntry.th32ProcessID, processEntry.th32ParentProcessID, processEntry.szExeFile, L"" };
-		} while (Process32Next(hSnapshot, &processEntry));
-	}
-
-	CloseHandle(hSnapshot);
-
-	for (auto& process : processMap)
-	{
-		if (process.second.parentPid != 0 && processMap.find(process.second.parentPid) != processMap.end())
-			process.second.parentName = processMap[process.second.parentPid].name;
-	}
-
-	if (processMap.find(pid) != processMap.end())
-		return processMap[pid];
-
-	return ProcessInfo{};
-}
-
-inline bool IsSubProcess()
-{
-	const DWORD pid               = GetCurrentProcessId(); // Get the PID of the current process
-	const ProcessInfo processInfo = GetProcessInfo(pid);
-
-	return (processInfo.name == processInfo.parentName);
-}
-
 inline std::vector<uint8_t> file2Buffer(const std::filesystem::path& filePath)
 {
 	std::ifstream inFile(filePath, std::ios::binary);
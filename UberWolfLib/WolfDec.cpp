@@ -28,6 +28,8 @@
 
 #include "WolfDec.h"
 
+#include <DXLib/ArchiveBufferPool.h>
+#include <DXLib/ArchiveVerify.h>
 #include <DXLib/DXArchive.h>
 #include <DXLib/DXArchiveVer5.h>
 #include <DXLib/DXArchiveVer6.h>
@@ -35,7 +37,10 @@
 
 #include <nlohmann/json.hpp>
 
+#include <eh.h>
+
 #include <algorithm>
+#include <chrono>
 #include <codecvt>
 #include <filesystem>
 #include <format>
@@ -45,6 +50,10 @@
 #include <vector>
 #include <windows.h>
 
+#include "ExtractFilter.h"
+#include "ExtractManifest.h"
+#include "KeyCache.h"
+#include "MemoryFS.h"
 #include "UberLog.h"
 #include "Utils.h"
 #include "WolfUtils.h"
@@ -54,24 +63,84 @@ namespace fs = std::filesystem;
 static constexpr uint16_t PRO_CRYPT_VERSION = 1000;
 static constexpr uint16_t CC2_PRO_VERSION   = 0xC8;
 
+struct Decoder
+{
+	std::string name;
+	DecryptFunction decFunc;
+	ProbeFunction probeFunc;
+	ListFunction listFunc;
+};
+
+// Archive decoders by the name used in the config and cache files
+static const std::vector<Decoder> DECODERS = {
+	{ "VER5", &DXArchive_VER5::DecodeArchive, &DXArchive_VER5::ProbeArchive, &DXArchive_VER5::ListArchive },
+	{ "VER6", &DXArchive_VER6::DecodeArchive, &DXArchive_VER6::ProbeArchive, &DXArchive_VER6::ListArchive },
+	{ "VER8", &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::ListArchive }
+};
+
+static const Decoder* findDecoder(std::string name)
+{
+	std::transform(name.begin(), name.end(), name.begin(), [](const unsigned char& c) { return std::toupper(c); });
+
+	for (const Decoder& decoder : DECODERS)
+	{
+		if (decoder.name == name)
+			return &decoder;
+	}
+
+	return nullptr;
+}
+
+static const Decoder* findDecoder(const DecryptFunction& decFunc)
+{
+	for (const Decoder& decoder : DECODERS)
+	{
+		if (decoder.decFunc == decFunc)
+			return &decoder;
+	}
+
+	return nullptr;
+}
+
+// A wrong key can make the decoder read out of bounds, translate these structured exceptions into C++ exceptions
+// so a failed attempt only fails the current archive (the translator is per thread)
+template<typename F>
+static bool runGuarded(const F& func)
+{
+	const _se_translator_function prevTranslator = _set_se_translator([]([[maybe_unused]] unsigned int u, [[maybe_unused]] EXCEPTION_POINTERS* pExp) { throw std::exception(""); });
+
+	bool result = false;
+
+	try
+	{
+		result = func();
+	}
+	catch (const std::exception&)
+	{
+		result = false;
+	}
+
+	_set_se_translator(prevTranslator);
+
+	return result;
+}
+
 const CryptModes DEFAULT_CRYPT_MODES = {
-	{ "Wolf RPG v2.01", 0x0, &DXArchive_VER5::DecodeArchive, &DXArchive_VER5::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x0f, 0x53, 0xe1, 0x3e, 0x04, 0x37, 0x12, 0x17, 0x60, 0x0f, 0x53, 0xe1 } },
-	{ "Wolf RPG v2.10", 0x0, &DXArchive_VER5::DecodeArchive, &DXArchive_VER5::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x4c, 0xd9, 0x2a, 0xb7, 0x28, 0x9b, 0xac, 0x07, 0x3e, 0x77, 0xec, 0x4c } },
-	{ "Wolf RPG v2.20", 0x0, &DXArchive_VER6::DecodeArchive, &DXArchive_VER6::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x38, 0x50, 0x40, 0x28, 0x72, 0x4f, 0x21, 0x70, 0x3b, 0x73, 0x35, 0x38 } },
-	{ "Wolf RPG v2.225", 0x0, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "WLFRPrO!p(;s5((8P@((UFWlu$#5(=" },
-	{ "Wolf RPG v3.00", 0x12C, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0x0F, 0x53, 0xE1, 0x3E, 0x8E, 0xB5, 0x41, 0x91, 0x52, 0x16, 0x55, 0xAE, 0x34, 0xC9, 0x8F, 0x79, 0x59, 0x2F, 0x59, 0x6B, 0x95, 0x19, 0x9B, 0x1B, 0x35, 0x9A, 0x2F, 0xDE, 0xC9, 0x7C, 0x12, 0x96, 0xC3, 0x14, 0xB5, 0x0F, 0x53, 0xE1, 0x3E, 0x8E, 0x00 } },
-	{ "Wolf RPG v3.14", 0x13A, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0x31, 0xF9, 0x01, 0x36, 0xA3, 0xE3, 0x8D, 0x3C, 0x7B, 0xC3, 0x7D, 0x25, 0xAD, 0x63, 0x28, 0x19, 0x1B, 0xF7, 0x8E, 0x6C, 0xC4, 0xE5, 0xE2, 0x76, 0x82, 0xEA, 0x4F, 0xED, 0x61, 0xDA, 0xE0, 0x44, 0x5B, 0xB6, 0x46, 0x3B, 0x06, 0xD5, 0xCE, 0xB6, 0x78, 0x58, 0xD0, 0x7C, 0x82, 0x00 } },
-	{ "Wolf RPG v3.31", 0x14B, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xCA, 0x08, 0x4C, 0x5D, 0x17, 0x0D, 0xDA, 0xA1, 0xD7, 0x27, 0xC8, 0x41, 0x54, 0x38, 0x82, 0x32, 0x54, 0xB7, 0xF9, 0x46, 0x8E, 0x13, 0x6B, 0xCA, 0xD0, 0x5C, 0x95, 0x95, 0xE2, 0xDC, 0x03, 0x53, 0x60, 0x9B, 0x4A, 0x38, 0x17, 0xF3, 0x69, 0x59, 0xA4, 0xC7, 0x9A, 0x43, 0x63, 0xE6, 0x54, 0xAF, 0xDB, 0xBB, 0x43, 0x58, 0x00 } },
-	{ "Wolf RPG v3.50", 0x15E, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xD2, 0x84, 0xCE, 0x28, 0xCE, 0x88, 0x82, 0xE4, 0x2A, 0x18, 0x2E, 0x4C, 0x06, 0xB4, 0xEA, 0x84, 0x06, 0xB8, 0xC6, 0x88, 0x5A, 0xA0, 0x9E, 0x7C, 0x56, 0x40, 0xBA, 0x34, 0x52, 0xCC, 0xC6, 0x7C, 0x2E, 0x14, 0x12, 0x68, 0xFE, 0x5C, 0x76, 0x94, 0x86, 0x78, 0x8E, 0x4C, 0xBE, 0x88, 0x66, 0x9C, 0x1E, 0xE0, 0x8E, 0x6C, 0x00 } },
-	{ "Wolf RPG ChaCha2 v1", 0x64, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD, 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85, 0x00 } }, // First 32 bytes of the key and the next 12 byte are the nonce, 0 terminator for the unused keygen to not crash
-	{ "One Way Heroics", 0x0, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "nGui9('&1=@3#a" },
-	{ "One Way Heroics Plus", 0x0, &DXArchive::DecodeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "Ph=X3^]o2A(,1=@3#a" }
+	{ "Wolf RPG v2.01", 0x0, &DXArchive_VER5::DecodeArchive, &DXArchive_VER5::ProbeArchive, &DXArchive_VER5::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x0f, 0x53, 0xe1, 0x3e, 0x04, 0x37, 0x12, 0x17, 0x60, 0x0f, 0x53, 0xe1 } },
+	{ "Wolf RPG v2.10", 0x0, &DXArchive_VER5::DecodeArchive, &DXArchive_VER5::ProbeArchive, &DXArchive_VER5::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x4c, 0xd9, 0x2a, 0xb7, 0x28, 0x9b, 0xac, 0x07, 0x3e, 0x77, 0xec, 0x4c } },
+	{ "Wolf RPG v2.20", 0x0, &DXArchive_VER6::DecodeArchive, &DXArchive_VER6::ProbeArchive, &DXArchive_VER6::EncodeArchiveOneDirectory, std::vector<unsigned char>{ 0x38, 0x50, 0x40, 0x28, 0x72, 0x4f, 0x21, 0x70, 0x3b, 0x73, 0x35, 0x38 } },
+	{ "Wolf RPG v2.225", 0x0, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "WLFRPrO!p(;s5((8P@((UFWlu$#5(=" },
+	{ "Wolf RPG v3.00", 0x12C, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0x0F, 0x53, 0xE1, 0x3E, 0x8E, 0xB5, 0x41, 0x91, 0x52, 0x16, 0x55, 0xAE, 0x34, 0xC9, 0x8F, 0x79, 0x59, 0x2F, 0x59, 0x6B, 0x95, 0x19, 0x9B, 0x1B, 0x35, 0x9A, 0x2F, 0xDE, 0xC9, 0x7C, 0x12, 0x96, 0xC3, 0x14, 0xB5, 0x0F, 0x53, 0xE1, 0x3E, 0x8E, 0x00 } },
+	{ "Wolf RPG v3.14", 0x13A, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0x31, 0xF9, 0x01, 0x36, 0xA3, 0xE3, 0x8D, 0x3C, 0x7B, 0xC3, 0x7D, 0x25, 0xAD, 0x63, 0x28, 0x19, 0x1B, 0xF7, 0x8E, 0x6C, 0xC4, 0xE5, 0xE2, 0x76, 0x82, 0xEA, 0x4F, 0xED, 0x61, 0xDA, 0xE0, 0x44, 0x5B, 0xB6, 0x46, 0x3B, 0x06, 0xD5, 0xCE, 0xB6, 0x78, 0x58, 0xD0, 0x7C, 0x82, 0x00 } },
+	{ "Wolf RPG v3.31", 0x14B, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xCA, 0x08, 0x4C, 0x5D, 0x17, 0x0D, 0xDA, 0xA1, 0xD7, 0x27, 0xC8, 0x41, 0x54, 0x38, 0x82, 0x32, 0x54, 0xB7, 0xF9, 0x46, 0x8E, 0x13, 0x6B, 0xCA, 0xD0, 0x5C, 0x95, 0x95, 0xE2, 0xDC, 0x03, 0x53, 0x60, 0x9B, 0x4A, 0x38, 0x17, 0xF3, 0x69, 0x59, 0xA4, 0xC7, 0x9A, 0x43, 0x63, 0xE6, 0x54, 0xAF, 0xDB, 0xBB, 0x43, 0x58, 0x00 } },
+	{ "Wolf RPG v3.50", 0x15E, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xD2, 0x84, 0xCE, 0x28, 0xCE, 0x88, 0x82, 0xE4, 0x2A, 0x18, 0x2E, 0x4C, 0x06, 0xB4, 0xEA, 0x84, 0x06, 0xB8, 0xC6, 0x88, 0x5A, 0xA0, 0x9E, 0x7C, 0x56, 0x40, 0xBA, 0x34, 0x52, 0xCC, 0xC6, 0x7C, 0x2E, 0x14, 0x12, 0x68, 0xFE, 0x5C, 0x76, 0x94, 0x86, 0x78, 0x8E, 0x4C, 0xBE, 0x88, 0x66, 0x9C, 0x1E, 0xE0, 0x8E, 0x6C, 0x00 } },
+	{ "Wolf RPG ChaCha2 v1", 0x64, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, std::vector<unsigned char>{ 0xC9, 0x82, 0xF8, 0xB4, 0x2C, 0x93, 0x9E, 0x83, 0x0E, 0xBC, 0xBC, 0x92, 0x68, 0x8D, 0x59, 0xA1, 0x4A, 0x9E, 0x7F, 0xB0, 0xAC, 0xAF, 0x1D, 0x8F, 0x8E, 0xB8, 0x3B, 0x9E, 0xE8, 0x89, 0xD9, 0xAD, 0xFF, 0xBC, 0x2D, 0xAB, 0x9D, 0x8B, 0x0F, 0xB4, 0xBB, 0x9A, 0x69, 0x85, 0x00 } }, // First 32 bytes of the key and the next 12 byte are the nonce, 0 terminator for the unused keygen to not crash
+	{ "One Way Heroics", 0x0, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "nGui9('&1=@3#a" },
+	{ "One Way Heroics Plus", 0x0, &DXArchive::DecodeArchive, &DXArchive::ProbeArchive, &DXArchive::EncodeArchiveOneDirectoryWolf, "Ph=X3^]o2A(,1=@3#a" }
 };
 
-WolfDec::WolfDec(const std::wstring& progName, const uint32_t& mode, const bool& isSubProcess) :
-	m_progName(progName),
+WolfDec::WolfDec(const uint32_t& mode) :
 	m_mode(mode),
-	m_isSubProcess(isSubProcess),
 	m_valid(true)
 {
 	loadConfig();
@@ -88,6 +157,11 @@ bool WolfDec::IsValidFile(const tString& filePath) const
 }
 
 bool WolfDec::IsAlreadyUnpacked(const tString& filePath) const
+{
+	return isAlreadyUnpacked(filePath, KeyCache::Fingerprint(filePath));
+}
+
+bool WolfDec::isAlreadyUnpacked(const tString& filePath, const std::string& fingerprint) const
 {
 	const fs::path fp = fs::path(filePath);
 
@@ -95,6 +169,10 @@ bool WolfDec::IsAlreadyUnpacked(const tString& filePath) const
 	const tString fileName      = fp.stem();
 	const tString outDir        = directoryPath + TEXT("/") + fileName;
 
+	if (ExtractManifest::Exists(filePath))
+		return ExtractManifest::IsComplete(filePath, outDir, fingerprint);
+
+	// Extracted without a manifest, only check if there is anything in the directory
 	if (!fs::exists(outDir)) return false;
 	if (fs::is_empty(outDir)) return false;
 
@@ -103,6 +181,7 @@ bool WolfDec::IsAlreadyUnpacked(const tString& filePath) const
 	for (const auto& entry : fs::directory_iterator(outDir))
 		files.push_back(entry.path());
 
+	// Left behind by an interrupted extraction of older versions, which decrypted v3.x archives into a temporary file
 	if (files.size() == 1 && files.front().filename() == "decrypt_temp")
 	{
 		// Remove the temporary directory
@@ -120,10 +199,7 @@ bool WolfDec::PackArchive(const tString& folderPath, const bool& override)
 	if (!fs::exists(fp) || !fs::is_directory(fp))
 	{
 		ERROR_LOG << std::format(TEXT("Invalid directory: {}"), folderPath) << std::endl;
-		if (m_isSubProcess)
-			ExitProcess(1);
-		else
-			return false;
+		return false;
 	}
 
 	const tString directoryPath = fp.parent_path();
@@ -141,13 +217,10 @@ bool WolfDec::PackArchive(const tString& folderPath, const bool& override)
 	if (m_mode >= (DEFAULT_CRYPT_MODES.size() + m_additionalModes.size()))
 	{
 		ERROR_LOG << std::format(TEXT("Specified Mode: {} out of range"), m_mode) << std::endl;
-		if (m_isSubProcess)
-			ExitProcess(1);
-		else
-			return false;
+		return false;
 	}
 
-	const CryptMode curMode = (m_mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(m_mode) : m_additionalModes.at(m_mode - DEFAULT_CRYPT_MODES.size()));
+	const CryptMode& curMode = getMode(m_mode);
 
 	fs::current_path(directoryPath);
 
@@ -155,10 +228,7 @@ bool WolfDec::PackArchive(const tString& folderPath, const bool& override)
 	{
 		const std::wstring modeName = std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(curMode.name);
 		ERROR_LOG << std::format(TEXT("Encryption function not found for mode: {}"), modeName) << std::endl;
-		if (m_isSubProcess)
-			ExitProcess(1);
-		else
-			return false;
+		return false;
 	}
 
 	const bool failed = curMode.encFunc(outputFile.c_str(), folderPath.c_str(), true, curMode.key.data(), curMode.cryptVersion) < 0;
@@ -166,38 +236,67 @@ bool WolfDec::PackArchive(const tString& folderPath, const bool& override)
 	if (failed)
 		fs::remove(outputFile);
 
-	if (m_isSubProcess)
-		ExitProcess(failed);
-
 	return !failed;
 }
 
-bool WolfDec::UnpackArchive(const tString& filePath, const bool& override)
+bool WolfDec::UnpackArchive(const tString& filePath, const bool& override, const ExtractFilter& filter)
 {
-	TCHAR pFullPath[MAX_PATH];
-	const fs::path fp = fs::path(filePath);
-	const tString cwd = fs::current_path();
-
-	const tString directoryPath = fp.parent_path();
-	const tString fileName      = fp.stem();
-
-	ConvertFullPath__(filePath.c_str(), pFullPath);
-
 	// Check if the basename of the file is in the ignore list
 	if (!IsValidFile(filePath))
 		return true;
 
+	// The fingerprint is used by the manifest and the key cache, it is only computed once per archive
+	const std::string fingerprint = KeyCache::Fingerprint(filePath);
+
 	// Check if the file is already unpacked, i.e., if the directory exists and is not empty
-	if (!override && IsAlreadyUnpacked(filePath))
+	// A filtered extraction relies on the manifest to skip the selected entries which are already extracted
+	if (!override && filter.IsEmpty() && isAlreadyUnpacked(filePath, fingerprint))
 		return true;
 
+	// Extract everything again instead of skipping the unchanged files
+	if (override)
+		ExtractManifest::Remove(filePath);
+
+	return unpackArchive(filePath, fingerprint, filter, nullptr);
+}
+
+bool WolfDec::UnpackArchive(const tString& filePath, MemoryFS& memFs, const ExtractFilter& filter)
+{
+	if (!IsValidFile(filePath))
+		return true;
+
+	return unpackArchive(filePath, KeyCache::Fingerprint(filePath), filter, &memFs);
+}
+
+bool WolfDec::ListArchive(const tString& filePath, DXArchiveListing& listing)
+{
+	const std::string fingerprint = KeyCache::Fingerprint(filePath);
+
 	if (m_mode == -1)
 	{
+		if (tryCachedMode(fingerprint, [&](const uint32_t& mode) { return listArchive(filePath, mode, listing); }))
+			return true;
+
 		const uint16_t cryptVersion = getCryptVersion(filePath);
 
 		if (cryptVersion == 0x0)
-			return detectMode(filePath, override);
-		// For Pro Games always return false and let UberWolfLib calculate the key
+		{
+			const uint32_t modeCnt = static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + m_additionalModes.size());
+
+			// Listing checks the header tables the same way the probe does, so the first mode which lists the archive is the right one
+			for (uint32_t i = 0; i < modeCnt; i++)
+			{
+				if (!listArchive(filePath, i, listing))
+					continue;
+
+				m_mode = i;
+				cacheMode(fingerprint, m_mode);
+				return true;
+			}
+
+			return false;
+		}
+		// Pro Games need the key calculated by UberWolfLib first
 		else if (cryptVersion >= PRO_CRYPT_VERSION)
 			return false;
 		else if (cryptVersion == CC2_PRO_VERSION)
@@ -209,36 +308,33 @@ bool WolfDec::UnpackArchive(const tString& filePath, const bool& override)
 	if (m_mode >= (DEFAULT_CRYPT_MODES.size() + m_additionalModes.size()))
 	{
 		ERROR_LOG << std::format(TEXT("Specified Mode: {} out of range"), m_mode) << std::endl;
-		if (m_isSubProcess)
-			ExitProcess(1);
-		else
-			return false;
+		return false;
 	}
 
-	// Always run the unpacking in a subprocess
-	if (!m_isSubProcess)
-		return runProcess(filePath, m_mode, override);
-
-	const CryptMode curMode = (m_mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(m_mode) : m_additionalModes.at(m_mode - DEFAULT_CRYPT_MODES.size()));
-
-	fs::current_path(directoryPath);
-	fs::create_directory(fileName);
-	fs::current_path(fileName);
+	if (!listArchive(filePath, m_mode, listing))
+		return false;
 
-	const bool failed = curMode.decFunc(pFullPath, TEXT(""), curMode.key.data()) < 0;
+	cacheMode(fingerprint, m_mode);
+	return true;
+}
 
-	if (failed)
+bool WolfDec::VerifyArchive(const tString& filePath, DXArchiveVerifyReport& report, const ExtractFilter& filter)
+{
+	// The header tables select the mode without decoding anything, whether it decodes the files is what is verified
+	if (m_mode == -1)
 	{
-		fs::current_path(directoryPath);
-		fs::remove_all(fileName);
+		DXArchiveListing listing;
+		if (!ListArchive(filePath, listing))
+			return false;
 	}
 
-	if (m_isSubProcess)
-		ExitProcess(failed);
-
-	fs::current_path(cwd);
+	if (m_mode >= (DEFAULT_CRYPT_MODES.size() + m_additionalModes.size()))
+	{
+		ERROR_LOG << std::format(TEXT("Specified Mode: {} out of range"), m_mode) << std::endl;
+		return false;
+	}
 
-	return !failed;
+	return verifyArchive(filePath, m_mode, report, filter);
 }
 
 void WolfDec::AddAndSetKey(const std::string& name, const uint16_t& cryptVersion, const bool& useOldDxArc, const Key& key)
@@ -249,7 +345,7 @@ void WolfDec::AddAndSetKey(const std::string& name, const uint16_t& cryptVersion
 
 void WolfDec::AddKey(const std::string& name, const uint16_t& cryptVersion, const bool& useOldDxArc, const Key& key)
 {
-	m_additionalModes.push_back({ name, cryptVersion, (useOldDxArc ? &DXArchive_VER6::DecodeArchive : &DXArchive::DecodeArchive), nullptr, key });
+	m_additionalModes.push_back({ name, cryptVersion, (useOldDxArc ? &DXArchive_VER6::DecodeArchive : &DXArchive::DecodeArchive), (useOldDxArc ? &DXArchive_VER6::ProbeArchive : &DXArchive::ProbeArchive), nullptr, key });
 }
 
 tStrings WolfDec::GetEncryptionsW()
@@ -293,16 +389,9 @@ void WolfDec::loadConfig()
 			{
 				if (value.contains("mode") && value.contains("key"))
 				{
-					std::string mode        = value["mode"];
-					DecryptFunction decFunc = nullptr;
-					std::transform(mode.begin(), mode.end(), mode.begin(), [](const unsigned char& c) { return std::tolower(c); });
-					if (mode == "ver5")
-						decFunc = &DXArchive_VER5::DecodeArchive;
-					else if (mode == "ver6")
-						decFunc = &DXArchive_VER6::DecodeArchive;
-					else if (mode == "ver8")
-						decFunc = &DXArchive::DecodeArchive;
-					else
+					const std::string mode  = value["mode"];
+					const Decoder* pDecoder = findDecoder(mode);
+					if (pDecoder == nullptr)
 						throw std::runtime_error("Invalid mode: " + mode);
 
 					std::vector<unsigned char> key;
@@ -322,7 +411,7 @@ void WolfDec::loadConfig()
 						key.push_back(0x00);
 					}
 
-					m_additionalModes.push_back({ name, 0x0, decFunc, nullptr, key });
+					m_additionalModes.push_back({ name, 0x0, pDecoder->decFunc, pDecoder->probeFunc, nullptr, key });
 				}
 			}
 		}
@@ -363,71 +452,265 @@ bool WolfDec::detectCrypt(const tString& filePath)
 	return false;
 }
 
-bool WolfDec::detectMode(const tString& filePath, const bool& override)
+bool WolfDec::unpackArchive(const tString& filePath, const std::string& fingerprint, const ExtractFilter& filter, MemoryFS* pMemFs)
 {
-	bool success = false;
-
 	if (m_mode == -1)
 	{
-		for (uint32_t i = 0; i < DEFAULT_CRYPT_MODES.size(); i++)
+		// Archives decoded before directly select their mode, this skips the detection and the Pro key search
+		// If the cached mode no longer works, fall back to the detection
+		if (tryCachedMode(fingerprint, [&](const uint32_t& mode) { return decodeArchive(filePath, fingerprint, mode, filter, pMemFs); }))
+			return true;
+
+		const uint16_t cryptVersion = getCryptVersion(filePath);
+
+		if (cryptVersion == 0x0)
 		{
-			success = runProcess(filePath, i, override);
-			if (success)
-			{
-				m_mode = i;
-				return success;
-			}
+			if (!detectMode(filePath, fingerprint, filter, pMemFs))
+				return false;
+
+			cacheMode(fingerprint, m_mode);
+			return true;
+		}
+		// For Pro Games always return false and let UberWolfLib calculate the key
+		else if (cryptVersion >= PRO_CRYPT_VERSION)
+			return false;
+		else if (cryptVersion == CC2_PRO_VERSION)
+			return false;
+		else if (!detectCrypt(filePath))
+			return false;
+	}
+
+	if (m_mode >= (DEFAULT_CRYPT_MODES.size() + m_additionalModes.size()))
+	{
+		ERROR_LOG << std::format(TEXT("Specified Mode: {} out of range"), m_mode) << std::endl;
+		return false;
+	}
+
+	if (!decodeArchive(filePath, fingerprint, m_mode, filter, pMemFs))
+		return false;
+
+	cacheMode(fingerprint, m_mode);
+	return true;
+}
+
+bool WolfDec::detectMode(const tString& filePath, const std::string& fingerprint, const ExtractFilter& filter, MemoryFS* pMemFs)
+{
+	if (m_mode != -1)
+		return decodeArchive(filePath, fingerprint, m_mode, filter, pMemFs);
+
+	const uint32_t modeCnt = static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + m_additionalModes.size());
+
+	// Only check the header tables for each mode, so the archive is only extracted with the matching one
+	for (uint32_t i = 0; i < modeCnt; i++)
+	{
+		if (!probeArchive(filePath, i))
+			continue;
+
+		if (decodeArchive(filePath, fingerprint, i, filter, pMemFs))
+		{
+			m_mode = i;
+			return true;
 		}
+	}
 
-		for (uint32_t i = 0; i < m_additionalModes.size(); i++)
+	return false;
+}
+
+bool WolfDec::probeArchive(const tString& filePath, const uint32_t& mode) const
+{
+	const CryptMode& curMode = getMode(mode);
+
+	// Modes without a probe can only be tested by decoding
+	if (curMode.probeFunc == nullptr)
+		return true;
+
+	return runGuarded([&]() { return curMode.probeFunc(filePath.c_str(), curMode.key.data()) == 0; });
+}
+
+bool WolfDec::decodeArchive(const tString& filePath, const std::string& fingerprint, const uint32_t& mode, const ExtractFilter& filter, MemoryFS* pMemFs) const
+{
+	TCHAR pFullPath[MAX_PATH];
+	ConvertFullPath__(filePath.c_str(), pFullPath);
+
+	const CryptMode& curMode = getMode(mode);
+
+	if (pMemFs != nullptr)
+		return decodeToMemory(pFullPath, curMode, filter, *pMemFs);
+
+	const fs::path fp    = fs::path(pFullPath);
+	const tString outDir = FS_PATH_TO_TSTRING((fp.parent_path() / fp.stem()));
+
+	// A filtered extraction must not remove the files of an earlier extraction on failure
+	const bool outDirCreated = fs::create_directory(outDir) || filter.IsEmpty();
+
+	// Skips the entries already extracted by a previous (possibly interrupted) run
+	ExtractManifest manifest(filePath, outDir, fingerprint);
+	ExtractFilter::Observer filterObserver(filter, outDir, &manifest);
+
+	DXArchiveObserver* pObserver = (filter.IsEmpty() ? static_cast<DXArchiveObserver*>(&manifest) : &filterObserver);
+
+	DXArchiveDiskSink diskSink;
+	ExtractManifest::Sink manifestSink(manifest, diskSink);
+
+#ifdef PRINT_DEBUG
+	const uint64_t allocations = DXArchiveBufferPool::GetTotalAllocations();
+#endif
+
+	const bool failed = !runGuarded([&]() { return curMode.decFunc(pFullPath, outDir.c_str(), curMode.key.data(), pObserver, &manifestSink, m_extractThreads) >= 0; });
+
+#ifdef PRINT_DEBUG
+	// Includes the allocations of other archives decoded at the same time
+	INFO_LOG << std::format(TEXT("Buffer allocations: {} for {} files"), DXArchiveBufferPool::GetTotalAllocations() - allocations, manifest.GetExtracted()) << std::endl;
+#endif
+
+	if (failed)
+	{
+		if (outDirCreated)
 		{
-			success = runProcess(filePath, static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + i), override);
-			if (success)
-			{
-				m_mode = static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + i);
-				return success;
-			}
+			std::error_code ec;
+			fs::remove_all(outDir, ec);
+			ExtractManifest::Remove(filePath);
 		}
 	}
+	else if (filter.IsEmpty())
+		manifest.Finish();
 	else
-		success = runProcess(filePath, m_mode);
+	{
+		// Only the selected entries are on disk, the manifest stays incomplete so a full extraction still extracts the rest
+		manifest.Flush();
+
+		if (outDirCreated)
+			removeEmptyDirectories(outDir);
+	}
 
-	return success;
+	return !failed;
+}
+
+bool WolfDec::decodeToMemory(TCHAR* pFullPath, const CryptMode& curMode, const ExtractFilter& filter, MemoryFS& memFs) const
+{
+	// Without an output directory the entries are stored with their archive relative paths,
+	// there is no manifest as nothing on disk can be reused
+	ExtractFilter::Observer filterObserver(filter, TEXT(""));
+
+	DXArchiveObserver* pObserver = (filter.IsEmpty() ? nullptr : &filterObserver);
+
+	const bool failed = !runGuarded([&]() { return curMode.decFunc(pFullPath, TEXT(""), curMode.key.data(), pObserver, &memFs, m_extractThreads) >= 0; });
+
+	// A failed attempt with a wrong mode must not leave partial files for the next one
+	if (failed)
+		memFs.Clear();
+
+	return !failed;
+}
+
+bool WolfDec::listArchive(const tString& filePath, const uint32_t& mode, DXArchiveListing& listing) const
+{
+	const CryptMode& curMode = getMode(mode);
+	const Decoder* pDecoder  = findDecoder(curMode.decFunc);
+	if (pDecoder == nullptr)
+		return false;
+
+	return runGuarded([&]() { return pDecoder->listFunc(filePath.c_str(), &listing, curMode.key.data()) == 0; });
+}
+
+bool WolfDec::verifyArchive(const tString& filePath, const uint32_t& mode, DXArchiveVerifyReport& report, const ExtractFilter& filter) const
+{
+	TCHAR pFullPath[MAX_PATH];
+	ConvertFullPath__(filePath.c_str(), pFullPath);
+
+	const CryptMode& curMode = getMode(mode);
+
+	// Same as decodeToMemory, the entries keep their archive relative paths
+	ExtractFilter::Observer filterObserver(filter, TEXT(""));
+
+	DXArchiveObserver* pObserver = (filter.IsEmpty() ? nullptr : &filterObserver);
+
+	report = DXArchiveVerifyReport();
+	DXArchiveVerifySink sink(report);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const bool decoded = runGuarded([&]() { return curMode.decFunc(pFullPath, TEXT(""), curMode.key.data(), pObserver, &sink, m_extractThreads) >= 0; });
+
+	sink.Finish(decoded, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	return decoded;
+}
+
+// The archive decoders create every directory of the archive, remove the ones a filtered extraction left empty
+void WolfDec::removeEmptyDirectories(const tString& dirPath)
+{
+	std::error_code ec;
+
+	for (const auto& entry : fs::directory_iterator(dirPath, ec))
+	{
+		if (entry.is_directory())
+		{
+			removeEmptyDirectories(FS_PATH_TO_TSTRING(entry.path()));
+
+			if (fs::is_empty(entry.path(), ec))
+				fs::remove(entry.path(), ec);
+		}
+	}
 }
 
-bool WolfDec::runProcess(const tString& filePath, const uint32_t& mode, const bool& override) const
+// Try the mode stored for the archive, m_mode is only set if attempt succeeds with it
+// A key detected in an earlier run is only added to the known modes if it works, a stale cache entry leaves them unchanged
+bool WolfDec::tryCachedMode(const std::string& fingerprint, const std::function<bool(const uint32_t&)>& attempt)
 {
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
+	KeyCache::Entry entry;
+	if (fingerprint.empty() || !KeyCache::GetInstance().Find(fingerprint, entry))
+		return false;
 
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
+	const Decoder* pDecoder = findDecoder(entry.decoder);
+	if (pDecoder == nullptr)
+		return false;
 
-	const std::wstring wstr = m_progName + L" -m " + std::to_wstring(mode) + L" \"" + std::wstring(filePath) + L"\"" + (override ? L" -o" : L"");
+	const std::vector<char> key(entry.key.begin(), entry.key.end());
+	const uint32_t modeCnt = static_cast<uint32_t>(DEFAULT_CRYPT_MODES.size() + m_additionalModes.size());
 
-	if (!CreateProcess(NULL, const_cast<LPWSTR>(wstr.c_str()), NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+	for (uint32_t i = 0; i < modeCnt; i++)
 	{
-		ERROR_LOG << std::format(TEXT("CreateProcess() failed: {}"), GetLastError()) << std::endl;
+		const CryptMode& mode = getMode(i);
+		if (mode.decFunc == pDecoder->decFunc && mode.cryptVersion == entry.cryptVersion && mode.key == key)
+		{
+			if (!attempt(i))
+				return false;
+
+			m_mode = i;
+			return true;
+		}
+	}
+
+	// Keys which were detected in an earlier run are not part of the known modes
+	m_additionalModes.push_back({ entry.name, entry.cryptVersion, pDecoder->decFunc, pDecoder->probeFunc, nullptr, entry.key });
+
+	if (!attempt(modeCnt))
+	{
+		m_additionalModes.pop_back();
 		return false;
 	}
 
-	// Wait until child process exits.
-	WaitForSingleObject(pi.hProcess, INFINITE);
+	m_mode = modeCnt;
+	return true;
+}
 
-	bool success = false;
+void WolfDec::cacheMode(const std::string& fingerprint, const uint32_t& mode) const
+{
+	const CryptMode& curMode = getMode(mode);
+	const Decoder* pDecoder  = findDecoder(curMode.decFunc);
+	if (pDecoder == nullptr)
+		return;
 
-	DWORD ec;
-	if (FALSE == GetExitCodeProcess(pi.hProcess, &ec))
-		ERROR_LOG << std::format(TEXT("GetExitCodeProcess() failed: {}"), GetLastError()) << std::endl;
-	else
-		success = (ec == 0);
+	if (fingerprint.empty())
+		return;
 
-	// Close process and thread handles.
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
+	KeyCache::GetInstance().Store(fingerprint, { curMode.name, pDecoder->name, curMode.cryptVersion, Key(curMode.key.begin(), curMode.key.end()) });
+}
 
-	return success;
+const CryptMode& WolfDec::getMode(const uint32_t& mode) const
+{
+	return (mode < DEFAULT_CRYPT_MODES.size() ? DEFAULT_CRYPT_MODES.at(mode) : m_additionalModes.at(mode - DEFAULT_CRYPT_MODES.size()));
 }
 
 uint16_t WolfDec::getCryptVersion(const tString& filePath) const
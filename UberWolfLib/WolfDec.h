@@ -28,14 +28,24 @@
 
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <iterator>
 #include <string>
 #include <tchar.h>
 #include <vector>
 
+#include "ExtractFilter.h"
 #include "Types.h"
 
-using DecryptFunction = int (*)(TCHAR*, const TCHAR*, const char*);
+class DXArchiveObserver;
+class DXArchiveSink;
+class MemoryFS;
+struct DXArchiveListing;
+struct DXArchiveVerifyReport;
+
+using DecryptFunction = int (*)(TCHAR*, const TCHAR*, const char*, DXArchiveObserver*, DXArchiveSink*, uint32_t);
+using ProbeFunction   = int (*)(const TCHAR*, const char*);
+using ListFunction    = int (*)(const TCHAR*, DXArchiveListing*, const char*);
 using EncryptFunction = int (*)(const TCHAR*, const TCHAR*, bool, const char*, uint16_t);
 
 class InvalidModeException : public std::exception
@@ -43,29 +53,32 @@ class InvalidModeException : public std::exception
 
 struct CryptMode
 {
-	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const EncryptFunction& encFunc, const std::vector<char> key) :
+	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const ProbeFunction& probeFunc, const EncryptFunction& encFunc, const std::vector<char> key) :
 		name(name),
 		cryptVersion(cryptVersion),
 		decFunc(decFunc),
+		probeFunc(probeFunc),
 		encFunc(encFunc),
 		key(key)
 	{
 	}
 
-	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const EncryptFunction& encFunc, const std::string& key) :
+	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const ProbeFunction& probeFunc, const EncryptFunction& encFunc, const std::string& key) :
 		name(name),
 		cryptVersion(cryptVersion),
 		decFunc(decFunc),
+		probeFunc(probeFunc),
 		encFunc(encFunc),
 		key(key.begin(), key.end())
 	{
 		this->key.push_back(0x00); // The key needs to end with 0x00 so the parser knows when to stop
 	}
 
-	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const EncryptFunction& encFunc, const std::vector<unsigned char> key) :
+	CryptMode(const std::string& name, const uint16_t& cryptVersion, const DecryptFunction& decFunc, const ProbeFunction& probeFunc, const EncryptFunction& encFunc, const std::vector<unsigned char> key) :
 		name(name),
 		cryptVersion(cryptVersion),
 		decFunc(decFunc),
+		probeFunc(probeFunc),
 		encFunc(encFunc)
 	{
 		std::copy(key.begin(), key.end(), std::back_inserter(this->key));
@@ -74,6 +87,7 @@ struct CryptMode
 	std::string name;
 	uint16_t cryptVersion;
 	DecryptFunction decFunc;
+	ProbeFunction probeFunc;
 	EncryptFunction encFunc;
 	std::vector<char> key;
 };
@@ -86,9 +100,7 @@ public:
 	inline static const std::string CONFIG_FILE_NAME = "UberWolfConfig.json";
 
 public:
-	WolfDec() :
-		WolfDec(L"") {}
-	WolfDec(const std::wstring& progName, const uint32_t& mode = -1, const bool& isSubProcess = false);
+	WolfDec(const uint32_t& mode = -1);
 	~WolfDec();
 
 	operator bool() const
@@ -106,13 +118,33 @@ public:
 		m_mode = mode;
 	}
 
+	// Number of threads decoding the files of one archive, only used by the decoder of the current archive version
+	void SetExtractThreads(const uint32_t& threads)
+	{
+		m_extractThreads = (threads == 0 ? 1 : threads);
+	}
+
+	// The mode used for the archives, nullptr until it is detected or set
+	const CryptMode* GetCurrentMode() const
+	{
+		return (m_mode == -1 ? nullptr : &getMode(m_mode));
+	}
+
 	bool IsValidFile(const tString& filePath) const;
 
 	bool IsAlreadyUnpacked(const tString& filePath) const;
 
 	bool PackArchive(const tString& folderPath, const bool& override = false);
 
-	bool UnpackArchive(const tString& filePath, const bool& override = false);
+	bool UnpackArchive(const tString& filePath, const bool& override = false, const ExtractFilter& filter = ExtractFilter());
+
+	// Extract the archive into memory, nothing is written next to the archive; memFs is cleared if decoding fails
+	bool UnpackArchive(const tString& filePath, MemoryFS& memFs, const ExtractFilter& filter = ExtractFilter());
+
+	bool ListArchive(const tString& filePath, DXArchiveListing& listing);
+
+	// Decode every file of the archive without writing anything, false if the mode is unknown or decoding fails
+	bool VerifyArchive(const tString& filePath, DXArchiveVerifyReport& report, const ExtractFilter& filter = ExtractFilter());
 
 	void AddAndSetKey(const std::string& name, const uint16_t& cryptVersion, const bool& useOldDxArc, const Key& key);
 
@@ -130,15 +162,24 @@ private:
 	void removeOldConfig() const;
 	void loadConfig();
 	bool detectCrypt(const tString& filePath);
-	bool detectMode(const tString& filePath, const bool& override = false);
-	bool runProcess(const tString& filePath, const uint32_t& mode, const bool& override = false) const;
+	bool isAlreadyUnpacked(const tString& filePath, const std::string& fingerprint) const;
+	bool unpackArchive(const tString& filePath, const std::string& fingerprint, const ExtractFilter& filter, MemoryFS* pMemFs);
+	bool detectMode(const tString& filePath, const std::string& fingerprint, const ExtractFilter& filter, MemoryFS* pMemFs);
+	bool probeArchive(const tString& filePath, const uint32_t& mode) const;
+	bool decodeArchive(const tString& filePath, const std::string& fingerprint, const uint32_t& mode, const ExtractFilter& filter, MemoryFS* pMemFs) const;
+	bool decodeToMemory(TCHAR* pFullPath, const CryptMode& curMode, const ExtractFilter& filter, MemoryFS& memFs) const;
+	bool listArchive(const tString& filePath, const uint32_t& mode, DXArchiveListing& listing) const;
+	bool verifyArchive(const tString& filePath, const uint32_t& mode, DXArchiveVerifyReport& report, const ExtractFilter& filter) const;
+	bool tryCachedMode(const std::string& fingerprint, const std::function<bool(const uint32_t&)>& attempt);
+	void cacheMode(const std::string& fingerprint, const uint32_t& mode) const;
+	static void removeEmptyDirectories(const tString& dirPath);
+	const CryptMode& getMode(const uint32_t& mode) const;
 
 	uint16_t getCryptVersion(const tString& filePath) const;
 
 private:
 	uint32_t m_mode              = -1;
 	CryptModes m_additionalModes = {};
-	std::wstring m_progName;
-	bool m_isSubProcess = false;
-	bool m_valid        = false;
+	bool m_valid                 = false;
+	uint32_t m_extractThreads    = 1;
 };
@@ -139,7 +139,24 @@ Key WolfPro::GetProtectionKey()
 	if (m_protKeyFile.empty() && !RecheckProtFileState())
 		return Key();
 
-	Key key = findProtectionKey(m_protKeyFile);
+	std::vector<uint8_t> bytes;
+	uint32_t fileSize;
+
+#ifdef PRINT_DEBUG
+	INFO_LOG << std::format(TEXT("Searching for protection key in: {} ... "), m_protKeyFile) << std::endl;
+#endif
+
+	if (!readFile(m_protKeyFile, bytes, fileSize)) return Key();
+
+	return GetProtectionKey(bytes);
+}
+
+Key WolfPro::GetProtectionKey(const std::vector<uint8_t>& gameDat)
+{
+	if (gameDat.size() < 6) return Key();
+
+	std::vector<uint8_t> bytes = gameDat;
+	Key key                    = findProtectionKey(bytes);
 
 	if (m_proVersion != 3 && !validateProtectionKey(key))
 	{
@@ -201,6 +218,11 @@ tString WolfPro::GetProtKeyArchiveName() const
 	return ProtKey::PROTECTION_KEY_ARCHIVE;
 }
 
+tString WolfPro::GetProtKeyFileName() const
+{
+	return ProtKey::GAME_DAT;
+}
+
 bool WolfPro::RemoveProtection()
 {
 	if (!m_isWolfPro)
@@ -333,17 +355,8 @@ Key WolfPro::findDxArcKeyV2(std::vector<uint8_t>& byteData) const
 	return key;
 }
 
-Key WolfPro::findProtectionKey(const tString& filePath)
+Key WolfPro::findProtectionKey(std::vector<uint8_t>& bytes)
 {
-	std::vector<uint8_t> bytes;
-	uint32_t fileSize;
-
-#ifdef PRINT_DEBUG
-	INFO_LOG << std::format(TEXT("Searching for protection key in: {} ... "), filePath) << std::endl;
-#endif
-
-	if (!readFile(filePath, bytes, fileSize)) return Key();
-
 	if (bytes[1] == 0x50)
 	{
 		if (bytes[5] == 0x55)
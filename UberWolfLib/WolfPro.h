@@ -57,9 +57,12 @@ public:
 	}
 
 	Key GetProtectionKey();
+	// Same as GetProtectionKey for a Game.dat which was extracted into memory
+	Key GetProtectionKey(const std::vector<uint8_t>& gameDat);
 	Key GetDxArcKey();
 	bool RecheckProtFileState();
 	tString GetProtKeyArchiveName() const;
+	tString GetProtKeyFileName() const;
 
 	bool IsProV2() const
 	{
@@ -70,7 +73,7 @@ public:
 	bool DecryptWolfXFiles();
 
 private:
-	Key findProtectionKey(const tString& filePath);
+	Key findProtectionKey(std::vector<uint8_t>& bytes);
 	Key findProtectionKeyV1(std::vector<uint8_t>& byteData) const;
 	Key findProtectionKeyV2(std::vector<uint8_t>& byteData) const;
 	Key findDxArcKey(const tString& filePath);
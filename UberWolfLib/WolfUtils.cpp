@@ -52,20 +52,23 @@ const tStrings SPECIAL_FILES = {
 
 const tString WOLF_DATA_FILE_NAME = TEXT("data");
 
-static tStrings g_specialFiles = {};
-
 tStrings GetSpecialFiles()
 {
-	if (!g_specialFiles.empty()) return g_specialFiles;
+	// Built once, the archives of several games might be checked concurrently
+	static const tStrings specialFiles = []() {
+		tStrings files;
 
-	// Create a list of each special file with each possible extension
-	for (const tString& s : SPECIAL_FILES)
-	{
-		for (const tString& e : POSSIBLE_EXTENSIONS)
-			g_specialFiles.push_back(s + e);
-	}
+		// Create a list of each special file with each possible extension
+		for (const tString& s : SPECIAL_FILES)
+		{
+			for (const tString& e : POSSIBLE_EXTENSIONS)
+				files.push_back(s + e);
+		}
+
+		return files;
+	}();
 
-	return g_specialFiles;
+	return specialFiles;
 }
 
 bool ExistsWolfDataFile(const tString& folder)
@@ -0,0 +1,297 @@
+/*
+ *  File: ArchiveBenchmarkDetail.hpp
+ *  Copyright (c) 2025 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <DXLib/Crc32.h>
+#include <DXLib/DXArchive.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Throughput of the archive decoding building blocks compared to the byte-at-a-time versions they replaced
+namespace wolfx::detail::benchmark
+{
+static constexpr std::size_t ARCHIVE_BENCH_SIZE = 64 * 1024 * 1024;
+
+// Best throughput in MB/s of a few runs of func over size bytes
+inline double measureThroughput(const std::size_t &size, const std::function<void()> &func, const uint32_t &runs = 5)
+{
+	double best = 0.0;
+
+	for (uint32_t i = 0; i < runs; i++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		best = std::max(best, static_cast<double>(size) / (1024.0 * 1024.0) / elapsed.count());
+	}
+
+	return best;
+}
+
+// The LZ decoder DXArchive::Decode used before lzDecode, kept as the baseline
+inline int referenceLzDecode(const uint8_t *pSrc, uint8_t *pDest)
+{
+	static constexpr uint32_t MIN_COMPRESS = 4;
+
+	uint32_t destSize, srcSize;
+	std::memcpy(&destSize, pSrc, sizeof(uint32_t));
+	std::memcpy(&srcSize, pSrc + 4, sizeof(uint32_t));
+	srcSize -= 9;
+
+	const uint8_t keyCode = pSrc[8];
+	const uint8_t *sp     = pSrc + 9;
+	uint8_t *dp           = pDest;
+
+	while (srcSize)
+	{
+		if (sp[0] != keyCode)
+		{
+			*dp++ = *sp++;
+			srcSize--;
+			continue;
+		}
+
+		if (sp[1] == keyCode)
+		{
+			*dp++ = keyCode;
+			sp += 2;
+			srcSize -= 2;
+			continue;
+		}
+
+		uint32_t code = sp[1];
+		if (code > keyCode) code--;
+
+		sp += 2;
+		srcSize -= 2;
+
+		uint32_t conbo = code >> 3;
+		if (code & (0x1 << 2))
+		{
+			conbo |= *sp++ << 5;
+			srcSize--;
+		}
+		conbo += MIN_COMPRESS;
+
+		uint32_t index = 0;
+		switch (code & 0x3)
+		{
+			case 0:
+				index = *sp;
+				sp++;
+				srcSize--;
+				break;
+			case 1:
+				index = sp[0] | (sp[1] << 8);
+				sp += 2;
+				srcSize -= 2;
+				break;
+			case 2:
+				index = sp[0] | (sp[1] << 8) | (sp[2] << 16);
+				sp += 3;
+				srcSize -= 3;
+				break;
+		}
+		index++;
+
+		if (index < conbo)
+		{
+			uint32_t num = index;
+			while (conbo > num)
+			{
+				std::memcpy(dp, dp - num, num);
+				dp += num;
+				conbo -= num;
+				num += num;
+			}
+
+			if (conbo != 0)
+			{
+				std::memcpy(dp, dp - num, conbo);
+				dp += conbo;
+			}
+		}
+		else
+		{
+			std::memcpy(dp, dp - index, conbo);
+			dp += conbo;
+		}
+	}
+
+	return static_cast<int>(destSize);
+}
+
+// Random data with an occasional repeat of an earlier block, the stream is mostly literal runs
+inline std::vector<uint8_t> makeLiteralHeavyData(std::mt19937 &rng)
+{
+	std::vector<uint8_t> data(ARCHIVE_BENCH_SIZE);
+
+	for (std::size_t i = 0; i < data.size(); i += 256)
+	{
+		const std::size_t len = std::min<std::size_t>(256, data.size() - i);
+
+		if (i >= 4096 && rng() % 8 == 0)
+			std::memmove(&data[i], &data[i - 1024 - rng() % 2048], len);
+		else
+		{
+			for (std::size_t j = 0; j < len; j++)
+				data[i + j] = static_cast<uint8_t>(rng());
+		}
+	}
+
+	return data;
+}
+
+// Text made of a small set of words, the stream is mostly short matches
+inline std::vector<uint8_t> makeMatchHeavyData(std::mt19937 &rng)
+{
+	std::vector<std::string> words(256);
+	for (std::string &word : words)
+	{
+		word.resize(2 + rng() % 8);
+		for (char &c : word)
+			c = static_cast<char>('a' + rng() % 26);
+	}
+
+	std::vector<uint8_t> data;
+	data.reserve(ARCHIVE_BENCH_SIZE + 16);
+
+	while (data.size() < ARCHIVE_BENCH_SIZE)
+	{
+		const std::string &word = words[rng() % words.size()];
+		data.insert(data.end(), word.begin(), word.end());
+		data.push_back(rng() % 16 == 0 ? '\n' : ' ');
+	}
+
+	data.resize(ARCHIVE_BENCH_SIZE);
+	return data;
+}
+
+inline void benchmarkLzDecode(const std::string &name, std::vector<uint8_t> data)
+{
+	// An escaped key code takes two bytes, so the stream is at most twice the size of the data
+	std::vector<uint8_t> encoded(data.size() * 2 + 64);
+	const int encSize = DXArchive::Encode(data.data(), static_cast<u32>(data.size()), encoded.data(), false);
+	encoded.resize(static_cast<std::size_t>(encSize));
+
+	// Room for the over-copying of the unchecked decoder
+	std::vector<uint8_t> decoded(data.size() + 64);
+
+	const double reference = measureThroughput(data.size(), [&]() { referenceLzDecode(encoded.data(), decoded.data()); });
+	const bool referenceOk = std::memcmp(decoded.data(), data.data(), data.size()) == 0;
+
+	std::fill(decoded.begin(), decoded.end(), 0);
+	const double unchecked = measureThroughput(data.size(), [&]() { DXArchive::Decode(encoded.data(), decoded.data()); });
+	const bool uncheckedOk = std::memcmp(decoded.data(), data.data(), data.size()) == 0;
+
+	std::fill(decoded.begin(), decoded.end(), 0);
+	const double checked = measureThroughput(data.size(), [&]() { DXArchive::DecodeChecked(encoded.data(), encoded.size(), decoded.data(), data.size()); });
+	const bool checkedOk = std::memcmp(decoded.data(), data.data(), data.size()) == 0;
+
+	std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(0)
+			  << "ratio " << std::setw(3) << (100.0 * encoded.size() / data.size()) << "%  "
+			  << "byte-wise " << std::setw(6) << reference << " MB/s  "
+			  << "Decode " << std::setw(6) << unchecked << " MB/s  "
+			  << "DecodeChecked " << std::setw(6) << checked << " MB/s"
+			  << ((referenceOk && uncheckedOk && checkedOk) ? "" : "  OUTPUT MISMATCH") << std::endl;
+}
+
+inline void benchmarkLzDecode()
+{
+	std::mt19937 rng(0x1234);
+
+	std::cout << "LZ decode of " << (ARCHIVE_BENCH_SIZE >> 20) << " MiB, best of 5 runs" << std::endl;
+	benchmarkLzDecode("literal-heavy", makeLiteralHeavyData(rng));
+	benchmarkLzDecode("match-heavy", makeMatchHeavyData(rng));
+}
+// The table driven CRC32 DXArchive::HashCRC32 used before crc32::hash, kept as the baseline
+inline uint32_t referenceCrc32(const uint8_t *pData, const std::size_t &size)
+{
+	uint32_t crc = 0xffffffff;
+
+	for (std::size_t i = 0; i < size; i++)
+		crc = ::crc32::TABLES[0][(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+// Hashes the data in chunks of chunkSize bytes, each chunk on its own like the key and name hashes do
+template<typename F>
+inline uint32_t hashChunks(const std::vector<uint8_t> &data, const std::size_t &chunkSize, const F &func)
+{
+	uint32_t sum = 0;
+
+	for (std::size_t i = 0; i + chunkSize <= data.size(); i += chunkSize)
+		sum ^= func(data.data() + i, chunkSize);
+
+	return sum;
+}
+
+inline void benchmarkCrc32()
+{
+	static const std::size_t CHUNK_SIZES[] = { 32, 4096, 256 * 1024 * 1024 };
+
+	const simd::CpuFeatures features = simd::detectCpuFeatures();
+	const bool clmul                 = features.pclmul && features.sse4_1;
+
+	std::mt19937 rng(0x4321);
+	std::vector<uint8_t> data(256 * 1024 * 1024);
+	for (uint8_t &b : data)
+		b = static_cast<uint8_t>(rng());
+
+	std::cout << "CRC32 of " << (data.size() >> 20) << " MiB, best of 5 runs" << std::endl;
+
+	for (const std::size_t &chunkSize : CHUNK_SIZES)
+	{
+		uint32_t refSum = 0, plainSum = 0, clmulSum = 0;
+
+		const double reference = measureThroughput(data.size(), [&]() { refSum = hashChunks(data, chunkSize, referenceCrc32); });
+		const double plain     = measureThroughput(data.size(), [&]() { plainSum = hashChunks(data, chunkSize, [](const uint8_t *p, const std::size_t &n) { return ~::crc32::updatePlain(~0U, p, n); }); });
+		const double folding   = clmul ? measureThroughput(data.size(), [&]() { clmulSum = hashChunks(data, chunkSize, [](const uint8_t *p, const std::size_t &n) { return ~::crc32::updateClmul(~0U, p, n); }); }) : 0.0;
+
+		std::cout << "chunk " << std::setw(9) << chunkSize << " B  " << std::fixed << std::setprecision(0)
+				  << "byte-wise " << std::setw(6) << reference << " MB/s  "
+				  << "slicing-by-8 " << std::setw(6) << plain << " MB/s  ";
+
+		if (clmul)
+			std::cout << "PCLMULQDQ " << std::setw(6) << folding << " MB/s";
+		else
+			std::cout << "PCLMULQDQ not supported";
+
+		std::cout << ((plainSum == refSum && (!clmul || clmulSum == refSum)) ? "" : "  RESULT MISMATCH") << std::endl;
+	}
+}
+} // namespace wolfx::detail::benchmark
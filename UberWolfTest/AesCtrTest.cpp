@@ -0,0 +1,137 @@
+/*
+ *  File: AesCtrTest.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include <DXLib/WolfNew.h>
+
+#include <cstring>
+#include <format>
+#include <random>
+#include <vector>
+
+#include "Tests.h"
+
+// The archives only use AES-128, the keys differ in how the round key is built and where the IV counter starts
+enum class KeyKind
+{
+	Expanded,   // Round key built by keyExpansion from a random key
+	Random,     // Random round key, both versions use the expanded key as is
+	LowCarry,   // Lower 64 bits of the IV overflow after a few blocks
+	FullCarry   // Whole IV overflows to zero after a few blocks
+};
+
+static void makeRoundKey(std::mt19937& rng, const KeyKind& kind, uint8_t* pRoundKey)
+{
+	for (uint32_t i = 0; i < AES_ROUND_KEY_SIZE; i++)
+		pRoundKey[i] = static_cast<uint8_t>(rng());
+
+	if (kind == KeyKind::Expanded)
+	{
+		uint8_t key[AES_KEY_SIZE];
+		for (uint32_t i = 0; i < AES_KEY_SIZE; i++)
+			key[i] = static_cast<uint8_t>(rng());
+
+		keyExpansion(pRoundKey, key);
+	}
+
+	uint8_t* pIv = pRoundKey + AES_KEY_EXP_SIZE;
+
+	if (kind == KeyKind::LowCarry)
+	{
+		std::memset(pIv + 8, 0xFF, 8);
+		pIv[15] = 0xFD;
+	}
+	else if (kind == KeyKind::FullCarry)
+	{
+		std::memset(pIv, 0xFF, AES_IV_SIZE);
+		pIv[15] = 0xFA;
+	}
+}
+
+// Runs both versions on the same data and round key, split into two calls at split so the counter has to carry over
+static bool compare(const uint8_t* pRoundKey, const std::vector<uint8_t>& data, const std::size_t& offset, const std::size_t& size, const std::size_t& split, const std::string& what)
+{
+	uint8_t keyPlain[AES_ROUND_KEY_SIZE];
+	uint8_t keyAesNi[AES_ROUND_KEY_SIZE];
+	std::memcpy(keyPlain, pRoundKey, AES_ROUND_KEY_SIZE);
+	std::memcpy(keyAesNi, pRoundKey, AES_ROUND_KEY_SIZE);
+
+	std::vector<uint8_t> dataPlain = data;
+	std::vector<uint8_t> dataAesNi = data;
+
+	aesCtrXCryptPlain(dataPlain.data() + offset, keyPlain, split);
+	aesCtrXCryptPlain(dataPlain.data() + offset + split, keyPlain, size - split);
+	aesCtrXCryptAesNi(dataAesNi.data() + offset, keyAesNi, split);
+	aesCtrXCryptAesNi(dataAesNi.data() + offset + split, keyAesNi, size - split);
+
+	// The bytes around the range must stay untouched as well
+	return Check(dataPlain == dataAesNi, what + ": data differs") && Check(std::memcmp(keyPlain, keyAesNi, AES_ROUND_KEY_SIZE) == 0, what + ": IV differs");
+}
+
+bool TestAesCtr()
+{
+	if (!simd::detectCpuFeatures().aes)
+	{
+		std::cout << "AES-NI not supported, skipped ... ";
+		return true;
+	}
+
+	// Around the block size, the pipeline width of the AES-NI version and larger buffers with a partial last block
+	static const std::size_t SIZES[]   = { 0, 1, 15, 16, 17, 31, 127, 128, 129, 143, 255, 256, 257, 1000, 4096 + 7, 65536 + 3 };
+	static const std::size_t OFFSETS[] = { 0, 1, 3, 8, 15 };
+	static const KeyKind KINDS[]       = { KeyKind::Expanded, KeyKind::Random, KeyKind::LowCarry, KeyKind::FullCarry };
+
+	std::mt19937 rng(0x57F0CA5E);
+
+	for (uint32_t round = 0; round < 4; round++)
+	{
+		for (const KeyKind& kind : KINDS)
+		{
+			uint8_t roundKey[AES_ROUND_KEY_SIZE];
+			makeRoundKey(rng, kind, roundKey);
+
+			for (const std::size_t& size : SIZES)
+			{
+				for (const std::size_t& offset : OFFSETS)
+				{
+					std::vector<uint8_t> data(offset + size + AES_BLOCKLEN);
+					for (uint8_t& b : data)
+						b = static_cast<uint8_t>(rng());
+
+					// Split once at a block boundary and once inside of a block
+					for (const std::size_t& split : { std::size_t(0), (size / 2) & ~std::size_t(AES_BLOCKLEN - 1), size / 3 })
+					{
+						const std::string what = std::format("key kind {}, size {}, offset {}, split {}", static_cast<uint32_t>(kind), size, offset, split);
+
+						if (!compare(roundKey, data, offset, size, split, what))
+							return false;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,79 @@
+/*
+ *  File: UberWolfTest.cpp
+ *  Copyright (c) 2023 Sinflower
+ *
+ *  MIT License
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include <WolfX/ArchiveBenchmark.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Tests.h"
+
+struct Test
+{
+	std::string name;
+	bool (*pFunc)();
+};
+
+static const std::vector<Test> TESTS = {
+	{ "AES-CTR", TestAesCtr },
+};
+
+// Only run with --bench, the timings depend on the machine and are not checked
+static const std::vector<void (*)()> BENCHMARKS = {
+	wolfx::benchmark::lzDecode,
+	wolfx::benchmark::crc32,
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		for (void (*pBenchmark)() : BENCHMARKS)
+			pBenchmark();
+
+		return 0;
+	}
+
+	uint32_t failed = 0;
+
+	for (const Test& test : TESTS)
+	{
+		std::cout << "Running " << test.name << " ... " << std::flush;
+
+		if (test.pFunc())
+			std::cout << "OK" << std::endl;
+		else
+		{
+			std::cout << "FAILED" << std::endl;
+			failed++;
+		}
+	}
+
+	std::cout << (TESTS.size() - failed) << " of " << TESTS.size() << " tests passed" << std::endl;
+
+	return (failed == 0 ? 0 : 1);
+}